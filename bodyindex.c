@@ -0,0 +1,353 @@
+/**
+ * @file
+ * Trigram index of email text, to speed up body searches
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page bodyindex Trigram index of email text
+ *
+ * Searching the text of an email (~b, ~B, ~h) means fetching and decoding it.
+ * The first time an email is searched, a Bloom filter of the (lower-case,
+ * ASCII) trigrams of its text is stored in the header cache.  Later searches
+ * for a plain string can rule out most emails without opening them: if any
+ * trigram of the string is missing from the filter, the email can't match.
+ *
+ * The entries are keyed by a digest of the Message-Id, the size, the main
+ * headers and the MIME structure of the email, and by $thorough_search, so
+ * they can be shared by every mailbox and never need invalidating.  The text
+ * itself isn't known until the email is opened, so two copies that differ
+ * only in their text still share an entry.
+ *
+ * The database is only kept open while a search is running, so that other
+ * instances of NeoMutt can write to it in between.
+ */
+
+#include "config.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "mutt/mutt.h"
+#include "email/lib.h"
+#include "bodyindex.h"
+#include "globals.h"
+#include "pattern.h"
+#include "hcache/hcache.h"
+
+/* These Config Variables are only used in bodyindex.c and pattern.c */
+bool C_BodyIndex; ///< Config: (hcache) Index the text of emails to speed up body searches
+
+#define BIDX_MAGIC 0x42495831 /* "BIX1" */
+#define BIDX_MIN_BITS (1 << 10)
+#define BIDX_MAX_BITS (1 << 18)
+#define BIDX_CHUNK 65536
+
+/**
+ * struct BodyIndexRecord - Header of a body index entry
+ *
+ * The record is followed by `bits / 8` bytes of Bloom filter.
+ */
+struct BodyIndexRecord
+{
+  uint32_t magic; ///< BIDX_MAGIC
+  uint32_t bits;  ///< Size of the Bloom filter, a power of two
+};
+
+/**
+ * struct TrigramScan - State of a trigram scan
+ */
+struct TrigramScan
+{
+  unsigned char *bloom; ///< Bloom filter
+  uint32_t mask;        ///< Number of bits in the filter, minus one
+  uint32_t tri;         ///< Last three characters
+  int len;              ///< Number of characters since the start of the line
+};
+
+static header_cache_t *IndexCache = NULL; ///< Open index database
+static int IndexHolds = 0;                 ///< Number of users of IndexCache
+
+/**
+ * bloom_bit - Get the Bloom filter bits of a trigram
+ * @param tri  Trigram
+ * @param mask Number of bits in the filter, minus one
+ * @param n    Which bit, 0 or 1
+ * @retval num Bit number
+ */
+static uint32_t bloom_bit(uint32_t tri, uint32_t mask, int n)
+{
+  uint32_t h = tri * (n ? 0x85ebca6bU : 0x9e3779b1U);
+  return (h ^ (h >> 15)) & mask;
+}
+
+/**
+ * scan_bytes - Add the trigrams of some text to a Bloom filter
+ * @param ts  Scan state
+ * @param buf Text
+ * @param len Length of text
+ *
+ * Trigrams don't span lines, since the text is searched one line at a time.
+ */
+static void scan_bytes(struct TrigramScan *ts, const char *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    unsigned char c = buf[i];
+    if (c == '\n')
+    {
+      ts->len = 0;
+      continue;
+    }
+    if (c < 128)
+      c = tolower(c);
+    ts->tri = ((ts->tri << 8) | c) & 0xffffff;
+    if (++ts->len < 3)
+      continue;
+    for (int n = 0; n < 2; n++)
+    {
+      uint32_t bit = bloom_bit(ts->tri, ts->mask, n);
+      ts->bloom[bit >> 3] |= (1 << (bit & 7));
+    }
+  }
+}
+
+/**
+ * scan_unfolded - Add the trigrams of an unfolded header to a Bloom filter
+ * @param ts  Scan state
+ * @param buf Header text
+ * @param len Length of text
+ *
+ * Header searches read the header with mutt_rfc822_read_line(), which joins
+ * continuation lines with a single space.
+ */
+static void scan_unfolded(struct TrigramScan *ts, const char *buf, size_t len)
+{
+  char *unfolded = mutt_mem_malloc(len + 1);
+  size_t out = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if ((buf[i] == '\n') && (i + 1 < len) && ((buf[i + 1] == ' ') || (buf[i + 1] == '\t')))
+    {
+      while ((out > 0) && isspace((unsigned char) unfolded[out - 1]))
+        out--;
+      unfolded[out++] = ' ';
+      while ((i + 1 < len) && ((buf[i + 1] == ' ') || (buf[i + 1] == '\t')))
+        i++;
+      continue;
+    }
+    unfolded[out++] = buf[i];
+  }
+
+  ts->len = 0;
+  scan_bytes(ts, unfolded, out);
+  ts->len = 0;
+  FREE(&unfolded);
+}
+
+/**
+ * index_open - Open the index database
+ * @retval ptr Header cache handle
+ * @retval NULL The index isn't available
+ */
+static header_cache_t *index_open(void)
+{
+  if (!IndexCache)
+    IndexCache = mutt_hcache_open(C_HeaderCache, "body-index", NULL);
+  return IndexCache;
+}
+
+/**
+ * index_key - Create the index key of an email
+ * @param[in]  e   Email
+ * @param[out] key Buffer for the key
+ */
+static void index_key(struct Email *e, struct Buffer *key)
+{
+  struct Md5Ctx ctx;
+  unsigned char digest[16];
+  char hash[33];
+  char num[64];
+
+  mutt_md5_init_ctx(&ctx);
+  mutt_md5_process(e->env->message_id, &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  mutt_md5_process(NONULL(e->env->subject), &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  if (e->env->from)
+    mutt_md5_process(NONULL(e->env->from->mailbox), &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  mutt_md5_process(NONULL(e->content->subtype), &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  mutt_md5_process(NONULL(mutt_param_get(&e->content->parameter, "boundary")), &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  snprintf(num, sizeof(num), "%ld/%ld/%d/%d", (long) e->date_sent,
+           (long) e->content->length, e->content->type, e->content->encoding);
+  mutt_md5_process(num, &ctx);
+  mutt_md5_finish_ctx(&ctx, digest);
+  mutt_md5_toascii(digest, hash);
+
+  mutt_buffer_printf(key, "/%s/%c", hash, C_ThoroughSearch ? 't' : 'r');
+}
+
+/**
+ * body_index_check - Can an email contain some text?
+ * @param[in]  e    Email
+ * @param[in]  text Text the search needs, e.g. "=b text"
+ * @param[out] key  Index key of the Email, for body_index_store()
+ * @retval enum #BodyIndexResult
+ *
+ * Only the ASCII trigrams of the text are checked, so the answer holds for
+ * case-insensitive searches, too.
+ */
+enum BodyIndexResult body_index_check(struct Email *e, const char *text, struct Buffer *key)
+{
+  if (!C_BodyIndex || !e || !e->env || !e->env->message_id || !e->content || !text)
+    return BIDX_MAYBE;
+
+  header_cache_t *hc = index_open();
+  if (!hc)
+    return BIDX_MAYBE;
+
+  index_key(e, key);
+
+  size_t dlen = 0;
+  void *data = mutt_hcache_fetch_raw(hc, mutt_b2s(key), mutt_buffer_len(key), &dlen);
+  if (!data)
+    return BIDX_MISSING;
+
+  enum BodyIndexResult rc = BIDX_MAYBE;
+  const struct BodyIndexRecord *rec = data;
+  if ((dlen < sizeof(struct BodyIndexRecord)) || (rec->magic != BIDX_MAGIC) ||
+      (rec->bits < BIDX_MIN_BITS) || (rec->bits > BIDX_MAX_BITS) ||
+      (rec->bits & (rec->bits - 1)) || (dlen - sizeof(struct BodyIndexRecord) < rec->bits / 8))
+  {
+    mutt_hcache_free(hc, &data);
+    return BIDX_MISSING;
+  }
+
+  const unsigned char *bloom = (const unsigned char *) (rec + 1);
+  uint32_t tri = 0;
+  int len = 0;
+  for (const unsigned char *p = (const unsigned char *) text; *p && (rc == BIDX_MAYBE); p++)
+  {
+    if ((*p >= 128) || (*p == '\n'))
+    {
+      len = 0;
+      continue;
+    }
+    tri = ((tri << 8) | tolower(*p)) & 0xffffff;
+    if (++len < 3)
+      continue;
+    for (int n = 0; n < 2; n++)
+    {
+      uint32_t bit = bloom_bit(tri, rec->bits - 1, n);
+      if (!(bloom[bit >> 3] & (1 << (bit & 7))))
+        rc = BIDX_NO;
+    }
+  }
+
+  mutt_hcache_free(hc, &data);
+  return rc;
+}
+
+/**
+ * body_index_store - Index the text of an email
+ * @param key     Index key from body_index_check()
+ * @param fp      File containing the text
+ * @param start   Offset of the text
+ * @param hdr_len Length of the header part of the text
+ * @param len     Length of the text
+ *
+ * The file position is left undefined.
+ */
+void body_index_store(const char *key, FILE *fp, LOFF_T start, long hdr_len, long len)
+{
+  header_cache_t *hc = index_open();
+  if (!hc || !key || (len < 0) || (hdr_len < 0) || (hdr_len > len))
+    return;
+
+  uint32_t bits = BIDX_MIN_BITS;
+  while ((bits < BIDX_MAX_BITS) && (bits < (uint64_t) len * 8))
+    bits <<= 1;
+
+  size_t dlen = sizeof(struct BodyIndexRecord) + bits / 8;
+  struct BodyIndexRecord *rec = mutt_mem_calloc(1, dlen);
+  rec->magic = BIDX_MAGIC;
+  rec->bits = bits;
+
+  struct TrigramScan ts = { 0 };
+  ts.bloom = (unsigned char *) (rec + 1);
+  ts.mask = bits - 1;
+
+  bool ok = (fseeko(fp, start, SEEK_SET) == 0);
+
+  char *buf = mutt_mem_malloc(MAX(hdr_len, BIDX_CHUNK));
+  if (ok && (hdr_len > 0))
+  {
+    ok = (fread(buf, 1, hdr_len, fp) == (size_t) hdr_len);
+    if (ok)
+    {
+      scan_bytes(&ts, buf, hdr_len);
+      scan_unfolded(&ts, buf, hdr_len);
+    }
+  }
+
+  for (long left = len - hdr_len; ok && (left > 0);)
+  {
+    size_t n = fread(buf, 1, MIN(left, BIDX_CHUNK), fp);
+    if (n == 0)
+      break;
+    scan_bytes(&ts, buf, n);
+    left -= n;
+  }
+  FREE(&buf);
+
+  if (ok)
+  {
+    mutt_debug(LL_DEBUG3, "indexed %s, %ld bytes in %u bits\n", key, len, bits);
+    mutt_hcache_store_raw(hc, key, strlen(key), rec, dlen);
+  }
+  FREE(&rec);
+}
+
+/**
+ * body_index_hold - Keep the index database open
+ *
+ * The database stays open until the matching body_index_release().
+ */
+void body_index_hold(void)
+{
+  IndexHolds++;
+}
+
+/**
+ * body_index_release - Close the index database, unless someone still uses it
+ *
+ * This must be called once for each call to body_index_hold().
+ */
+void body_index_release(void)
+{
+  if (IndexHolds > 0)
+    IndexHolds--;
+  if (IndexHolds > 0)
+    return;
+
+  mutt_hcache_close(IndexCache);
+  IndexCache = NULL;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file
+ * Trigram index of email text, to speed up body searches
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_BODYINDEX_H
+#define MUTT_BODYINDEX_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "mutt/mutt.h"
+
+struct Email;
+
+/* These Config Variables are only used in bodyindex.c and pattern.c */
+extern bool C_BodyIndex;
+
+/**
+ * enum BodyIndexResult - Result of checking the body index
+ */
+enum BodyIndexResult
+{
+  BIDX_MISSING, ///< The email isn't indexed yet
+  BIDX_MAYBE,   ///< The email may contain the text
+  BIDX_NO,      ///< The email can't contain the text
+};
+
+enum BodyIndexResult body_index_check(struct Email *e, const char *text, struct Buffer *key);
+void                 body_index_hold(void);
+void                 body_index_release(void);
+void                 body_index_store(const char *key, FILE *fp, LOFF_T start, long hdr_len, long len);
+
+#endif /* MUTT_BODYINDEX_H */
@@ -679,6 +679,7 @@ static int examine_directory(struct Menu *menu, struct BrowserState *state,
     struct NntpAccountData *adata = CurrentNewsSrv;
 
     init_state(state, menu);
+    nntp_active_expand(adata);
 
     for (unsigned int i = 0; i < adata->groups_num; i++)
     {
@@ -2048,6 +2049,8 @@ void mutt_select_file(char *file, size_t filelen, SelectFileFlags flags,
           }
           if (op == OP_SUBSCRIBE_PATTERN)
           {
+            /* the pattern may match groups that are only in the active cache */
+            nntp_active_expand(adata);
             for (size_t j = 0; adata && (j < adata->groups_num); j++)
             {
               struct NntpMboxData *mdata = adata->groups_list[j];
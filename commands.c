@@ -926,6 +926,18 @@ static void set_copy_flags(struct Email *e, bool decode, bool decrypt,
   }
 }
 
+/**
+ * delete_saved - Delete an email that has been saved elsewhere
+ * @param e Email
+ */
+static void delete_saved(struct Email *e)
+{
+  mutt_set_flag(Context->mailbox, e, MUTT_DELETE, true);
+  mutt_set_flag(Context->mailbox, e, MUTT_PURGE, true);
+  if (C_DeleteUntag)
+    mutt_set_flag(Context->mailbox, e, MUTT_TAG, false);
+}
+
 /**
  * mutt_save_message_ctx - Save a message to a given mailbox
  * @param e       Email
@@ -953,12 +965,7 @@ int mutt_save_message_ctx(struct Email *e, bool delete, bool decode,
     return rc;
 
   if (delete)
-  {
-    mutt_set_flag(Context->mailbox, e, MUTT_DELETE, true);
-    mutt_set_flag(Context->mailbox, e, MUTT_PURGE, true);
-    if (C_DeleteUntag)
-      mutt_set_flag(Context->mailbox, e, MUTT_TAG, false);
-  }
+    delete_saved(e);
 
   return 0;
 }
@@ -1113,7 +1120,13 @@ int mutt_save_message(struct Mailbox *m, struct EmailList *el, bool delete,
   else
   {
     int rc = 0;
+    bool defer_delete = false;
 
+#ifdef USE_IMAP
+    /* Pipelined APPENDs only report failures at the end,
+     * so don't delete anything until they have all succeeded */
+    defer_delete = delete && (savectx->mailbox->magic == MUTT_IMAP);
+#endif
 #ifdef USE_NOTMUCH
     if (m->magic == MUTT_NOTMUCH)
       nm_db_longrun_init(m, true);
@@ -1121,7 +1134,8 @@ int mutt_save_message(struct Mailbox *m, struct EmailList *el, bool delete,
     STAILQ_FOREACH(en, el, entries)
     {
       mutt_message_hook(m, en->email, MUTT_MESSAGE_HOOK);
-      rc = mutt_save_message_ctx(en->email, delete, decode, decrypt, savectx->mailbox);
+      rc = mutt_save_message_ctx(en->email, delete && !defer_delete, decode,
+                                 decrypt, savectx->mailbox);
       if (rc != 0)
         break;
 #ifdef USE_COMPRESSED
@@ -1143,12 +1157,24 @@ int mutt_save_message(struct Mailbox *m, struct EmailList *el, bool delete,
 #ifdef USE_NOTMUCH
     if (m->magic == MUTT_NOTMUCH)
       nm_db_longrun_done(m);
+#endif
+#ifdef USE_IMAP
+    if ((rc == 0) && (savectx->mailbox->magic == MUTT_IMAP))
+      rc = imap_append_finish(savectx->mailbox);
 #endif
     if (rc != 0)
     {
       mx_mbox_close(&savectx);
       return -1;
     }
+
+    if (defer_delete)
+    {
+      STAILQ_FOREACH(en, el, entries)
+      {
+        delete_saved(en->email);
+      }
+    }
   }
 
   const bool need_mailbox_cleanup = ((savectx->mailbox->magic == MUTT_MBOX) ||
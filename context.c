@@ -40,6 +40,9 @@
 #include "score.h"
 #include "sort.h"
 
+/* These Config Variables are only used in context.c */
+bool C_LiveLimit; ///< Config: Keep the limited view up to date as messages change
+
 /**
  * ctx_free - Free a Context
  * @param[out] ctx Context to free
@@ -58,6 +61,7 @@ void ctx_free(struct Context **ctx)
  */
 void ctx_cleanup(struct Context *ctx)
 {
+  FREE(&ctx->limit_dirty);
   FREE(&ctx->pattern);
   mutt_pattern_free(&ctx->limit_pattern);
   memset(ctx, 0, sizeof(struct Context));
@@ -76,6 +80,7 @@ void ctx_update(struct Context *ctx)
 
   struct Mailbox *m = ctx->mailbox;
 
+  ctx->limit_dirty_num = 0;
   mutt_hash_free(&m->subj_hash);
   mutt_hash_free(&m->id_hash);
 
@@ -167,6 +172,9 @@ void ctx_update_tables(struct Context *ctx, bool committing)
 
   int i, j, padding;
 
+  /* expunged emails may be in the list and the limit is re-applied below */
+  ctx->limit_dirty_num = 0;
+
   /* update memory to reflect the new state of the mailbox */
   m->vcount = 0;
   ctx->vsize = 0;
@@ -249,6 +257,137 @@ void ctx_update_tables(struct Context *ctx, bool committing)
   m->msg_count = j;
 }
 
+/**
+ * ctx_email_changed - Note that an Email's flags have changed
+ * @param m Mailbox
+ * @param e Email
+ *
+ * If $live_limit is set, the Email is queued, so that ctx_limit_refresh() can
+ * check it against the limit pattern again.
+ */
+void ctx_email_changed(struct Mailbox *m, struct Email *e)
+{
+  if (!C_LiveLimit || !m || !e || (m->notify != ctx_mailbox_changed) || !m->ndata)
+    return;
+
+  struct Context *ctx = m->ndata;
+  if (!ctx->pattern || !ctx->limit_pattern)
+    return;
+
+  if (ctx->limit_dirty_num >= ctx->limit_dirty_max)
+  {
+    ctx->limit_dirty_max += 32;
+    mutt_mem_realloc(&ctx->limit_dirty, ctx->limit_dirty_max * sizeof(struct Email *));
+  }
+  ctx->limit_dirty[ctx->limit_dirty_num++] = e;
+}
+
+/**
+ * limit_refresh_unthreaded - Add or remove an Email from an unthreaded view
+ * @param ctx     Mailbox
+ * @param e       Email
+ * @param padding Padding size, from mx_msg_padding_size()
+ *
+ * The emails are in sorted order, so v2r is, too.  Only the virtual numbers
+ * after the change need updating.
+ */
+static void limit_refresh_unthreaded(struct Context *ctx, struct Email *e, int padding)
+{
+  struct Mailbox *m = ctx->mailbox;
+  struct Body *b = e->content;
+  int pos;
+
+  if (e->limited)
+  {
+    if (e->virtual >= 0)
+      return;
+
+    int lo = 0, hi = m->vcount;
+    while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (m->v2r[mid] < e->msgno)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    pos = lo;
+    memmove(&m->v2r[pos + 1], &m->v2r[pos], (m->vcount - pos) * sizeof(int));
+    m->v2r[pos] = e->msgno;
+    m->vcount++;
+    ctx->vsize += b->length + b->offset - b->hdr_offset + padding;
+  }
+  else
+  {
+    if (e->virtual < 0)
+      return;
+
+    pos = e->virtual;
+    e->virtual = -1;
+    m->vcount--;
+    memmove(&m->v2r[pos], &m->v2r[pos + 1], (m->vcount - pos) * sizeof(int));
+    ctx->vsize -= b->length + b->offset - b->hdr_offset + padding;
+  }
+
+  for (int i = pos; i < m->vcount; i++)
+    m->emails[m->v2r[i]]->virtual = i;
+}
+
+/**
+ * ctx_limit_refresh - Apply the limit to the Emails that have changed
+ * @param ctx Mailbox
+ * @retval true The view has changed
+ *
+ * Only the Emails queued by ctx_email_changed() are matched again.  The rest
+ * of the view is left alone.  A collapsed thread keeps its place in the view,
+ * but its count of hidden messages is updated.
+ */
+bool ctx_limit_refresh(struct Context *ctx)
+{
+  if (!ctx || !ctx->mailbox || (ctx->limit_dirty_num == 0))
+    return false;
+
+  if (!ctx->pattern || !ctx->limit_pattern)
+  {
+    ctx->limit_dirty_num = 0;
+    return false;
+  }
+
+  struct Mailbox *m = ctx->mailbox;
+  const bool threaded = ((C_Sort & SORT_MASK) == SORT_THREADS);
+  const int padding = mx_msg_padding_size(m);
+  bool changed = false;
+
+  for (size_t i = 0; i < ctx->limit_dirty_num; i++)
+  {
+    struct Email *e = ctx->limit_dirty[i];
+    bool match = mutt_pattern_exec(ctx->limit_pattern, MUTT_MATCH_FULL_ADDRESS, m, e, NULL);
+    if (match == e->limited)
+      continue;
+
+    e->limited = match;
+    changed = true;
+    if (threaded)
+    {
+      /* mutt_set_virtual() will renumber the view */
+      if (!e->collapsed)
+        e->virtual = match ? 0 : -1;
+    }
+    else
+      limit_refresh_unthreaded(ctx, e, padding);
+  }
+  ctx->limit_dirty_num = 0;
+
+  if (changed && threaded)
+  {
+    mutt_set_virtual(ctx);
+    mutt_draw_tree(ctx);
+  }
+
+  mutt_debug(LL_DEBUG2, "limit %s, %d visible\n", changed ? "changed" : "unchanged", m->vcount);
+  return changed;
+}
+
 /**
  * ctx_mailbox_changed - Act on a Mailbox change notification
  * @param m      Mailbox
@@ -31,6 +31,9 @@
 
 struct EmailList;
 
+/* These Config Variables are only used in context.c */
+extern bool C_LiveLimit;
+
 /**
  * struct Context - The "current" mailbox
  */
@@ -46,12 +49,18 @@ struct Context
 
   struct Menu *menu; /**< needed for pattern compilation */
 
+  struct Email **limit_dirty; /**< emails changed since the limit was applied */
+  size_t limit_dirty_num;     /**< number of entries in limit_dirty */
+  size_t limit_dirty_max;     /**< allocated size of limit_dirty */
+
   bool collapsed : 1; /**< are all threads collapsed? */
 
   struct Mailbox *mailbox;
 };
 
+void ctx_email_changed(struct Mailbox *m, struct Email *e);
 void ctx_free(struct Context **ctx);
+bool ctx_limit_refresh(struct Context *ctx);
 void ctx_mailbox_changed(struct Mailbox *m, enum MailboxNotification action);
 void ctx_update(struct Context *ctx);
 void ctx_update_tables(struct Context *ctx, bool committing);
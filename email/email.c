@@ -67,9 +67,30 @@ struct Email *mutt_email_new(void)
   STAILQ_INIT(&e->chain);
 #endif
   STAILQ_INIT(&e->tags);
+  mutt_email_touch(e);
   return e;
 }
 
+/**
+ * mutt_email_touch - Give an Email a new generation number
+ * @param e Email
+ *
+ * Call this when the headers or tags of an Email change.  Anything remembered
+ * about the Email, e.g. Pattern results, will be thrown away.  Changes to the
+ * flags are spotted without it.
+ */
+void mutt_email_touch(struct Email *e)
+{
+  static unsigned int generation = 0;
+
+  if (!e)
+    return;
+
+  if (++generation == 0)
+    generation++;
+  e->gen = generation;
+}
+
 /**
  * mutt_email_cmp_strict - Strictly compare message emails
  * @param e1 First Email
@@ -80,6 +80,7 @@ struct Email
   short recipient;    /**< user_is_recipient()'s return value, cached */
 
   int pair;           /**< color-pair to use when displaying in the index */
+  unsigned int gen;   /**< generation, changes whenever the email does */
 
   time_t date_sent;   /**< time when the message was sent (UTC) */
   time_t received;    /**< time when the message was placed in the mailbox */
@@ -129,5 +130,6 @@ STAILQ_HEAD(EmailList, EmailNode);
 bool          mutt_email_cmp_strict(const struct Email *e1, const struct Email *e2);
 void          mutt_email_free(struct Email **e);
 struct Email *mutt_email_new(void);
+void          mutt_email_touch(struct Email *e);
 
 #endif /* MUTT_EMAIL_EMAIL_H */
@@ -39,6 +39,7 @@
  * | email/mime.c           | @subpage email_mime      |
  * | email/parameter.c      | @subpage email_parameter |
  * | email/parse.c          | @subpage email_parse     |
+ * | email/range.c          | @subpage email_range     |
  * | email/rfc2047.c        | @subpage email_rfc2047   |
  * | email/rfc2231.c        | @subpage email_rfc2231   |
  * | email/tags.c           | @subpage email_tags      |
@@ -62,6 +63,7 @@
 #include "mime.h"
 #include "parameter.h"
 #include "parse.h"
+#include "range.h"
 #include "rfc2047.h"
 #include "rfc2231.h"
 #include "tags.h"
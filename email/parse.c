@@ -995,6 +995,148 @@ char *mutt_rfc822_read_line(FILE *fp, char *line, size_t *linelen)
   /* not reached */
 }
 
+/**
+ * header_init - Give an Email the default Body of a new header
+ * @param e Email
+ */
+static void header_init(struct Email *e)
+{
+  if (!e || e->content)
+    return;
+
+  e->content = mutt_body_new();
+
+  /* set the defaults from RFC1521 */
+  e->content->type = TYPE_TEXT;
+  e->content->subtype = mutt_str_strdup("plain");
+  e->content->encoding = ENC_7BIT;
+  e->content->length = -1;
+
+  /* RFC2183 says this is arbitrary */
+  e->content->disposition = DISP_INLINE;
+}
+
+/**
+ * parse_spam - Match a header line against the spam rules
+ * @param env  Envelope
+ * @param line Header line, e.g. "Subject: hello"
+ */
+static void parse_spam(struct Envelope *env, const char *line)
+{
+  char buf[1025] = "";
+
+  if (!mutt_replacelist_match(&SpamList, buf, sizeof(buf), line))
+    return;
+  if (mutt_regexlist_match(&NoSpamList, line))
+    return;
+
+  /* if spam tag already exists, figure out how to amend it */
+  if (env->spam && (*buf != '\0'))
+  {
+    /* If C_SpamSeparator defined, append with separator */
+    if (C_SpamSeparator)
+    {
+      mutt_buffer_addstr(env->spam, C_SpamSeparator);
+      mutt_buffer_addstr(env->spam, buf);
+    }
+
+    /* else overwrite */
+    else
+    {
+      env->spam->dptr = env->spam->data;
+      *env->spam->dptr = '\0';
+      mutt_buffer_addstr(env->spam, buf);
+    }
+  }
+
+  /* spam tag is new, and match expr is non-empty; copy */
+  else if (!env->spam && (*buf != '\0'))
+  {
+    env->spam = mutt_buffer_from(buf);
+  }
+
+  /* match expr is empty; plug in null string if no existing tag */
+  else if (!env->spam)
+  {
+    env->spam = mutt_buffer_from("");
+  }
+
+  if (env->spam && env->spam->data)
+    mutt_debug(5, "spam = %s\n", env->spam->data);
+}
+
+/**
+ * mutt_rfc822_parse_field - Parse one header field that's already in memory
+ * @param env   Envelope
+ * @param e     Email
+ * @param name  Header name, e.g. "Subject"
+ * @param value Header value, unfolded
+ *
+ * This lets a caller that has the header split into fields, e.g. an NNTP
+ * overview, fill in an Envelope without writing it out first.  Call
+ * mutt_rfc822_finish_header() once all the fields have been parsed.
+ */
+void mutt_rfc822_parse_field(struct Envelope *env, struct Email *e, char *name, char *value)
+{
+  if (!env || !name || !value)
+    return;
+
+  header_init(e);
+
+  if (STAILQ_FIRST(&SpamList))
+  {
+    char line[1024];
+    snprintf(line, sizeof(line), "%s: %s", name, value);
+    parse_spam(env, line);
+  }
+
+  value = mutt_str_skip_email_wsp(value);
+  if (*value == '\0')
+    return; /* skip empty header fields */
+
+  mutt_rfc822_parse_line(env, e, name, value, false, false, true);
+}
+
+/**
+ * mutt_rfc822_finish_header - Tidy an Envelope once all its fields are parsed
+ * @param env Envelope
+ * @param e   Email
+ */
+void mutt_rfc822_finish_header(struct Envelope *env, struct Email *e)
+{
+  if (!env || !e)
+    return;
+
+  header_init(e);
+  rfc2047_decode_envelope(env);
+
+  if (env->subject)
+  {
+    regmatch_t pmatch[1];
+
+    if (C_ReplyRegex && C_ReplyRegex->regex &&
+        (regexec(C_ReplyRegex->regex, env->subject, 1, pmatch, 0) == 0))
+    {
+      env->real_subj = env->subject + pmatch[0].rm_eo;
+    }
+    else
+      env->real_subj = env->subject;
+  }
+
+  if (e->received < 0)
+  {
+    mutt_debug(LL_DEBUG1, "resetting invalid received time to 0\n");
+    e->received = 0;
+  }
+
+  /* check for missing or invalid date */
+  if (e->date_sent <= 0)
+  {
+    mutt_debug(LL_DEBUG1, "no date found, using received time from msg separator\n");
+    e->date_sent = e->received;
+  }
+}
+
 /**
  * mutt_rfc822_read_header - parses an RFC822 header
  * @param fp        Stream to read from
@@ -1015,24 +1157,8 @@ struct Envelope *mutt_rfc822_read_header(FILE *fp, struct Email *e, bool user_hd
   LOFF_T loc;
   size_t linelen = 1024;
   char *line = mutt_mem_malloc(linelen);
-  char buf[linelen + 1];
 
-  if (e)
-  {
-    if (!e->content)
-    {
-      e->content = mutt_body_new();
-
-      /* set the defaults from RFC1521 */
-      e->content->type = TYPE_TEXT;
-      e->content->subtype = mutt_str_strdup("plain");
-      e->content->encoding = ENC_7BIT;
-      e->content->length = -1;
-
-      /* RFC2183 says this is arbitrary */
-      e->content->disposition = DISP_INLINE;
-    }
-  }
+  header_init(e);
 
   while ((loc = ftello(fp)) != -1)
   {
@@ -1060,47 +1186,7 @@ struct Envelope *mutt_rfc822_read_header(FILE *fp, struct Email *e, bool user_hd
       break; /* end of header */
     }
 
-    *buf = '\0';
-
-    if (mutt_replacelist_match(&SpamList, buf, sizeof(buf), line))
-    {
-      if (!mutt_regexlist_match(&NoSpamList, line))
-      {
-        /* if spam tag already exists, figure out how to amend it */
-        if (env->spam && (*buf != '\0'))
-        {
-          /* If C_SpamSeparator defined, append with separator */
-          if (C_SpamSeparator)
-          {
-            mutt_buffer_addstr(env->spam, C_SpamSeparator);
-            mutt_buffer_addstr(env->spam, buf);
-          }
-
-          /* else overwrite */
-          else
-          {
-            env->spam->dptr = env->spam->data;
-            *env->spam->dptr = '\0';
-            mutt_buffer_addstr(env->spam, buf);
-          }
-        }
-
-        /* spam tag is new, and match expr is non-empty; copy */
-        else if (!env->spam && (*buf != '\0'))
-        {
-          env->spam = mutt_buffer_from(buf);
-        }
-
-        /* match expr is empty; plug in null string if no existing tag */
-        else if (!env->spam)
-        {
-          env->spam = mutt_buffer_from("");
-        }
-
-        if (env->spam && env->spam->data)
-          mutt_debug(5, "spam = %s\n", env->spam->data);
-      }
-    }
+    parse_spam(env, line);
 
     *p = '\0';
     p = mutt_str_skip_email_wsp(p + 1);
@@ -1116,35 +1202,7 @@ struct Envelope *mutt_rfc822_read_header(FILE *fp, struct Email *e, bool user_hd
   {
     e->content->hdr_offset = e->offset;
     e->content->offset = ftello(fp);
-
-    rfc2047_decode_envelope(env);
-
-    if (env->subject)
-    {
-      regmatch_t pmatch[1];
-
-      if (C_ReplyRegex && C_ReplyRegex->regex &&
-          (regexec(C_ReplyRegex->regex, env->subject, 1, pmatch, 0) == 0))
-      {
-        env->real_subj = env->subject + pmatch[0].rm_eo;
-      }
-      else
-        env->real_subj = env->subject;
-    }
-
-    if (e->received < 0)
-    {
-      mutt_debug(LL_DEBUG1, "resetting invalid received time to 0\n");
-      e->received = 0;
-    }
-
-    /* check for missing or invalid date */
-    if (e->date_sent <= 0)
-    {
-      mutt_debug(LL_DEBUG1,
-                 "no date found, using received time from msg separator\n");
-      e->date_sent = e->received;
-    }
+    mutt_rfc822_finish_header(env, e);
   }
 
   return env;
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * Sorted indexes of Emails, for range searches
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page email_range Sorted indexes of Emails, for range searches
+ *
+ * An index holds one entry per Email, sorted by the value of a field, e.g. the
+ * date or the size.  The Emails inside a range of values are then found with
+ * two binary searches.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include "mutt/mutt.h"
+#include "range.h"
+#include "email.h"
+
+/**
+ * range_entry_cmp - Compare two entries of a sorted index - Implements ::sort_t
+ *
+ * Equal values are kept in the order of the Emails.
+ */
+static int range_entry_cmp(const void *a, const void *b)
+{
+  const struct EmailRangeEntry *ea = a;
+  const struct EmailRangeEntry *eb = b;
+
+  if (ea->value != eb->value)
+    return (ea->value < eb->value) ? -1 : 1;
+  return ea->email->index - eb->email->index;
+}
+
+/**
+ * email_range_sort - Sort the entries of an index by value
+ * @param entries Entries
+ * @param num     Number of entries
+ */
+void email_range_sort(struct EmailRangeEntry *entries, int num)
+{
+  if (!entries || (num <= 0))
+    return;
+
+  qsort(entries, num, sizeof(struct EmailRangeEntry), range_entry_cmp);
+}
+
+/**
+ * email_range_bound - Find the first entry of a sorted index above a value
+ * @param entries Sorted index
+ * @param num     Number of entries
+ * @param value   Value to find
+ * @param equal   If true, find the first entry not below the value
+ * @retval num Index of the entry, or num if there's none
+ */
+int email_range_bound(const struct EmailRangeEntry *entries, int num, long value, bool equal)
+{
+  if (!entries || (num <= 0))
+    return 0;
+
+  int lo = 0;
+  int hi = num;
+  while (lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if ((entries[mid].value < value) || (!equal && (entries[mid].value == value)))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * email_range_candidates - Pick the Emails that a range and a server search allow
+ * @param[in]  range     Entries of a sorted index inside the range, may be NULL
+ * @param[in]  range_num Number of entries in range, -1 if there's no range
+ * @param[in]  email_max Upper bound of Email::index
+ * @param[in]  hits      Emails the server says can match, by Email::msgno, may be NULL
+ * @param[in]  hits_num  Number of entries in hits
+ * @param[in]  emails    Emails to check
+ * @param[in]  num       Number of Emails
+ * @param[out] cands     Emails that can match, room for num
+ * @param[out] pos       Position of each candidate in emails, room for num
+ * @retval num Number of candidates
+ *
+ * Emails outside the range are ruled out, and so are those the server hasn't
+ * hit.  An Email whose Email::msgno is beyond the hits isn't ruled out by them.
+ */
+int email_range_candidates(const struct EmailRangeEntry *range, int range_num, int email_max,
+                           const bool *hits, int hits_num, struct Email **emails, int num,
+                           struct Email **cands, int *pos)
+{
+  if (!emails || !cands || !pos)
+    return 0;
+
+  bool *allowed = NULL;
+  if (range && (range_num >= 0))
+  {
+    allowed = mutt_mem_calloc(MAX(email_max, 1), sizeof(bool));
+    for (int i = 0; i < range_num; i++)
+    {
+      const int index = range[i].email->index;
+      if ((index >= 0) && (index < email_max))
+        allowed[index] = true;
+    }
+  }
+
+  int count = 0;
+  for (int i = 0; i < num; i++)
+  {
+    const int index = emails[i]->index;
+    const int msgno = emails[i]->msgno;
+    if (allowed && ((index < 0) || (index >= email_max) || !allowed[index]))
+      continue;
+    if (hits && (msgno >= 0) && (msgno < hits_num) && !hits[msgno])
+      continue;
+
+    cands[count] = emails[i];
+    pos[count] = i;
+    count++;
+  }
+  FREE(&allowed);
+
+  return count;
+}
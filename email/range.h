@@ -0,0 +1,42 @@
+/**
+ * @file
+ * Sorted indexes of Emails, for range searches
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_EMAIL_RANGE_H
+#define MUTT_EMAIL_RANGE_H
+
+#include <stdbool.h>
+
+struct Email;
+
+/**
+ * struct EmailRangeEntry - An Email in a sorted index
+ */
+struct EmailRangeEntry
+{
+  long value;          ///< Value of the field
+  struct Email *email; ///< Email
+};
+
+int  email_range_bound(const struct EmailRangeEntry *entries, int num, long value, bool equal);
+int  email_range_candidates(const struct EmailRangeEntry *range, int range_num, int email_max,
+                            const bool *hits, int hits_num, struct Email **emails, int num,
+                            struct Email **cands, int *pos);
+void email_range_sort(struct EmailRangeEntry *entries, int num);
+
+#endif /* MUTT_EMAIL_RANGE_H */
@@ -55,10 +55,11 @@ struct HcacheOps
    * @param ctx    The backend-specific context retrieved via open()
    * @param key    A message identification string
    * @param keylen The length of the string pointed to by key
+   * @param dlen   Length of the returned data (optional)
    * @retval ptr  Success, message's headers
    * @retval NULL Otherwise
    */
-  void *(*fetch)(void *ctx, const char *key, size_t keylen);
+  void *(*fetch)(void *ctx, const char *key, size_t keylen, size_t *dlen);
   /**
    * free - backend-specific routine to free fetched data
    * @param[in]  ctx The backend-specific context retrieved via open()
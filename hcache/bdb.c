@@ -153,7 +153,7 @@ fail_close:
 /**
  * hcache_bdb_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   DBT dkey;
   DBT data;
@@ -169,6 +169,8 @@ static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
 
   ctx->db->get(ctx->db, NULL, &dkey, &data, 0);
 
+  if (dlen)
+    *dlen = data.size;
   return data.data;
 }
 
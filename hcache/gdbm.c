@@ -57,7 +57,7 @@ static void *hcache_gdbm_open(const char *path)
 /**
  * hcache_gdbm_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
   datum dkey;
   datum data;
@@ -70,6 +70,8 @@ static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
   dkey.dptr = (char *) key;
   dkey.dsize = keylen;
   data = gdbm_fetch(db, dkey);
+  if (dlen)
+    *dlen = data.dsize;
   return data.dptr;
 }
 
@@ -346,7 +346,7 @@ void mutt_hcache_close(header_cache_t *hc)
  */
 void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen)
 {
-  void *data = mutt_hcache_fetch_raw(hc, key, keylen);
+  void *data = mutt_hcache_fetch_raw(hc, key, keylen, NULL);
   if (!data)
   {
     return NULL;
@@ -366,8 +366,9 @@ void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen)
  * @param hc     Header cache handle
  * @param key    A message identification string
  * @param keylen The length of the string pointed to by key
+ * @param dlen   Length of the data found (optional)
  */
-void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen)
+void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen, size_t *dlen)
 {
   char path[PATH_MAX];
   const struct HcacheOps *ops = hcache_get_ops();
@@ -377,7 +378,7 @@ void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen)
 
   keylen = snprintf(path, sizeof(path), "%s%s", hc->folder, key);
 
-  return ops->fetch(hc->ctx, path, keylen);
+  return ops->fetch(hc->ctx, path, keylen, dlen);
 }
 
 /**
@@ -129,6 +129,7 @@ void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen);
  * @param hc     Pointer to the header_cache_t structure got by mutt_hcache_open
  * @param key    Message identification string
  * @param keylen Length of the string pointed to by key
+ * @param dlen   If not NULL, set to the length of the data found
  * @retval ptr  Success, the data if found
  * @retval NULL Otherwise
  *
@@ -137,7 +138,7 @@ void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen);
  * @note The returned pointer must be freed by calling mutt_hcache_free. This
  *       must be done before closing the header cache with mutt_hcache_close.
  */
-void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen);
+void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen, size_t *dlen);
 
 /**
  * mutt_hcache_free - free previously fetched data
@@ -71,15 +71,18 @@ static void *hcache_kyotocabinet_open(const char *path)
 /**
  * hcache_kyotocabinet_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
-  size_t sp;
+  size_t sp = 0;
 
   if (!ctx)
     return NULL;
 
   KCDB *db = ctx;
-  return kcdbget(db, key, keylen, &sp);
+  void *data = kcdbget(db, key, keylen, &sp);
+  if (dlen)
+    *dlen = sp;
+  return data;
 }
 
 /**
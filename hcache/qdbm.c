@@ -54,13 +54,17 @@ static void *hcache_qdbm_open(const char *path)
 /**
  * hcache_qdbm_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
   if (!ctx)
     return NULL;
 
+  int sp = 0;
   VILLA *db = ctx;
-  return vlget(db, key, keylen, NULL);
+  void *data = vlget(db, key, keylen, &sp);
+  if (dlen)
+    *dlen = sp;
+  return data;
 }
 
 /**
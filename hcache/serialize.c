@@ -655,6 +655,7 @@ struct Email *mutt_hcache_restore(const unsigned char *d)
 
   memcpy(e, d + off, sizeof(struct Email));
   off += sizeof(struct Email);
+  mutt_email_touch(e);
 
   STAILQ_INIT(&e->tags);
 #ifdef MIXMASTER
@@ -62,15 +62,18 @@ static void *hcache_tokyocabinet_open(const char *path)
 /**
  * hcache_tokyocabinet_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_tokyocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_tokyocabinet_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
-  int sp;
+  int sp = 0;
 
   if (!ctx)
     return NULL;
 
   TCBDB *db = ctx;
-  return tcbdbget(db, key, keylen, &sp);
+  void *data = tcbdbget(db, key, keylen, &sp);
+  if (dlen)
+    *dlen = sp;
+  return data;
 }
 
 /**
@@ -50,6 +50,9 @@
 #ifdef USE_COMPRESSED
 #include "compress.h"
 #endif
+#ifdef USE_IMAP
+#include "imap/imap.h"
+#endif
 
 struct Context;
 
@@ -446,6 +449,21 @@ void mutt_message_hook(struct Mailbox *m, struct Email *e, HookFlags type)
 
   current_hook_type = type;
 
+#ifdef USE_IMAP
+  /* the patterns need the real headers of a lazily loaded email */
+  if (m && (m->magic == MUTT_IMAP))
+  {
+    TAILQ_FOREACH(hook, &Hooks, entries)
+    {
+      if (hook->command && (hook->type & type))
+      {
+        imap_load_email_headers(m, e);
+        break;
+      }
+    }
+  }
+#endif
+
   mutt_buffer_init(&err);
   err.dsize = 256;
   err.data = mutt_mem_malloc(err.dsize);
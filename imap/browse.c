@@ -220,6 +220,9 @@ int imap_browse(char *path, struct BrowserState *state)
   if (!adata)
     goto fail;
 
+  /* don't disturb the selected mailbox */
+  adata = imap_pool_get(adata);
+
   mutt_message(_("Getting folder list..."));
 
   /* skip check for parents when at the root */
@@ -53,6 +53,7 @@
 #include "mx.h"
 
 /* These Config Variables are only used in imap/command.c */
+short C_ImapConnections; ///< Config: (imap) Number of connections to open to each IMAP account
 bool C_ImapServernoise; ///< Config: (imap) Display server warnings as error messages
 
 #define IMAP_CMD_BUFSIZE 512
@@ -68,7 +69,10 @@ static const char *const Capabilities[] = {
   "AUTH=GSSAPI", "AUTH=ANONYMOUS", "AUTH=OAUTHBEARER",
   "STARTTLS",    "LOGINDISABLED",  "IDLE",
   "SASL-IR",     "ENABLE",         "CONDSTORE",
-  "QRESYNC",     "X-GM-EXT-1",     NULL,
+  "QRESYNC",     "X-GM-EXT-1",     "LIST-EXTENDED",
+  "LIST-STATUS", "NOTIFY",         "SORT",
+  "LITERAL+",    "MULTIAPPEND",    "ESEARCH",
+  NULL,
 };
 
 /**
@@ -138,6 +142,8 @@ static int cmd_queue(struct ImapAccountData *adata, const char *cmdstr, ImapCmdF
   if (!cmd)
     return IMAP_CMD_BAD;
 
+  cmd->append = (flags & IMAP_CMD_APPEND);
+
   if (mutt_buffer_add_printf(adata->cmdbuf, "%s %s\r\n", cmd->seq, cmdstr) < 0)
     return IMAP_CMD_BAD;
 
@@ -200,8 +206,9 @@ static int cmd_start(struct ImapAccountData *adata, const char *cmdstr, ImapCmdF
   if (flags & IMAP_CMD_QUEUE)
     return 0;
 
+  /* Nothing left to send, but commands may still be awaiting completion */
   if (adata->cmdbuf->dptr == adata->cmdbuf->data)
-    return IMAP_CMD_BAD;
+    return imap_cmd_pending(adata) ? 0 : IMAP_CMD_BAD;
 
   rc = mutt_socket_send_d(adata->conn, adata->cmdbuf->data,
                           (flags & IMAP_CMD_PASS) ? IMAP_LOG_PASS : IMAP_LOG_CMD);
@@ -249,10 +256,13 @@ static void cmd_parse_expunge(struct ImapAccountData *adata, const char *s)
 
   struct ImapMboxData *mdata = adata->mailbox->mdata;
 
-  if ((mutt_str_atoui(s, &exp_msn) < 0) || (exp_msn < 1) || (exp_msn > mdata->max_msn))
+  if ((mutt_str_atoui(s, &exp_msn) < 0) || (exp_msn < 1) ||
+      (exp_msn > imap_msn_highest(&mdata->msn)))
+  {
     return;
+  }
 
-  e = mdata->msn_index[exp_msn - 1];
+  e = imap_msn_get(&mdata->msn, exp_msn);
   if (e)
   {
     /* imap_expunge_mailbox() will rewrite e->index.
@@ -263,16 +273,7 @@ static void cmd_parse_expunge(struct ImapAccountData *adata, const char *s)
   }
 
   /* decrement seqno of those above. */
-  for (unsigned int cur = exp_msn; cur < mdata->max_msn; cur++)
-  {
-    e = mdata->msn_index[cur];
-    if (e)
-      imap_edata_get(e)->msn--;
-    mdata->msn_index[cur - 1] = e;
-  }
-
-  mdata->msn_index[mdata->max_msn - 1] = NULL;
-  mdata->max_msn--;
+  imap_msn_remove(&mdata->msn, exp_msn);
 
   mdata->reopen |= IMAP_EXPUNGE_PENDING;
 }
@@ -321,11 +322,11 @@ static void cmd_parse_vanished(struct ImapAccountData *adata, char *s)
 
   while ((rc = mutt_seqset_iterator_next(iter, &uid)) == 0)
   {
-    struct Email *e = mutt_hash_int_find(mdata->uid_hash, uid);
+    struct Email *e = imap_uid_find(&mdata->uid_index, uid);
     if (!e)
       continue;
 
-    unsigned int exp_msn = imap_edata_get(e)->msn;
+    size_t exp_msn = imap_msn_find(&mdata->msn, e);
 
     /* imap_expunge_mailbox() will rewrite e->index.
      * It needs to resort using SORT_ORDER anyway, so setting to INT_MAX
@@ -333,33 +334,17 @@ static void cmd_parse_vanished(struct ImapAccountData *adata, char *s)
     e->index = INT_MAX;
     imap_edata_get(e)->msn = 0;
 
-    if ((exp_msn < 1) || (exp_msn > mdata->max_msn))
+    if (exp_msn == 0)
     {
       mutt_debug(LL_DEBUG1, "VANISHED: msn for UID %u is incorrect.\n", uid);
       continue;
     }
-    if (mdata->msn_index[exp_msn - 1] != e)
-    {
-      mutt_debug(LL_DEBUG1, "VANISHED: msn_index for UID %u is incorrect.\n", uid);
-      continue;
-    }
-
-    mdata->msn_index[exp_msn - 1] = NULL;
-
-    if (!earlier)
-    {
-      /* decrement seqno of those above. */
-      for (unsigned int cur = exp_msn; cur < mdata->max_msn; cur++)
-      {
-        e = mdata->msn_index[cur];
-        if (e)
-          imap_edata_get(e)->msn--;
-        mdata->msn_index[cur - 1] = e;
-      }
 
-      mdata->msn_index[mdata->max_msn - 1] = NULL;
-      mdata->max_msn--;
-    }
+    /* decrement seqno of those above, unless it's VANISHED (EARLIER) */
+    if (earlier)
+      imap_msn_set(&mdata->msn, exp_msn, NULL);
+    else
+      imap_msn_remove(&mdata->msn, exp_msn);
   }
 
   if (rc < 0)
@@ -384,7 +369,6 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
   unsigned int msn, uid;
   struct Email *e = NULL;
   char *flags = NULL;
-  int uid_checked = 0;
   bool server_changes = false;
 
   struct ImapMboxData *mdata = imap_mdata_get(adata->mailbox);
@@ -397,16 +381,16 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
     return;
   }
 
-  if ((msn < 1) || (msn > mdata->max_msn))
+  if ((msn < 1) || (msn > imap_msn_highest(&mdata->msn)))
   {
     mutt_debug(LL_DEBUG3, "Skipping FETCH response - MSN %u out of range\n", msn);
     return;
   }
 
-  e = mdata->msn_index[msn - 1];
+  e = imap_msn_get(&mdata->msn, msn);
   if (!e || !e->active)
   {
-    mutt_debug(LL_DEBUG3, "Skipping FETCH response - MSN %u not in msn_index\n", msn);
+    mutt_debug(LL_DEBUG3, "Skipping FETCH response - MSN %u not in msn index\n", msn);
     return;
   }
 
@@ -429,9 +413,6 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
     if (plen != 0)
     {
       flags = s;
-      if (uid_checked)
-        break;
-
       s += plen;
       SKIPWS(s);
       if (*s != '(')
@@ -464,9 +445,6 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
         mutt_debug(LL_DEBUG1, "UID vs MSN mismatch.  Skipping update.\n");
         return;
       }
-      uid_checked = 1;
-      if (flags)
-        break;
       s = imap_next_word(s);
     }
     else if ((plen = mutt_str_startswith(s, "MODSEQ", CASE_IGNORE)))
@@ -479,6 +457,9 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
         return;
       }
       s++;
+      unsigned long long modseq = 0;
+      if ((mutt_str_atoull(s, &modseq) >= 0) && (modseq > mdata->modseq_seen))
+        mdata->modseq_seen = modseq;
       while (*s && *s != ')')
         s++;
       if (*s == ')')
@@ -512,6 +493,43 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
   }
 }
 
+/**
+ * cmd_parse_modified - Parse a MODIFIED response code (RFC7162)
+ * @param adata Imap Account data
+ * @param s     String containing the UIDs that failed the UNCHANGEDSINCE test
+ *
+ * The emails are marked, so imap_sync_mailbox() can fetch their flags again.
+ */
+static void cmd_parse_modified(struct ImapAccountData *adata, char *s)
+{
+  unsigned int uid = 0;
+  struct ImapMboxData *mdata = adata->mailbox->mdata;
+
+  mutt_debug(LL_DEBUG2, "Handling MODIFIED\n");
+
+  char *end_of_seqset = s;
+  while (*end_of_seqset)
+  {
+    if (!strchr("0123456789:,", *end_of_seqset))
+      *end_of_seqset = '\0';
+    else
+      end_of_seqset++;
+  }
+
+  struct SeqsetIterator *iter = mutt_seqset_iterator_new(s);
+  if (!iter)
+    return;
+
+  while (mutt_seqset_iterator_next(iter, &uid) == 0)
+  {
+    struct Email *e = imap_uid_find(&mdata->uid_index, uid);
+    if (e)
+      imap_edata_get(e)->modified = true;
+  }
+
+  mutt_seqset_iterator_free(&iter);
+}
+
 /**
  * cmd_parse_capability - set capability bits according to CAPABILITY response
  * @param adata Imap Account data
@@ -755,12 +773,74 @@ static void cmd_parse_search(struct ImapAccountData *adata, const char *s)
   {
     if (mutt_str_atoui(s, &uid) < 0)
       continue;
-    e = mutt_hash_int_find(mdata->uid_hash, uid);
+    e = imap_uid_find(&mdata->uid_index, uid);
     if (e)
       e->matched = true;
   }
 }
 
+/**
+ * cmd_parse_esearch - Store the ESEARCH response for later use
+ * @param adata Imap Account data
+ * @param s     Command string with the search results
+ *
+ * Only the ALL result, a set of UIDs, is used (RFC4731).
+ */
+static void cmd_parse_esearch(struct ImapAccountData *adata, const char *s)
+{
+  unsigned int uid;
+  struct ImapMboxData *mdata = adata->mailbox->mdata;
+
+  mutt_debug(LL_DEBUG2, "Handling ESEARCH\n");
+
+  while ((s = imap_next_word((char *) s)) && *s != '\0')
+  {
+    if (!mutt_str_startswith(s, "ALL ", CASE_IGNORE))
+      continue;
+
+    s = imap_next_word((char *) s);
+    char *set = mutt_str_substr_dup(s, s + strcspn(s, " "));
+    struct SeqsetIterator *iter = mutt_seqset_iterator_new(set);
+    if (iter)
+    {
+      while (mutt_seqset_iterator_next(iter, &uid) == 0)
+      {
+        struct Email *e = imap_uid_find(&mdata->uid_index, uid);
+        if (e)
+          e->matched = true;
+      }
+      mutt_seqset_iterator_free(&iter);
+    }
+    FREE(&set);
+    break;
+  }
+}
+
+/**
+ * cmd_parse_sort - Store the SORT response for later use
+ * @param adata Imap Account data
+ * @param s     Command string with the sorted UIDs
+ *
+ * Rank the emails in the order of the UIDs, starting at 1.
+ */
+static void cmd_parse_sort(struct ImapAccountData *adata, const char *s)
+{
+  unsigned int uid;
+  struct Email *e = NULL;
+  struct ImapMboxData *mdata = adata->mailbox->mdata;
+
+  mutt_debug(LL_DEBUG2, "Handling SORT\n");
+
+  while ((s = imap_next_word((char *) s)) && *s != '\0')
+  {
+    if (mutt_str_atoui(s, &uid) < 0)
+      continue;
+    e = imap_uid_find(&mdata->uid_index, uid);
+    if (e)
+      imap_edata_get(e)->sort_rank = ++mdata->sort_ranks;
+  }
+}
+
 /**
  * cmd_parse_status - Parse status from server
  * @param adata Imap Account data
@@ -772,9 +852,10 @@ static void cmd_parse_search(struct ImapAccountData *adata, const char *s)
 static void cmd_parse_status(struct ImapAccountData *adata, char *s)
 {
   char *value = NULL;
-  unsigned int olduv, oldun;
+  unsigned int olduv, oldun, oldmessages;
   unsigned int litlen;
   short new = 0;
+  bool unseen = false;
 
   char *mailbox = imap_next_word(s);
 
@@ -821,6 +902,7 @@ static void cmd_parse_status(struct ImapAccountData *adata, char *s)
   }
   olduv = mdata->uid_validity;
   oldun = mdata->uid_next;
+  oldmessages = mdata->messages;
 
   if (*s++ != '(')
   {
@@ -849,12 +931,24 @@ static void cmd_parse_status(struct ImapAccountData *adata, char *s)
     else if (mutt_str_startswith(s, "UIDVALIDITY", CASE_MATCH))
       mdata->uid_validity = count;
     else if (mutt_str_startswith(s, "UNSEEN", CASE_MATCH))
+    {
       mdata->unseen = count;
+      unseen = true;
+    }
 
     s = value;
     if (*s && (*s != ')'))
       s = imap_next_word(s);
   }
+  /* STATUS pushed by NOTIFY may only report MESSAGES and UIDNEXT.
+   * Keep the last UNSEEN, imap_status() will ask for a new one. */
+  if (unseen)
+    mdata->unseen_stale = false;
+  else if (mdata->messages != oldmessages)
+    mdata->unseen_stale = true;
+  if (mdata->unseen > mdata->messages)
+    mdata->unseen = mdata->messages;
+
   mutt_debug(LL_DEBUG3, "%s (UIDVALIDITY: %u, UIDNEXT: %u) %d messages, %d recent, %d unseen\n",
              mdata->name, mdata->uid_validity, mdata->uid_next, mdata->messages,
              mdata->recent, mdata->unseen);
@@ -936,7 +1030,7 @@ static void cmd_parse_exists(struct ImapAccountData *adata, const char *pn)
   struct ImapMboxData *mdata = adata->mailbox->mdata;
 
   /* new mail arrived */
-  if (!(mdata->reopen & IMAP_EXPUNGE_PENDING) && (count < mdata->max_msn))
+  if (!(mdata->reopen & IMAP_EXPUNGE_PENDING) && (count < imap_msn_highest(&mdata->msn)))
   {
     /* Notes 6.0.3 has a tendency to report fewer messages exist than
      * it should. */
@@ -944,7 +1038,7 @@ static void cmd_parse_exists(struct ImapAccountData *adata, const char *pn)
   }
   /* at least the InterChange server sends EXISTS messages freely,
    * even when there is no new mail */
-  else if (count == mdata->max_msn)
+  else if (count == imap_msn_highest(&mdata->msn))
     mutt_debug(LL_DEBUG3, "superfluous EXISTS message.\n");
   else
   {
@@ -965,7 +1059,13 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
   char *s = imap_next_word(adata->buf);
   char *pn = imap_next_word(s);
 
-  if ((adata->state >= IMAP_SELECTED) && isdigit((unsigned char) *s))
+  /* a watcher only needs to know that its mailbox has changed */
+  if (adata->watch && (adata->state >= IMAP_SELECTED) &&
+      (isdigit((unsigned char) *s) || mutt_str_startswith(s, "VANISHED", CASE_IGNORE)))
+  {
+    adata->watch_changed = true;
+  }
+  else if ((adata->state >= IMAP_SELECTED) && isdigit((unsigned char) *s))
   {
     /* pn vs. s: need initial seqno */
     pn = s;
@@ -987,6 +1087,8 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
     cmd_parse_capability(adata, pn);
   else if (mutt_str_startswith(pn, "OK [CAPABILITY", CASE_IGNORE))
     cmd_parse_capability(adata, imap_next_word(pn));
+  else if ((adata->state >= IMAP_SELECTED) && mutt_str_startswith(s, "OK [MODIFIED", CASE_IGNORE))
+    cmd_parse_modified(adata, imap_next_word(pn));
   else if (mutt_str_startswith(s, "LIST", CASE_IGNORE))
     cmd_parse_list(adata, s);
   else if (mutt_str_startswith(s, "LSUB", CASE_IGNORE))
@@ -995,6 +1097,10 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
     cmd_parse_myrights(adata, s);
   else if (mutt_str_startswith(s, "SEARCH", CASE_IGNORE))
     cmd_parse_search(adata, s);
+  else if ((adata->state >= IMAP_SELECTED) && mutt_str_startswith(s, "ESEARCH", CASE_IGNORE))
+    cmd_parse_esearch(adata, s);
+  else if ((adata->state >= IMAP_SELECTED) && mutt_str_startswith(s, "SORT", CASE_IGNORE))
+    cmd_parse_sort(adata, s);
   else if (mutt_str_startswith(s, "STATUS", CASE_IGNORE))
     cmd_parse_status(adata, s);
   else if (mutt_str_startswith(s, "ENABLED", CASE_IGNORE))
@@ -1040,6 +1146,38 @@ int imap_cmd_start(struct ImapAccountData *adata, const char *cmdstr)
   return cmd_start(adata, cmdstr, 0);
 }
 
+/**
+ * imap_cmd_append - Send a pipelined APPEND command
+ * @param adata  Imap Account data
+ * @param cmdstr Command string to send
+ * @retval  0 Success
+ * @retval <0 Failure, e.g. #IMAP_CMD_BAD
+ *
+ * The command is sent, but not waited for.  If the server rejects it, the
+ * failure is counted in ImapAccountData::append_errors.
+ */
+int imap_cmd_append(struct ImapAccountData *adata, const char *cmdstr)
+{
+  return cmd_start(adata, cmdstr, IMAP_CMD_APPEND);
+}
+
+/**
+ * imap_cmd_pending - Are any commands awaiting completion?
+ * @param adata Imap Account data
+ * @retval true At least one command hasn't been completed by the server
+ */
+bool imap_cmd_pending(struct ImapAccountData *adata)
+{
+  if (!adata || !adata->cmds)
+    return false;
+
+  for (int c = adata->lastcmd; c != adata->nextcmd; c = (c + 1) % adata->cmdslots)
+    if (adata->cmds[c].state == IMAP_CMD_NEW)
+      return true;
+
+  return false;
+}
+
 /**
  * imap_cmd_step - Reads server responses from an IMAP command
  * @param adata Imap Account data
@@ -1145,6 +1283,13 @@ int imap_cmd_step(struct ImapAccountData *adata)
         /* bogus - we don't know which command result to return here. Caller
          * should provide a tag. */
         rc = cmd->state;
+        /* Nobody waits for a pipelined APPEND, just count its failure */
+        if (cmd->append && (cmd->state != IMAP_CMD_OK))
+        {
+          mutt_debug(LL_DEBUG1, "APPEND %s failed: %s\n", cmd->seq, adata->buf);
+          adata->append_errors++;
+          rc = IMAP_CMD_OK;
+        }
       }
       else
         stillrunning++;
@@ -1295,7 +1440,7 @@ void imap_cmd_finish(struct ImapAccountData *adata)
 
   if (mdata && mdata->reopen & IMAP_REOPEN_ALLOW)
   {
-    // First remove expunged emails from the msn_index
+    // First remove expunged emails from the msn index
     if (mdata->reopen & IMAP_EXPUNGE_PENDING)
     {
       mutt_debug(LL_DEBUG2, "Expunging mailbox\n");
@@ -1303,14 +1448,15 @@ void imap_cmd_finish(struct ImapAccountData *adata)
     }
 
     // Then add new emails to it
-    if (mdata->reopen & IMAP_NEWMAIL_PENDING && (mdata->new_mail_count > mdata->max_msn))
+    if (mdata->reopen & IMAP_NEWMAIL_PENDING && (mdata->new_mail_count > imap_msn_highest(&mdata->msn)))
     {
       if (!(mdata->reopen & IMAP_EXPUNGE_PENDING))
         mdata->check_status = IMAP_NEWMAIL_PENDING;
 
-      mutt_debug(LL_DEBUG2, "Fetching new mails from %d to %d\n",
-                 mdata->max_msn + 1, mdata->new_mail_count);
-      imap_read_headers(adata->mailbox, mdata->max_msn + 1, mdata->new_mail_count, false);
+      mutt_debug(LL_DEBUG2, "Fetching new mails from %zu to %d\n",
+                 imap_msn_highest(&mdata->msn) + 1, mdata->new_mail_count);
+      imap_read_headers(adata->mailbox, imap_msn_highest(&mdata->msn) + 1,
+                        mdata->new_mail_count, false);
     }
 
     // And to finish inform about MUTT_REOPEN if needed
@@ -1368,3 +1514,226 @@ int imap_cmd_idle(struct ImapAccountData *adata)
 
   return 0;
 }
+
+/**
+ * pool_login - Open a new secondary connection to an account
+ * @param adata Imap Account data of the primary connection
+ * @retval ptr  New, authenticated connection
+ * @retval NULL Failure
+ *
+ * The secondary connection reuses the credentials of the primary one, so the
+ * user won't be prompted again.
+ */
+static struct ImapAccountData *pool_login(struct ImapAccountData *adata)
+{
+  struct ImapAccountData *pdata = imap_adata_new();
+  pdata->conn_account = adata->conn_account;
+  pdata->conn = mutt_conn_new(&adata->conn->account);
+  pdata->pooled = true;
+
+  if (!pdata->conn || (imap_login(pdata) < 0))
+  {
+    mutt_debug(LL_DEBUG1, "Couldn't open secondary connection to %s\n",
+               adata->conn_account.host);
+    imap_adata_free((void **) &pdata);
+    return NULL;
+  }
+
+  mutt_debug(LL_DEBUG2, "Opened secondary connection %d to %s\n",
+             adata->poolsize + 1, adata->conn_account.host);
+  return pdata;
+}
+
+/**
+ * pool_drop - Remove a dead connection from the pool
+ * @param adata Imap Account data of the primary connection
+ * @param idx   Index of the connection in the pool
+ *
+ * The pool shrinks for good, so a failing login isn't retried by every
+ * command.
+ */
+static void pool_drop(struct ImapAccountData *adata, int idx)
+{
+  mutt_debug(LL_DEBUG1, "Dropping secondary connection %d to %s\n", idx + 1,
+             adata->conn_account.host);
+  imap_adata_free((void **) &adata->pool[idx]);
+  adata->poolsize--;
+  memmove(adata->pool + idx, adata->pool + idx + 1,
+          (adata->poolsize - idx) * sizeof(struct ImapAccountData *));
+  adata->pool[adata->poolsize] = NULL;
+  adata->poolmax--;
+  if (adata->poolnext >= adata->poolsize)
+    adata->poolnext = 0;
+}
+
+/**
+ * imap_pool_get - Pick a connection for a command that needs no selected mailbox
+ * @param adata Imap Account data of the primary connection
+ * @retval ptr Connection to use, the primary one if no other is available
+ *
+ * Commands such as STATUS or LIST don't depend on the selected mailbox.
+ * If `$imap_connections` allows it, they are sent over a pool of secondary
+ * connections, so the primary connection can stay SELECTed (or IDLE) on the
+ * current mailbox.
+ *
+ * An idle secondary connection is preferred.  Otherwise the pool is grown, up
+ * to its limit, and finally the work is spread round-robin over the pool.
+ */
+struct ImapAccountData *imap_pool_get(struct ImapAccountData *adata)
+{
+  if (!adata || adata->pooled || (adata->state < IMAP_AUTHENTICATED))
+    return adata;
+
+  if (!adata->pool)
+  {
+    if (C_ImapConnections < 2)
+      return adata;
+    adata->poolmax = C_ImapConnections - 1;
+    adata->pool = mutt_mem_calloc(adata->poolmax, sizeof(struct ImapAccountData *));
+  }
+
+  for (int i = 0; i < adata->poolsize;)
+  {
+    struct ImapAccountData *pdata = adata->pool[i];
+    /* the server may have dropped an unused connection */
+    if ((pdata->state == IMAP_DISCONNECTED) && (imap_login(pdata) < 0))
+    {
+      pool_drop(adata, i);
+      continue;
+    }
+    if ((pdata->state >= IMAP_AUTHENTICATED) && (pdata->nextcmd == pdata->lastcmd))
+      return pdata;
+    i++;
+  }
+
+  if (adata->poolsize < adata->poolmax)
+  {
+    struct ImapAccountData *pdata = pool_login(adata);
+    if (pdata)
+    {
+      adata->pool[adata->poolsize++] = pdata;
+      return pdata;
+    }
+
+    /* don't keep hammering a server that limits the number of connections */
+    adata->poolmax = adata->poolsize;
+  }
+
+  for (int i = 0; i < adata->poolsize; i++)
+  {
+    struct ImapAccountData *pdata = adata->pool[adata->poolnext];
+    adata->poolnext = (adata->poolnext + 1) % adata->poolsize;
+    if ((pdata->state >= IMAP_AUTHENTICATED) && !pdata->appending)
+      return pdata;
+  }
+
+  return adata;
+}
+
+/**
+ * imap_pool_drain - Complete the commands queued on the secondary connections
+ * @param adata Imap Account data of the primary connection
+ *
+ * All the queued commands are sent first, so that the server can work on all
+ * the connections at once, then the responses are collected.
+ */
+void imap_pool_drain(struct ImapAccountData *adata)
+{
+  if (!adata || !adata->pool)
+    return;
+
+  for (int i = 0; i < adata->poolsize; i++)
+  {
+    struct ImapAccountData *pdata = adata->pool[i];
+    if ((pdata->state >= IMAP_AUTHENTICATED) && (pdata->cmdbuf->dptr != pdata->cmdbuf->data))
+    {
+      if (cmd_start(pdata, NULL, IMAP_CMD_NO_FLAGS) < 0)
+        cmd_handle_fatal(pdata);
+    }
+  }
+
+  for (int i = 0; i < adata->poolsize; i++)
+  {
+    struct ImapAccountData *pdata = adata->pool[i];
+    /* an open MULTIAPPEND only completes in imap_append_finish() */
+    if ((pdata->state < IMAP_AUTHENTICATED) || pdata->appending ||
+        (pdata->nextcmd == pdata->lastcmd))
+    {
+      continue;
+    }
+
+    if ((C_ImapPollTimeout > 0) && ((mutt_socket_poll(pdata->conn, C_ImapPollTimeout)) == 0))
+    {
+      mutt_error(_("Connection to %s timed out"), pdata->conn->account.host);
+      cmd_handle_fatal(pdata);
+      continue;
+    }
+
+    mutt_sig_allow_interrupt(1);
+    while (imap_cmd_step(pdata) == IMAP_CMD_CONTINUE)
+      ;
+    mutt_sig_allow_interrupt(0);
+  }
+}
+
+/**
+ * imap_watch_open - Watch a mailbox from a connection of its own
+ * @param adata Imap Account data of the primary connection
+ * @param mdata Imap Mailbox data of the mailbox to watch
+ * @retval ptr  Watcher connection
+ * @retval NULL Failure
+ *
+ * The mailbox is EXAMINEd, so that its messages don't lose their \Recent
+ * flag, then the connection IDLEs.  Any change to the mailbox is noted by
+ * cmd_handle_untagged() and collected by imap_watch_poll().
+ */
+struct ImapAccountData *imap_watch_open(struct ImapAccountData *adata,
+                                        struct ImapMboxData *mdata)
+{
+  char buf[1024];
+
+  struct ImapAccountData *wdata = pool_login(adata);
+  if (!wdata)
+    return NULL;
+
+  wdata->watch = mutt_str_strdup(mdata->name);
+
+  snprintf(buf, sizeof(buf), "EXAMINE %s", mdata->munge_name);
+  if (imap_exec(wdata, buf, IMAP_CMD_POLL) != IMAP_EXEC_SUCCESS)
+    goto fail;
+
+  wdata->state = IMAP_SELECTED;
+  if (imap_cmd_idle(wdata) < 0)
+    goto fail;
+
+  mutt_debug(LL_DEBUG2, "Watching %s\n", mdata->name);
+  return wdata;
+
+fail:
+  mutt_debug(LL_DEBUG1, "Couldn't watch %s\n", mdata->name);
+  imap_adata_free((void **) &wdata);
+  return NULL;
+}
+
+/**
+ * imap_watch_poll - Read what a watcher connection has received
+ * @param wdata Watcher connection
+ * @retval true The watched mailbox has changed
+ *
+ * Never blocks, unless the IDLE has to be renewed before the server drops it.
+ */
+bool imap_watch_poll(struct ImapAccountData *wdata)
+{
+  while ((wdata->state == IMAP_IDLE) && (mutt_socket_poll(wdata->conn, 0) > 0))
+  {
+    if (imap_cmd_step(wdata) == IMAP_CMD_BAD)
+      break;
+  }
+
+  if ((wdata->state == IMAP_IDLE) && (time(NULL) >= (wdata->lastread + C_ImapKeepalive)))
+    imap_cmd_idle(wdata);
+
+  bool changed = wdata->watch_changed;
+  wdata->watch_changed = false;
+  return changed;
+}
@@ -70,6 +70,9 @@ struct stat;
 
 /* These Config Variables are only used in imap/imap.c */
 bool C_ImapIdle; ///< Config: (imap) Use the IMAP IDLE extension to check for new mail
+struct Regex *C_ImapIdleWatch; ///< Config: (imap) Mailboxes to watch with IDLE on connections of their own
+bool C_ImapNotify; ///< Config: (imap) Use the IMAP NOTIFY extension to check for new mail
+bool C_ImapServerSort; ///< Config: (imap) Let the server sort the index
 
 /**
  * check_capabilities - Make sure we can log in to this server
@@ -294,42 +297,295 @@ static bool compare_flags_for_copy(struct Email *e)
 }
 
 /**
- * sync_helper - Sync flag changes to the server
- * @param m     Selected Imap Mailbox
- * @param right ACL, see #AclFlags
- * @param flag  Mutt flag, e.g. #MUTT_DELETED
- * @param name  Name of server flag
+ * struct SyncFlag - A server flag that imap_sync_mailbox() keeps in step
+ */
+struct SyncFlag
+{
+  AclFlags right;   ///< ACL needed to change the flag
+  const char *name; ///< Name of server flag
+};
+
+/// Server flags synced by sync_flags(), in the order of the SyncGroup bits
+static const struct SyncFlag SyncFlags[] = {
+  { MUTT_ACL_DELETE, "\\Deleted" }, { MUTT_ACL_WRITE, "\\Flagged" },
+  { MUTT_ACL_WRITE, "Old" },        { MUTT_ACL_SEEN, "\\Seen" },
+  { MUTT_ACL_WRITE, "\\Answered" },
+};
+
+/**
+ * struct SyncGroup - Emails that need the same flag changes
+ */
+struct SyncGroup
+{
+  unsigned char add;        ///< SyncFlags to set
+  unsigned char remove;     ///< SyncFlags to clear
+  struct Buffer *set;       ///< UID set of the Emails
+  unsigned int range_start; ///< First UID of the open range, 0 if none
+  unsigned int range_end;   ///< Last UID of the open range
+};
+
+/**
+ * sync_flags_bits - Get the flags of an Email as SyncFlags bits
+ * @param e      Email
+ * @param server If true, get the flags the server knows about
+ * @retval num Bits, in the order of SyncFlags
+ */
+static unsigned char sync_flags_bits(struct Email *e, bool server)
+{
+  struct ImapEmailData *edata = imap_edata_get(e);
+  unsigned char bits = 0;
+
+  if (server ? edata->deleted : e->deleted)
+    bits |= (1 << 0);
+  if (server ? edata->flagged : e->flagged)
+    bits |= (1 << 1);
+  if (server ? edata->old : e->old)
+    bits |= (1 << 2);
+  if (server ? edata->read : e->read)
+    bits |= (1 << 3);
+  if (server ? edata->replied : e->replied)
+    bits |= (1 << 4);
+
+  return bits;
+}
+
+/**
+ * sync_group_send - Queue the UID STORE commands for a SyncGroup
+ * @param adata Imap Account data
+ * @param g     Group of Emails
+ * @param cmd   Buffer for the command
+ * @param signs Commands to send: 1 for +FLAGS, 2 for -FLAGS
+ * @param guard If true, guard the first command with UNCHANGEDSINCE
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int sync_group_send(struct ImapAccountData *adata, struct SyncGroup *g,
+                           struct Buffer *cmd, int signs, bool guard)
+{
+  struct ImapMboxData *mdata = adata->mailbox->mdata;
+
+  if (!g->range_start)
+    return 0;
+
+  if (g->range_end > g->range_start)
+    mutt_buffer_add_printf(g->set, ":%u", g->range_end);
+  g->range_start = 0;
+
+  for (int sign = 0; sign < 2; sign++)
+  {
+    unsigned char bits = (sign == 0) ? g->add : g->remove;
+    if ((bits == 0) || !(signs & (1 << sign)))
+      continue;
+
+    mutt_buffer_reset(cmd);
+    mutt_buffer_add_printf(cmd, "UID STORE %s ", mutt_b2s(g->set));
+    if (guard)
+    {
+      guard = false;
+      mutt_buffer_add_printf(cmd, "(UNCHANGEDSINCE %llu) ",
+                             MAX(mdata->modseq, mdata->modseq_seen));
+    }
+    mutt_buffer_add_printf(cmd, "%cFLAGS.SILENT (", (sign == 0) ? '+' : '-');
+
+    const char *sep = "";
+    for (size_t i = 0; i < mutt_array_size(SyncFlags); i++)
+    {
+      if (bits & (1 << i))
+      {
+        mutt_buffer_add_printf(cmd, "%s%s", sep, SyncFlags[i].name);
+        sep = " ";
+      }
+    }
+    mutt_buffer_addch(cmd, ')');
+
+    if (imap_exec(adata, mutt_b2s(cmd), IMAP_CMD_QUEUE) != IMAP_EXEC_SUCCESS)
+      return -1;
+  }
+
+  mutt_buffer_reset(g->set);
+  return 0;
+}
+
+/**
+ * sync_group_signs - Which commands of a SyncGroup to send in a pass
+ * @param g      Group of Emails
+ * @param guard  If true, the server supports CONDSTORE
+ * @param second If true, this is the pass for the deferred -FLAGS commands
+ * @retval num Commands to send, see sync_group_send()
+ */
+static int sync_group_signs(const struct SyncGroup *g, bool guard, bool second)
+{
+  if (second)
+    return 2;
+  if (guard && (g->add != 0) && (g->remove != 0))
+    return 1;
+  return 1 | 2;
+}
+
+/**
+ * sync_flags_queue - Group the Emails by flag changes and queue the commands
+ * @param m        Selected Imap Mailbox
+ * @param allowed  SyncFlags the user may change
+ * @param guard    If true, the server supports CONDSTORE
+ * @param second   If true, queue the deferred -FLAGS commands
+ * @param deferred Set to true if any -FLAGS command was deferred
  * @retval >=0 Success, number of messages
  * @retval  -1 Failure
+ *
+ * With CONDSTORE, the first STORE of a group is guarded with UNCHANGEDSINCE,
+ * but a second one would always fail: the first raises the MODSEQ of the
+ * emails.  So a group that needs both +FLAGS and -FLAGS gets its -FLAGS in a
+ * second pass, once the server has named the emails that failed the test.
+ * Those are left out.
  */
-static int sync_helper(struct Mailbox *m, AclFlags right, int flag, const char *name)
+static int sync_flags_queue(struct Mailbox *m, unsigned char allowed,
+                            bool guard, bool second, bool *deferred)
 {
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct SyncGroup *groups = NULL;
+  size_t num_groups = 0;
+  struct SyncGroup *prev = NULL;
+  struct Buffer *cmd = mutt_buffer_new();
   int count = 0;
-  int rc;
-  char buf[1024];
+  int rc = 0;
 
-  if (!m)
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    struct Email *e = m->emails[i];
+
+    /* Inactive messages don't break up a range, see make_msg_set() */
+    if (!e->active)
+      continue;
+
+    unsigned char local = sync_flags_bits(e, false);
+    unsigned char server = sync_flags_bits(e, true);
+    unsigned char add = local & ~server & allowed;
+    unsigned char remove = server & ~local & allowed;
+
+    if (!e->changed || (e->index == INT_MAX) || ((add | remove) == 0) ||
+        (second && ((add == 0) || (remove == 0) || imap_edata_get(e)->modified)))
+    {
+      prev = NULL;
+      continue;
+    }
+
+    if (guard && !second && (add != 0) && (remove != 0))
+      *deferred = true;
+
+    struct SyncGroup *g = NULL;
+    for (size_t j = 0; j < num_groups; j++)
+    {
+      if ((groups[j].add == add) && (groups[j].remove == remove))
+      {
+        g = &groups[j];
+        break;
+      }
+    }
+
+    if (!g)
+    {
+      mutt_mem_realloc(&groups, (num_groups + 1) * sizeof(struct SyncGroup));
+      g = &groups[num_groups++];
+      memset(g, 0, sizeof(*g));
+      g->add = add;
+      g->remove = remove;
+      g->set = mutt_buffer_new();
+    }
+
+    unsigned int uid = imap_edata_get(e)->uid;
+    if ((g == prev) && g->range_start)
+    {
+      g->range_end = uid;
+    }
+    else
+    {
+      if (g->range_start && (g->range_end > g->range_start))
+        mutt_buffer_add_printf(g->set, ":%u", g->range_end);
+      mutt_buffer_add_printf(g->set, "%s%u", (mutt_buffer_len(g->set) == 0) ? "" : ",", uid);
+      g->range_start = uid;
+      g->range_end = uid;
+    }
+
+    prev = g;
+    count++;
+
+    if ((mutt_buffer_len(g->set) > (IMAP_MAX_CMDLEN - 128)) &&
+        (sync_group_send(adata, g, cmd, sync_group_signs(g, guard, second), guard && !second) < 0))
+    {
+      rc = -1;
+      goto out;
+    }
+  }
+
+  for (size_t j = 0; j < num_groups; j++)
+  {
+    struct SyncGroup *g = &groups[j];
+    if (sync_group_send(adata, g, cmd, sync_group_signs(g, guard, second), guard && !second) < 0)
+    {
+      rc = -1;
+      goto out;
+    }
+  }
+
+  rc = count;
+
+out:
+  for (size_t j = 0; j < num_groups; j++)
+    mutt_buffer_free(&groups[j].set);
+  FREE(&groups);
+  mutt_buffer_free(&cmd);
+  return rc;
+}
+
+/**
+ * sync_flags - Queue the flag changes of a Mailbox
+ * @param m Selected Imap Mailbox
+ * @retval >=0 Success, number of messages
+ * @retval  -1 Failure
+ *
+ * Emails are grouped by the flags they need set and cleared, so that a
+ * typical sync needs just a couple of UID STORE commands.  The commands are
+ * queued; the caller must flush them with imap_exec().
+ *
+ * If the server supports CONDSTORE, the commands are guarded with
+ * UNCHANGEDSINCE, so changes made by another client aren't overwritten.
+ *
+ * @note Headers must be in #SORT_ORDER.
+ */
+static int sync_flags(struct Mailbox *m)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!adata || !mdata || (adata->mailbox != m))
     return -1;
 
-  if ((m->rights & right) == 0)
-    return 0;
+  unsigned char allowed = 0;
+  for (size_t i = 0; i < mutt_array_size(SyncFlags); i++)
+  {
+    if ((m->rights & SyncFlags[i].right) == 0)
+      continue;
+    if ((SyncFlags[i].right == MUTT_ACL_WRITE) && !imap_has_flag(&mdata->flags, SyncFlags[i].name))
+      continue;
+    allowed |= (1 << i);
+  }
 
-  if ((right == MUTT_ACL_WRITE) && !imap_has_flag(&imap_mdata_get(m)->flags, name))
+  if (allowed == 0)
     return 0;
 
-  snprintf(buf, sizeof(buf), "+FLAGS.SILENT (%s)", name);
-  rc = imap_exec_msgset(m, "UID STORE", buf, flag, true, false);
-  if (rc < 0)
+  bool guard = (adata->capabilities & IMAP_CAP_CONDSTORE) && (mdata->modseq != 0);
+  bool deferred = false;
+  int rc = sync_flags_queue(m, allowed, guard, false, &deferred);
+  if ((rc <= 0) || !deferred)
     return rc;
-  count += rc;
 
-  buf[0] = '-';
-  rc = imap_exec_msgset(m, "UID STORE", buf, flag, true, true);
-  if (rc < 0)
-    return rc;
-  count += rc;
+  /* Wait for the MODIFIED responses of the guarded commands */
+  if (imap_exec(adata, NULL, IMAP_CMD_NO_FLAGS) != IMAP_EXEC_SUCCESS)
+    return -1;
 
-  return count;
+  if (sync_flags_queue(m, allowed, guard, true, &deferred) < 0)
+    return -1;
+
+  return rc;
 }
 
 /**
@@ -479,6 +735,312 @@ static int compile_search(struct Mailbox *m, const struct Pattern *pat, struct B
   return 0;
 }
 
+/**
+ * enum ImapSearchMatch - How well an IMAP SEARCH key stands for a Pattern
+ */
+enum ImapSearchMatch
+{
+  IMAP_SM_ERROR = -1, ///< The Pattern couldn't be converted
+  IMAP_SM_NONE,       ///< The server can't help
+  IMAP_SM_SUPER,      ///< The key matches at least the emails the Pattern does
+  IMAP_SM_EXACT,      ///< The key matches the same emails as the Pattern
+};
+
+/**
+ * search_text - Get the text a Pattern needs, if the server can look for it
+ * @param pat     Pattern
+ * @param address True if the text is matched against an address field
+ * @retval ptr  Text every matching email contains, ignoring case
+ * @retval NULL The server can't look for the Pattern's text
+ *
+ * Only printable ASCII is sent, since the search has no charset.  Address
+ * fields are formatted differently by the server, so their text mustn't cross
+ * the punctuation.
+ */
+static const char *search_text(const struct Pattern *pat, bool address)
+{
+  if (pat->groupmatch || pat->isalias || pat->alladdr)
+    return NULL;
+
+  const char *str = pat->stringmatch ? pat->p.str : pat->literal.str;
+  if (!str || !*str || (!pat->stringmatch && (strlen(str) != pat->literal.len)))
+    return NULL;
+
+  for (const char *c = str; *c; c++)
+  {
+    if ((*c < ' ') || (*c > '~') || (address && strchr("<>\"(),", *c)))
+      return NULL;
+  }
+  return str;
+}
+
+/**
+ * search_date - Add a date range to an IMAP search
+ * @param buf    Buffer for the result
+ * @param before Key for the end of the range, e.g. "SENTBEFORE"
+ * @param since  Key for the start of the range, e.g. "SENTSINCE"
+ * @param min    Start of the range
+ * @param max    End of the range
+ *
+ * The server compares dates, not times, in a timezone of its choosing, so the
+ * range is widened by two days either side.
+ */
+static void search_date(struct Buffer *buf, const char *before,
+                        const char *since, time_t min, time_t max)
+{
+  char date[64];
+  const time_t margin = 2 * 24 * 60 * 60;
+
+  mutt_buffer_addch(buf, '(');
+  if (min > margin)
+  {
+    mutt_date_make_imap(date, sizeof(date), min - margin);
+    date[strcspn(date, " ")] = '\0';
+    mutt_buffer_add_printf(buf, "%s %s", since, date);
+  }
+  else
+  {
+    mutt_buffer_addstr(buf, "ALL");
+  }
+
+  mutt_date_make_imap(date, sizeof(date), max + margin);
+  date[strcspn(date, " ")] = '\0';
+  mutt_buffer_add_printf(buf, " %s %s)", before, date);
+}
+
+/**
+ * compile_search_key - Convert a NeoMutt Pattern to an IMAP search key
+ * @param m   Mailbox
+ * @param pat Pattern to convert
+ * @param buf Buffer for the result
+ * @retval enum #ImapSearchMatch
+ *
+ * Unlike compile_search(), this also converts the Patterns NeoMutt could
+ * match locally, so that the server can rule out emails before their headers
+ * are fetched.  Regexes, dates and sizes are approximated, so their keys only
+ * narrow the search.  The flags are left alone: they're known for every email
+ * and the server may not have seen the latest changes yet.
+ */
+static enum ImapSearchMatch compile_search_key(struct Mailbox *m,
+                                               const struct Pattern *pat,
+                                               struct Buffer *buf)
+{
+  enum ImapSearchMatch rc = IMAP_SM_NONE;
+  const char *field = NULL;
+  const char *str = NULL;
+  char term[256];
+
+  switch (pat->op)
+  {
+    case MUTT_PAT_BODY:
+    case MUTT_PAT_HEADER:
+    case MUTT_PAT_WHOLE_MSG:
+      if (!pat->stringmatch)
+        return IMAP_SM_NONE;
+      /* fallthrough */
+    case MUTT_PAT_SERVERSEARCH:
+      /* compile_search() takes care of the "not" */
+      if (compile_search(m, pat, buf) < 0)
+        return IMAP_SM_ERROR;
+      return IMAP_SM_EXACT;
+
+    case MUTT_PAT_AND:
+    case MUTT_PAT_OR:
+    {
+      struct Buffer *key = mutt_buffer_pool_get();
+      int count = 0;
+      rc = IMAP_SM_EXACT;
+      mutt_buffer_addch(buf, '(');
+      for (const struct Pattern *p = pat->child; p; p = p->next)
+      {
+        mutt_buffer_reset(key);
+        const enum ImapSearchMatch sub = compile_search_key(m, p, key);
+        if (sub == IMAP_SM_ERROR)
+        {
+          rc = IMAP_SM_ERROR;
+          break;
+        }
+        if (sub == IMAP_SM_NONE)
+        {
+          /* an AND can still be narrowed by its other operands */
+          if (pat->op == MUTT_PAT_OR)
+          {
+            rc = IMAP_SM_NONE;
+            break;
+          }
+          rc = IMAP_SM_SUPER;
+          continue;
+        }
+        if (sub == IMAP_SM_SUPER)
+          rc = IMAP_SM_SUPER;
+
+        if (count > 0)
+          mutt_buffer_addch(buf, ' ');
+        /* OR takes two keys, so n operands become "OR a OR b c" */
+        if ((pat->op == MUTT_PAT_OR) && p->next)
+          mutt_buffer_addstr(buf, "OR ");
+        mutt_buffer_addstr(buf, mutt_b2s(key));
+        count++;
+      }
+      mutt_buffer_addch(buf, ')');
+      mutt_buffer_pool_release(&key);
+      if (count == 0)
+        rc = IMAP_SM_NONE;
+      break;
+    }
+
+    case MUTT_PAT_FROM:
+      field = "FROM";
+      /* fallthrough */
+    case MUTT_PAT_TO:
+      if (!field)
+        field = "TO";
+      /* fallthrough */
+    case MUTT_PAT_CC:
+      if (!field)
+        field = "CC";
+      str = search_text(pat, true);
+      if (!str)
+        return IMAP_SM_NONE;
+      imap_quote_string(term, sizeof(term), str, false);
+      mutt_buffer_add_printf(buf, "%s %s", field, term);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    case MUTT_PAT_RECIPIENT:
+      str = search_text(pat, true);
+      if (!str)
+        return IMAP_SM_NONE;
+      imap_quote_string(term, sizeof(term), str, false);
+      mutt_buffer_add_printf(buf, "OR TO %s CC %s", term, term);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    case MUTT_PAT_SUBJECT:
+      str = search_text(pat, false);
+      if (!str)
+        return IMAP_SM_NONE;
+      imap_quote_string(term, sizeof(term), str, false);
+      mutt_buffer_add_printf(buf, "SUBJECT %s", term);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    case MUTT_PAT_DATE:
+      search_date(buf, "SENTBEFORE", "SENTSINCE", pat->min, pat->max);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    case MUTT_PAT_DATE_RECEIVED:
+      search_date(buf, "BEFORE", "SINCE", pat->min, pat->max);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    case MUTT_PAT_SIZE:
+      /* RFC822.SIZE includes the headers, so only the minimum carries over */
+      if (pat->min <= 0)
+        return IMAP_SM_NONE;
+      mutt_buffer_add_printf(buf, "LARGER %d", pat->min - 1);
+      rc = IMAP_SM_SUPER;
+      break;
+
+    default:
+      return IMAP_SM_NONE;
+  }
+
+  if ((rc == IMAP_SM_NONE) || (rc == IMAP_SM_ERROR) || !pat->not)
+    return rc;
+
+  /* the complement of an approximation isn't one */
+  if (rc != IMAP_SM_EXACT)
+    return IMAP_SM_NONE;
+
+  struct Buffer *key = mutt_buffer_pool_get();
+  mutt_buffer_strcpy(key, mutt_b2s(buf));
+  mutt_buffer_printf(buf, "NOT %s", mutt_b2s(key));
+  mutt_buffer_pool_release(&key);
+  return rc;
+}
+
+/**
+ * clear_server_exact - Forget which Patterns the server answers exactly
+ * @param pat Pattern
+ */
+static void clear_server_exact(struct Pattern *pat)
+{
+  pat->server_exact = false;
+  for (struct Pattern *p = pat->child; p; p = p->next)
+    p->server_exact = false;
+}
+
+/**
+ * compile_offload - Convert as much of a Pattern as the server can search
+ * @param m   Mailbox
+ * @param pat Pattern to convert
+ * @param buf Buffer for the result
+ * @retval  1 The search covers the Pattern, see imap_search()
+ * @retval  0 Only compile_search() should be used
+ * @retval -1 Failure
+ *
+ * The operands of a top-level AND are converted separately.  The ones the
+ * search answers exactly are marked, so they're never matched locally.
+ */
+static int compile_offload(struct Mailbox *m, struct Pattern *pat, struct Buffer *buf)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  const bool single = (pat->op != MUTT_PAT_AND) || pat->not;
+  struct Pattern *terms = single ? pat : pat->child;
+  struct Buffer *key = mutt_buffer_pool_get();
+  int exact = 0;
+  int super = 0;
+  int rc = 0;
+
+  clear_server_exact(pat);
+
+  for (struct Pattern *p = terms; p; p = single ? NULL : p->next)
+  {
+    mutt_buffer_reset(key);
+    const enum ImapSearchMatch match = compile_search_key(m, p, key);
+    if (match == IMAP_SM_ERROR)
+    {
+      rc = -1;
+      goto done;
+    }
+
+    /* a server-only Pattern must be answered exactly */
+    if ((match != IMAP_SM_EXACT) && do_search(p, 0))
+      goto done;
+
+    if (match == IMAP_SM_NONE)
+      continue;
+
+    if (mutt_buffer_len(buf) != 0)
+      mutt_buffer_addch(buf, ' ');
+    mutt_buffer_addstr(buf, mutt_b2s(key));
+    if (match == IMAP_SM_EXACT)
+    {
+      p->server_exact = true;
+      exact++;
+    }
+    else
+    {
+      super++;
+    }
+  }
+
+  /* narrowing the search is only worth a round trip if it saves fetching */
+  if ((exact > 0) || ((super > 0) && mdata && (mdata->stubs > 0)))
+    rc = 1;
+
+done:
+  if (rc != 1)
+  {
+    clear_server_exact(pat);
+    mutt_buffer_reset(buf);
+  }
+  mutt_buffer_pool_release(&key);
+  return rc;
+}
+
 /**
  * longest_common_prefix - Find longest prefix common to two strings
  * @param dest  Destination buffer
@@ -700,17 +1262,254 @@ void imap_logout_all(void)
       continue;
 
     mutt_message(_("Closing connection to %s..."), conn->account.host);
+    for (int i = 0; i < adata->poolsize; i++)
+      imap_logout(adata->pool[i]);
+    for (int i = 0; i < adata->numwatchers; i++)
+      imap_logout(adata->watchers[i]);
     imap_logout(np->adata);
     mutt_clear_error();
   }
 }
 
 /**
- * imap_read_literal - Read bytes bytes from server into file
- * @param fp    File handle for email file
+ * imap_notify_set - Ask the server to push the status of an account's mailboxes
  * @param adata Imap Account data
- * @param bytes Number of bytes to read
- * @param pbar  Progress bar
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Replace the NOTIFY set (RFC5465) of the connection with all the mailboxes of
+ * the account.  The server answers with a STATUS for each of them, then sends
+ * a new STATUS whenever one of them changes.  Events for the selected mailbox
+ * are still reported as EXISTS, EXPUNGE and FETCH responses.
+ */
+static int imap_notify_set(struct ImapAccountData *adata)
+{
+  struct Buffer *cmd = mutt_buffer_pool_get();
+  int count = 0;
+
+  mutt_buffer_addstr(cmd, "NOTIFY SET STATUS (SELECTED (MessageNew MessageExpunge "
+                          "FlagChange)) (MAILBOXES (");
+
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    if (imap_adata_get(np->mailbox) != adata)
+      continue;
+
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (!mdata)
+      continue;
+
+    mutt_buffer_add_printf(cmd, "%s%s", count ? " " : "", mdata->munge_name);
+    count++;
+  }
+  mutt_buffer_addstr(cmd, ") (MessageNew MessageExpunge FlagChange))");
+
+  adata->notify_stale = false;
+  int rc = -1;
+  if (count == 0)
+    goto done;
+
+  if (imap_exec(adata, mutt_b2s(cmd), IMAP_CMD_POLL) != IMAP_EXEC_SUCCESS)
+  {
+    mutt_debug(LL_DEBUG1, "NOTIFY failed, falling back to polling\n");
+    adata->capabilities &= ~IMAP_CAP_NOTIFY;
+    goto done;
+  }
+
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (mdata && (imap_adata_get(np->mailbox) == adata))
+      mdata->notify = true;
+  }
+  adata->notify = true;
+  rc = 0;
+
+done:
+  mutt_buffer_pool_release(&cmd);
+  return rc;
+}
+
+/**
+ * imap_list_status - Fetch the status of the pending mailboxes in one command
+ * @param adata Imap Account data
+ *
+ * Send a LIST with a STATUS return option (RFC5819) for the mailboxes that
+ * imap_status() has collected.  The STATUS responses are handled just like
+ * those of a STATUS command.
+ */
+static void imap_list_status(struct ImapAccountData *adata)
+{
+  if (mutt_buffer_is_empty(adata->liststatus))
+    return;
+
+  struct Buffer *cmd = mutt_buffer_pool_get();
+
+  /* Without LIST-EXTENDED, we can't ask for several patterns at once */
+  if (adata->capabilities & IMAP_CAP_LIST_EXTENDED)
+    mutt_buffer_printf(cmd, "LIST \"\" (%s)", mutt_b2s(adata->liststatus));
+  else
+    mutt_buffer_strcpy(cmd, "LIST \"\" \"*\"");
+  mutt_buffer_addstr(cmd, " RETURN (STATUS (MESSAGES RECENT UIDNEXT UIDVALIDITY UNSEEN))");
+  mutt_buffer_reset(adata->liststatus);
+
+  if (imap_exec(imap_pool_get(adata), mutt_b2s(cmd), IMAP_CMD_POLL) != IMAP_EXEC_SUCCESS)
+    mutt_debug(LL_DEBUG1, "Error fetching LIST-STATUS\n");
+
+  mutt_buffer_pool_release(&cmd);
+}
+
+/**
+ * watch_wanted - Should a mailbox have a watcher?
+ * @param adata Imap Account data
+ * @param m     Mailbox
+ * @retval true The mailbox matches $imap_idle_watch
+ */
+static bool watch_wanted(struct ImapAccountData *adata, struct Mailbox *m)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!mdata || !C_ImapIdleWatch || !C_ImapIdleWatch->regex ||
+      !(adata->capabilities & IMAP_CAP_IDLE))
+  {
+    return false;
+  }
+
+  /* the selected mailbox is IDLEd by the primary connection */
+  if (adata->mailbox && (adata->mailbox->mdata == mdata))
+    return false;
+
+  return (regexec(C_ImapIdleWatch->regex, mdata->name, 0, NULL, 0) == 0) ^
+         C_ImapIdleWatch->not;
+}
+
+/**
+ * watch_mailbox - Find the mailbox of a watcher
+ * @param adata Imap Account data
+ * @param wdata Watcher connection
+ * @retval ptr  Mailbox
+ * @retval NULL The mailbox is gone
+ */
+static struct Mailbox *watch_mailbox(struct ImapAccountData *adata,
+                                     struct ImapAccountData *wdata)
+{
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    struct ImapMboxData *mdata = imap_mdata_get(np->mailbox);
+    if (mdata && (imap_adata_get(np->mailbox) == adata) &&
+        (mutt_str_strcmp(mdata->name, wdata->watch) == 0))
+    {
+      return np->mailbox;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * imap_watch_update - Keep the watchers of an account up to date
+ * @param adata Imap Account data
+ *
+ * Every mailbox matching $imap_idle_watch, apart from the selected one, gets a
+ * connection of its own that IDLEs on it.  Such a mailbox isn't polled by
+ * imap_mbox_check_stats().  Its status is only refreshed when its watcher
+ * reports a change.
+ */
+static void imap_watch_update(struct ImapAccountData *adata)
+{
+  for (int i = 0; i < adata->numwatchers;)
+  {
+    struct ImapAccountData *wdata = adata->watchers[i];
+    struct Mailbox *m = watch_mailbox(adata, wdata);
+
+    if (m && watch_wanted(adata, m) && (wdata->state >= IMAP_SELECTED))
+    {
+      if (imap_watch_poll(wdata))
+        imap_mailbox_status(m, true);
+      i++;
+      continue;
+    }
+
+    /* retire the watcher, the mailbox will be polled again */
+    mutt_debug(LL_DEBUG2, "Stopped watching %s\n", wdata->watch);
+    if (m)
+      imap_mdata_get(m)->watched = false;
+    imap_logout(wdata);
+    imap_adata_free((void **) &wdata);
+    adata->watchers[i] = adata->watchers[--adata->numwatchers];
+  }
+
+  if (adata->watch_failed)
+    return;
+
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    struct Mailbox *m = np->mailbox;
+    struct ImapMboxData *mdata = imap_mdata_get(m);
+    if ((imap_adata_get(m) != adata) || !mdata || mdata->watched || !watch_wanted(adata, m))
+      continue;
+
+    struct ImapAccountData *wdata = imap_watch_open(adata, mdata);
+    if (!wdata)
+    {
+      /* don't keep hammering a server that limits the number of connections */
+      adata->watch_failed = true;
+      return;
+    }
+
+    mutt_mem_realloc(&adata->watchers, (adata->numwatchers + 1) * sizeof(struct ImapAccountData *));
+    adata->watchers[adata->numwatchers++] = wdata;
+    mdata->watched = true;
+
+    /* catch up with anything that changed before the watcher started */
+    imap_mailbox_status(m, true);
+  }
+}
+
+/**
+ * imap_mailbox_check_finish - Complete a check of all the mailboxes
+ *
+ * imap_status() only collects the work for most mailboxes.  Once all the
+ * mailboxes have been checked, send the batched LIST-STATUS and NOTIFY
+ * commands, read the status changes pushed by the server and by the watchers,
+ * and complete the commands queued on the connection pools.
+ */
+void imap_mailbox_check_finish(void)
+{
+  struct Account *np = NULL;
+  TAILQ_FOREACH(np, &AllAccounts, entries)
+  {
+    if (np->magic != MUTT_IMAP)
+      continue;
+
+    struct ImapAccountData *adata = np->adata;
+    if (!adata || (adata->state < IMAP_AUTHENTICATED))
+      continue;
+
+    if (adata->notify_stale)
+      imap_notify_set(adata);
+    /* A selected mailbox reads the pushed changes in imap_check_mailbox() */
+    else if (adata->notify && (adata->state == IMAP_AUTHENTICATED) &&
+             (mutt_socket_poll(adata->conn, 0) > 0))
+    {
+      imap_exec(adata, "NOOP", IMAP_CMD_POLL);
+    }
+
+    imap_watch_update(adata);
+    imap_list_status(adata);
+    imap_pool_drain(adata);
+  }
+}
+
+/**
+ * imap_read_literal - Read bytes bytes from server into file
+ * @param fp      File handle for email file
+ * @param adata   Imap Account data
+ * @param bytes   Number of bytes to read
+ * @param pbar    Progress bar
+ * @param partial If true, keep a `\r` at the very end of the literal
  * @retval  0 Success
  * @retval -1 Failure
  *
@@ -720,7 +1519,7 @@ void imap_logout_all(void)
  *       Apparently even literals use `\r\n`-terminated strings ?!
  */
 int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
-                      unsigned long bytes, struct Progress *pbar)
+                      unsigned long bytes, struct Progress *pbar, bool partial)
 {
   char c;
   bool r = false;
@@ -761,6 +1560,10 @@ int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
       mutt_buffer_addch(buf, c);
   }
 
+  /* a literal may end half-way through a line break, see msg_fetch_chunks() */
+  if (r && partial)
+    fputc('\r', fp);
+
   if (C_DebugLevel >= IMAP_LOG_LTRL)
   {
     mutt_debug(IMAP_LOG_LTRL, "\n%s", buf->data);
@@ -805,8 +1608,10 @@ void imap_expunge_mailbox(struct Mailbox *m)
       imap_hcache_del(mdata, imap_edata_get(e)->uid);
 #endif
 
-      mutt_hash_int_delete(mdata->uid_hash, imap_edata_get(e)->uid, e);
+      imap_uid_remove(&mdata->uid_index, imap_edata_get(e)->uid, e);
 
+      if (imap_edata_get(e)->stub)
+        mdata->stubs--;
       imap_edata_free((void **) &e->edata);
     }
     else
@@ -823,7 +1628,7 @@ void imap_expunge_mailbox(struct Mailbox *m)
        * The ctx_update_tables() will free and remove these "inactive" headers,
        * despite that an EXPUNGE was not received for them.
        * This would result in memory leaks and segfaults due to dangling
-       * pointers in the msn_index and uid_hash.
+       * pointers in the msn and uid_index.
        *
        * So this is another hack to work around the hacks.  We don't want to
        * remove the messages, so make sure active is on.
@@ -949,6 +1754,7 @@ void imap_close_connection(struct ImapAccountData *adata)
   adata->nextcmd = false;
   adata->lastcmd = false;
   adata->status = 0;
+  adata->notify = false;
   memset(adata->cmds, 0, sizeof(struct ImapCommand) * adata->cmdslots);
 }
 
@@ -1278,6 +2084,29 @@ static int imap_status(struct ImapAccountData *adata, struct ImapMboxData *mdata
     return mdata->messages;
   }
 
+  if (queue && C_ImapNotify && (adata->capabilities & IMAP_CAP_NOTIFY) &&
+      !mdata->unseen_stale)
+  {
+    /* the server will push any change, or the initial status when the
+     * mailbox is added to the NOTIFY set by imap_mailbox_check_finish() */
+    if (!adata->notify || !mdata->notify)
+      adata->notify_stale = true;
+    return mdata->messages;
+  }
+
+  if (queue && (adata->capabilities & IMAP_CAP_LIST_STATUS))
+  {
+    if ((mutt_buffer_len(adata->liststatus) + mutt_str_strlen(mdata->munge_name)) >= IMAP_MAX_CMDLEN)
+      imap_list_status(adata);
+    mutt_buffer_add_printf(adata->liststatus, "%s%s",
+                           mutt_buffer_is_empty(adata->liststatus) ? "" : " ",
+                           mdata->munge_name);
+    return mdata->messages;
+  }
+
+  /* keep the primary connection on the selected mailbox */
+  adata = imap_pool_get(adata);
+
   if (adata->capabilities & IMAP_CAP_IMAP4REV1)
     uid_validity_flag = "UIDVALIDITY";
   else if (adata->capabilities & IMAP_CAP_STATUS)
@@ -1305,6 +2134,11 @@ static int imap_status(struct ImapAccountData *adata, struct ImapMboxData *mdata
  */
 int imap_mbox_check_stats(struct Mailbox *m, int flags)
 {
+  /* a watcher reports any change, see imap_watch_update() */
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (mdata && mdata->watched)
+    return 0;
+
   int rc = imap_mailbox_status(m, true);
   if (rc > 0)
     rc = 0;
@@ -1355,33 +2189,160 @@ int imap_mailbox_status(struct Mailbox *m, bool queue)
  * imap_search - Find a matching mailbox
  * @param m   Mailbox
  * @param pat Pattern to match
+ * @retval  1 Success, the server searched every email, see compile_offload()
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The matching emails are marked with Email::matched.
  */
-int imap_search(struct Mailbox *m, const struct Pattern *pat)
+int imap_search(struct Mailbox *m, struct Pattern *pat)
 {
-  struct Buffer buf;
   struct ImapAccountData *adata = imap_adata_get(m);
   for (int i = 0; i < m->msg_count; i++)
     m->emails[i]->matched = false;
 
-  if (do_search(pat, 1) == 0)
-    return 0;
+  struct Buffer *keys = mutt_buffer_pool_get();
+  int rc = compile_offload(m, pat, keys);
+  if (rc < 0)
+    goto done;
 
-  mutt_buffer_init(&buf);
-  mutt_buffer_addstr(&buf, "UID SEARCH ");
-  if (compile_search(m, pat, &buf) < 0)
+  if (rc == 0)
   {
-    FREE(&buf.data);
-    return -1;
+    if (do_search(pat, 1) == 0)
+      goto done;
+    if (compile_search(m, pat, keys) < 0)
+    {
+      rc = -1;
+      goto done;
+    }
+  }
+
+  struct Buffer *cmd = mutt_buffer_pool_get();
+  mutt_buffer_printf(cmd, "UID SEARCH %s%s",
+                     (adata->capabilities & IMAP_CAP_ESEARCH) ? "RETURN (ALL) " : "",
+                     mutt_b2s(keys));
+  if (imap_exec(adata, mutt_b2s(cmd), 0) != IMAP_EXEC_SUCCESS)
+  {
+    clear_server_exact(pat);
+    rc = -1;
+  }
+  mutt_buffer_pool_release(&cmd);
+
+done:
+  mutt_buffer_pool_release(&keys);
+  return rc;
+}
+
+/**
+ * sort_criterion - Get the SORT criterion matching a sort method
+ * @param sort Sort method, e.g. #SORT_DATE
+ * @retval ptr  SORT criterion, "" if the server's default order matches
+ * @retval NULL The server can't sort this way
+ *
+ * Only the methods that the server sorts the same way as NeoMutt are
+ * supported.  Sorting by "from" or "to", for example, is done by address on
+ * the server, but by name locally.  The server's "subject" strips prefixes by
+ * the rules of RFC5256, not $reply_regex, and its "size" is the size of the
+ * whole message, not of the body.
+ */
+static const char *sort_criterion(short sort)
+{
+  switch (sort & SORT_MASK)
+  {
+    case SORT_DATE:
+      return "DATE";
+    case SORT_RECEIVED:
+      return "ARRIVAL";
+    case SORT_ORDER:
+      return "";
+    default:
+      return NULL;
   }
-  if (imap_exec(adata, buf.data, 0) != IMAP_EXEC_SUCCESS)
+}
+
+/**
+ * compare_sort_rank - Compare two emails by their server SORT rank - Implements ::sort_t
+ */
+static int compare_sort_rank(const void *a, const void *b)
+{
+  struct Email *ea = *(struct Email **) a;
+  struct Email *eb = *(struct Email **) b;
+  unsigned int ra = imap_edata_get(ea)->sort_rank;
+  unsigned int rb = imap_edata_get(eb)->sort_rank;
+
+  /* unranked emails go last */
+  if (ra != rb)
+  {
+    if (ra == 0)
+      return 1;
+    if (rb == 0)
+      return -1;
+    return (ra < rb) ? -1 : 1;
+  }
+  return ea->index - eb->index;
+}
+
+/**
+ * imap_sort_mailbox - Sort a mailbox using the server's SORT
+ * @param m Mailbox
+ * @retval  0 Success, the emails are sorted
+ * @retval -1 Failure, the caller should sort the emails itself
+ *
+ * If $imap_server_sort is set, use the SORT extension (RFC5256) to order the
+ * emails by $sort and $sort_aux, without looking at their headers.  The ranks
+ * are kept until the sort order changes or new emails arrive.
+ */
+int imap_sort_mailbox(struct Mailbox *m)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+
+  if (!C_ImapServerSort || !adata || !mdata || (adata->mailbox != m) ||
+      (adata->state < IMAP_SELECTED) || !(adata->capabilities & IMAP_CAP_SORT))
   {
-    FREE(&buf.data);
     return -1;
   }
 
-  FREE(&buf.data);
+  const char *primary = sort_criterion(C_Sort);
+  const char *secondary = sort_criterion(C_SortAux);
+  if (!primary || !secondary || !*primary)
+    return -1;
+
+  /* $sort_aux is applied before reversing by $sort */
+  const bool reverse = (C_Sort & SORT_REVERSE);
+  const bool reverse_aux = ((C_SortAux & SORT_REVERSE) != 0) ^ reverse;
+
+  /* the server always breaks ties in mailbox order */
+  if (!*secondary && reverse_aux)
+    return -1;
+
+  int key = (C_Sort << 16) | C_SortAux;
+  bool ranked = (mdata->sort_key == key);
+  for (int i = 0; ranked && (i < m->msg_count); i++)
+    ranked = (imap_edata_get(m->emails[i])->sort_rank != 0);
+
+  if (!ranked)
+  {
+    char cmd[128];
+
+    snprintf(cmd, sizeof(cmd), "UID SORT (%s%s%s%s%s) UTF-8 ALL",
+             reverse ? "REVERSE " : "", primary, *secondary ? " " : "",
+             (*secondary && reverse_aux) ? "REVERSE " : "", secondary);
+
+    for (int i = 0; i < m->msg_count; i++)
+      imap_edata_get(m->emails[i])->sort_rank = 0;
+    mdata->sort_key = 0;
+    mdata->sort_ranks = 0;
+
+    if (imap_exec(adata, cmd, IMAP_CMD_NO_FLAGS) != IMAP_EXEC_SUCCESS)
+    {
+      mutt_debug(LL_DEBUG1, "Server SORT failed, sorting locally\n");
+      return -1;
+    }
+    mdata->sort_key = key;
+  }
+
+  qsort(m->emails, m->msg_count, sizeof(struct Email *), compare_sort_rank);
   return 0;
 }
 
@@ -1730,6 +2691,10 @@ int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close)
   imap_hcache_close(mdata);
 #endif
 
+  /* the originals are only deleted once the server has stored the copies */
+  if (imap_append_finish(m) < 0)
+    return -1;
+
   /* presort here to avoid doing 10 resorts in imap_exec_msgset */
   oldsort = C_Sort;
   if (C_Sort != SORT_ORDER)
@@ -1742,15 +2707,7 @@ int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close)
     qsort(m->emails, m->msg_count, sizeof(struct Email *), mutt_get_sort_func(SORT_ORDER));
   }
 
-  rc = sync_helper(m, MUTT_ACL_DELETE, MUTT_DELETED, "\\Deleted");
-  if (rc >= 0)
-    rc |= sync_helper(m, MUTT_ACL_WRITE, MUTT_FLAG, "\\Flagged");
-  if (rc >= 0)
-    rc |= sync_helper(m, MUTT_ACL_WRITE, MUTT_OLD, "Old");
-  if (rc >= 0)
-    rc |= sync_helper(m, MUTT_ACL_SEEN, MUTT_READ, "\\Seen");
-  if (rc >= 0)
-    rc |= sync_helper(m, MUTT_ACL_WRITE, MUTT_REPLIED, "\\Answered");
+  rc = sync_flags(m);
 
   if (oldsort != C_Sort)
   {
@@ -1759,8 +2716,9 @@ int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close)
     m->emails = emails;
   }
 
-  /* Flush the queued flags if any were changed in sync_helper. */
-  if (rc > 0)
+  /* Flush the queued flags if any were changed in sync_flags.  All of them
+   * may already have been sent, see sync_flags_queue(). */
+  if ((rc > 0) && imap_cmd_pending(adata))
     if (imap_exec(adata, NULL, 0) != IMAP_EXEC_SUCCESS)
       rc = -1;
 
@@ -1781,10 +2739,22 @@ int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close)
 
   /* Update local record of server state to reflect the synchronization just
    * completed.  imap_read_headers always overwrites hcache-origin flags, so
-   * there is no need to mutate the hcache after flag-only changes. */
+   * there is no need to mutate the hcache after flag-only changes.
+   *
+   * Emails that failed an UNCHANGEDSINCE test keep their local changes;
+   * their flags are fetched again, to be merged by imap_set_flags(). */
+  struct Buffer *modified = mutt_buffer_new();
+  bool conflicts = false;
   for (int i = 0; i < m->msg_count; i++)
   {
     struct ImapEmailData *edata = imap_edata_get(m->emails[i]);
+    if (edata->modified)
+    {
+      edata->modified = false;
+      mutt_buffer_add_printf(modified, "%s%u", conflicts ? "," : "", edata->uid);
+      conflicts = true;
+      continue;
+    }
     edata->deleted = m->emails[i]->deleted;
     edata->flagged = m->emails[i]->flagged;
     edata->old = m->emails[i]->old;
@@ -1792,7 +2762,27 @@ int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close)
     edata->replied = m->emails[i]->replied;
     m->emails[i]->changed = false;
   }
-  m->changed = false;
+  m->changed = conflicts;
+
+#ifdef USE_HCACHE
+  /* Keep the snapshot in step with the server's flags */
+  if (adata->qresync)
+  {
+    mdata->hcache = imap_hcache_open(adata, mdata);
+    imap_hcache_store_snapshot(mdata);
+    imap_hcache_close(mdata);
+  }
+#endif
+
+  if (conflicts)
+  {
+    mutt_debug(LL_DEBUG1, "flags changed on the server: %s\n", mutt_b2s(modified));
+    struct Buffer *cmd = mutt_buffer_new();
+    mutt_buffer_add_printf(cmd, "UID FETCH %s (UID FLAGS MODSEQ)", mutt_b2s(modified));
+    imap_exec(adata, mutt_b2s(cmd), IMAP_CMD_NO_FLAGS);
+    mutt_buffer_free(&cmd);
+  }
+  mutt_buffer_free(&modified);
 
   /* We must send an EXPUNGE command if we're not closing. */
   if (expunge && !close && (m->rights & MUTT_ACL_DELETE))
@@ -2234,6 +3224,9 @@ static int imap_mbox_close(struct Mailbox *m)
   if (!adata || !mdata)
     return 0;
 
+  if (m->append)
+    imap_append_finish(m);
+
   /* imap_mbox_open_append() borrows the struct ImapAccountData temporarily,
    * just for the connection.
    *
@@ -2445,6 +3438,7 @@ static int imap_tags_commit(struct Mailbox *m, struct Email *e, char *buf)
   /* We are good sync them */
   mutt_debug(LL_DEBUG1, "NEW TAGS: %s\n", buf);
   driver_tags_replace(&e->tags, buf);
+  mutt_email_touch(e);
   FREE(&imap_edata_get(e)->flags_remote);
   imap_edata_get(e)->flags_remote = driver_tags_get_with_hidden(&e->tags);
   return 0;
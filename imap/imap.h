@@ -55,9 +55,11 @@
 
 struct BrowserState;
 struct ConnAccount;
+struct Email;
 struct EmailList;
 struct Mailbox;
 struct Pattern;
+struct Regex;
 struct stat;
 
 /* These Config Variables are only used in imap/auth.c */
@@ -65,11 +67,17 @@ extern char *C_ImapAuthenticators;
 
 /* These Config Variables are only used in imap/imap.c */
 extern bool C_ImapIdle;
+extern struct Regex *C_ImapIdleWatch;
+extern bool C_ImapNotify;
+extern bool C_ImapServerSort;
 
 /* These Config Variables are only used in imap/message.c */
+extern long C_ImapFetchChunkSize;
 extern char *C_ImapHeaders;
+extern short C_ImapLazyHeaders;
 
 /* These Config Variables are only used in imap/command.c */
+extern short C_ImapConnections;
 extern bool C_ImapServernoise;
 
 /* These Config Variables are only used in imap/util.c */
@@ -83,12 +91,14 @@ int imap_delete_mailbox(struct Mailbox *m, char *path);
 int imap_sync_mailbox(struct Mailbox *m, bool expunge, bool close);
 int imap_path_status(const char *path, bool queue);
 int imap_mailbox_status(struct Mailbox *m, bool queue);
-int imap_search(struct Mailbox *m, const struct Pattern *pat);
+int imap_search(struct Mailbox *m, struct Pattern *pat);
+int imap_sort_mailbox(struct Mailbox *m);
 int imap_subscribe(char *path, bool subscribe);
 int imap_complete(char *buf, size_t buflen, char *path);
 int imap_fast_trash(struct Mailbox *m, char *dest);
 int imap_path_probe(const char *path, const struct stat *st);
 int imap_path_canon(char *buf, size_t buflen);
+void imap_mailbox_check_finish(void);
 
 extern struct MxOps MxImapOps;
 
@@ -98,7 +108,12 @@ int imap_mailbox_create(const char *folder);
 int imap_mailbox_rename(const char *path);
 
 /* message.c */
+int imap_append_finish(struct Mailbox *m);
 int imap_copy_messages(struct Mailbox *m, struct EmailList *el, char *dest, bool delete);
+int imap_load_email_headers(struct Mailbox *m, struct Email *e);
+int imap_load_headers(struct Mailbox *m);
+int imap_load_matched_headers(struct Mailbox *m);
+int imap_load_visible_headers(struct Mailbox *m, int top, int pagelen);
 
 /* socket.c */
 void imap_logout_all(void);
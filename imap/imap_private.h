@@ -33,6 +33,7 @@
 #include "mutt/mutt.h"
 #include "config/lib.h"
 #include "conn/conn.h"
+#include "msn.h"
 #ifdef USE_HCACHE
 #include "hcache/hcache.h"
 #endif
@@ -76,6 +77,7 @@ typedef uint8_t ImapCmdFlags;          ///< Flags for imap_exec(), e.g. #IMAP_CM
 #define IMAP_CMD_PASS        (1 << 0)  ///< Command contains a password. Suppress logging
 #define IMAP_CMD_QUEUE       (1 << 1)  ///< Queue a command, do not execute
 #define IMAP_CMD_POLL        (1 << 2)  ///< Poll the tcp connection before running the imap command
+#define IMAP_CMD_APPEND      (1 << 3)  ///< Pipelined APPEND, failures are counted, not returned
 
 /**
  * enum ImapExecResult - imap_exec return code
@@ -138,8 +140,15 @@ typedef uint32_t ImapCapFlags;              ///< Flags, e.g. #IMAP_CAP_IMAP4
 #define IMAP_CAP_CONDSTORE        (1 << 14) ///< RFC7162
 #define IMAP_CAP_QRESYNC          (1 << 15) ///< RFC7162
 #define IMAP_CAP_X_GM_EXT_1       (1 << 16) ///< https://developers.google.com/gmail/imap/imap-extensions
+#define IMAP_CAP_LIST_EXTENDED    (1 << 17) ///< RFC5258: LIST command extensions
+#define IMAP_CAP_LIST_STATUS      (1 << 18) ///< RFC5819: STATUS in extended LIST
+#define IMAP_CAP_NOTIFY           (1 << 19) ///< RFC5465: NOTIFY
+#define IMAP_CAP_SORT             (1 << 20) ///< RFC5256: SORT
+#define IMAP_CAP_LITERALPLUS      (1 << 21) ///< RFC7888: LITERAL+
+#define IMAP_CAP_MULTIAPPEND      (1 << 22) ///< RFC3502: MULTIAPPEND
+#define IMAP_CAP_ESEARCH          (1 << 23) ///< RFC4731: ESEARCH
 
-#define IMAP_CAP_ALL             ((1 << 17) - 1)
+#define IMAP_CAP_ALL             ((1 << 24) - 1)
 
 /**
  * struct ImapList - Items in an IMAP browser
@@ -159,6 +168,7 @@ struct ImapCommand
 {
   char seq[SEQLEN + 1]; ///< Command tag, e.g. 'a0001'
   int state;            ///< Command state, e.g. #IMAP_CMD_NEW
+  bool append;          ///< Pipelined APPEND, see imap_cmd_append()
 };
 
 /**
@@ -192,6 +202,9 @@ struct ImapAccountData
 
   bool unicode; /* If true, we can send UTF-8, and the server will use UTF8 rather than mUTF7 */
   bool qresync; /* true, if QRESYNC is successfully ENABLE'd */
+  bool notify;  /* true, if the server pushes status changes, see imap_notify_set() */
+  bool notify_stale; /* true, if the NOTIFY set is missing some mailboxes */
+  struct Buffer *liststatus; /* mailboxes waiting for a LIST-STATUS */
 
   /* if set, the response parser will store results for complicated commands
    * here. */
@@ -206,8 +219,65 @@ struct ImapAccountData
 
   char delim;
   struct Mailbox *mailbox;     /* Current selected mailbox */
+
+  /* secondary connections to the same account, see imap_pool_get() */
+  struct ImapAccountData **pool;
+  int poolsize; /* number of connections in the pool */
+  int poolmax;  /* maximum number of connections the pool may grow to */
+  int poolnext; /* next connection to hand out, round-robin */
+  bool pooled;  /* true, if this is a secondary connection of a pool */
+
+  /* connections IDLEing on other mailboxes, see imap_watch_open() */
+  struct ImapAccountData **watchers;
+  int numwatchers;
+  bool watch_failed; /* true, if the server refused another watcher */
+  char *watch;       /* name of the mailbox this watcher connection IDLEs on */
+  bool watch_changed; /* true, if the watched mailbox has changed */
+
+  /* pipelined APPENDs, see imap_append_message() */
+  bool appending; /* true, if a MULTIAPPEND is in progress on this connection */
+  unsigned int append_errors; /* number of pipelined APPENDs that failed */
+};
+
+#ifdef USE_HCACHE
+#define IMAP_SNAPSHOT_VERSION 1 ///< Bump if struct ImapSnapshot changes
+
+/* Flags of an ImapSnapshotEntry */
+#define IMAP_SNAP_READ     (1 << 0) ///< Seen flag
+#define IMAP_SNAP_OLD      (1 << 1) ///< Old flag
+#define IMAP_SNAP_DELETED  (1 << 2) ///< Deleted flag
+#define IMAP_SNAP_FLAGGED  (1 << 3) ///< Flagged flag
+#define IMAP_SNAP_REPLIED  (1 << 4) ///< Answered flag
+
+/**
+ * struct ImapSnapshotEntry - One email of an ImapSnapshot
+ */
+struct ImapSnapshotEntry
+{
+  uint32_t uid;      ///< UID of the email
+  uint32_t flags;    ///< Server flags, e.g. #IMAP_SNAP_READ
+  uint64_t size;     ///< Size of the whole email
+  int64_t received;  ///< INTERNALDATE of the email
 };
 
+/**
+ * struct ImapSnapshot - The state of a mailbox, stored in the header cache
+ *
+ * This is enough to rebuild the index of a mailbox from a single hcache read,
+ * before asking a QRESYNC server what has changed since.  The headers are
+ * read from the hcache on demand, see imap_load_headers().
+ */
+struct ImapSnapshot
+{
+  uint32_t version;      ///< #IMAP_SNAPSHOT_VERSION
+  uint32_t uid_validity; ///< UIDVALIDITY of the mailbox
+  uint32_t uid_next;     ///< UIDNEXT of the mailbox
+  uint32_t count;        ///< Number of entries
+  uint64_t modseq;       ///< HIGHESTMODSEQ the flags are valid for
+  struct ImapSnapshotEntry entries[]; ///< Emails, in MSN order
+};
+#endif
+
 /**
  * struct ImapMboxData - IMAP-specific Mailbox data - @extends Mailbox
  *
@@ -222,23 +292,33 @@ struct ImapMboxData
   ImapOpenFlags reopen;        /**< Flags, e.g. #IMAP_REOPEN_ALLOW */
   ImapOpenFlags check_status;  /**< Flags, e.g. #IMAP_NEWMAIL_PENDING */
   unsigned int new_mail_count; /**< Set when EXISTS notifies of new mail */
+  bool notify;                 /**< Part of the account's NOTIFY set */
+  bool unseen_stale;           /**< A pushed STATUS changed MESSAGES without UNSEEN */
+  bool watched;                /**< A watcher connection IDLEs on it */
 
   // IMAP STATUS information
   struct ListHead flags;
   unsigned int uid_validity;
   unsigned int uid_next;
   unsigned long long modseq;
+  unsigned long long modseq_seen; /**< Highest MODSEQ seen in a FETCH response */
   unsigned int messages;
   unsigned int recent;
   unsigned int unseen;
 
   // Cached data used only when the mailbox is opened
-  struct Hash *uid_hash;
-  struct Email **msn_index;   /**< look up headers by (MSN-1) */
-  size_t msn_index_size;       /**< allocation size */
-  unsigned int max_msn;        /**< the largest MSN fetched so far */
+  struct UidIndex uid_index;   /**< look up headers by UID */
+  struct MsnIndex msn;         /**< look up headers by MSN */
+  unsigned int stubs;          /**< Number of emails whose headers haven't been fetched */
+  int sort_key;                /**< $sort and $sort_aux of the server's SORT ranks */
+  unsigned int sort_ranks;     /**< Number of emails ranked by the server's SORT */
   struct BodyCache *bcache;
 
+  // Used only when the mailbox is opened for appending
+  struct ImapAccountData *append_adata; /**< Connection carrying pipelined APPENDs */
+  unsigned int appended;       /**< Number of messages appended so far */
+  bool multiappend;            /**< A MULTIAPPEND command is still open */
+
 #ifdef USE_HCACHE
   header_cache_t *hcache;
 #endif
@@ -268,7 +348,7 @@ int imap_exec_msgset(struct Mailbox *m, const char *pre, const char *post,
                      int flag, bool changed, bool invert);
 int imap_open_connection(struct ImapAccountData *adata);
 void imap_close_connection(struct ImapAccountData *adata);
-int imap_read_literal(FILE *fp, struct ImapAccountData *adata, unsigned long bytes, struct Progress *pbar);
+int imap_read_literal(FILE *fp, struct ImapAccountData *adata, unsigned long bytes, struct Progress *pbar, bool partial);
 void imap_expunge_mailbox(struct Mailbox *m);
 int imap_login(struct ImapAccountData *adata);
 int imap_sync_message_for_copy(struct Mailbox *m, struct Email *e, struct Buffer *cmd, enum QuadOption *err_continue);
@@ -281,11 +361,17 @@ int imap_authenticate(struct ImapAccountData *adata);
 /* command.c */
 int imap_cmd_start(struct ImapAccountData *adata, const char *cmdstr);
 int imap_cmd_step(struct ImapAccountData *adata);
+int imap_cmd_append(struct ImapAccountData *adata, const char *cmdstr);
+bool imap_cmd_pending(struct ImapAccountData *adata);
 void imap_cmd_finish(struct ImapAccountData *adata);
 bool imap_code(const char *s);
 const char *imap_cmd_trailer(struct ImapAccountData *adata);
 int imap_exec(struct ImapAccountData *adata, const char *cmdstr, ImapCmdFlags flags);
 int imap_cmd_idle(struct ImapAccountData *adata);
+struct ImapAccountData *imap_pool_get(struct ImapAccountData *adata);
+void imap_pool_drain(struct ImapAccountData *adata);
+struct ImapAccountData *imap_watch_open(struct ImapAccountData *adata, struct ImapMboxData *mdata);
+bool imap_watch_poll(struct ImapAccountData *wdata);
 
 /* message.c */
 void imap_edata_free(void **ptr);
@@ -313,6 +399,9 @@ int imap_hcache_del(struct ImapMboxData *mdata, unsigned int uid);
 int imap_hcache_store_uid_seqset(struct ImapMboxData *mdata);
 int imap_hcache_clear_uid_seqset(struct ImapMboxData *mdata);
 char *imap_hcache_get_uid_seqset(struct ImapMboxData *mdata);
+int imap_hcache_store_snapshot(struct ImapMboxData *mdata);
+int imap_hcache_clear_snapshot(struct ImapMboxData *mdata);
+struct ImapSnapshot *imap_hcache_get_snapshot(struct ImapMboxData *mdata);
 #endif
 
 enum QuadOption imap_continue(const char *msg, const char *resp);
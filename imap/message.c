@@ -49,12 +49,15 @@
 #include "mailbox.h"
 #include "mutt_account.h"
 #include "mutt_curses.h"
+#include "mutt_header.h"
 #include "mutt_logging.h"
 #include "mutt_socket.h"
 #include "muttlib.h"
 #include "mx.h"
+#include "ncrypt/ncrypt.h"
 #include "progress.h"
 #include "protos.h"
+#include "score.h"
 #ifdef USE_HCACHE
 #include "hcache/hcache.h"
 #endif
@@ -65,7 +68,15 @@
 struct BodyCache;
 
 /* These Config Variables are only used in imap/message.c */
+long C_ImapFetchChunkSize; ///< Config: (imap) Download messages in pieces of this size
 char *C_ImapHeaders; ///< Config: (imap) Additional email headers to download when getting index
+short C_ImapLazyHeaders; ///< Config: (imap) Fetch headers on demand in mailboxes larger than this
+
+/* Headers fetched for the index */
+static const char *const want_headers =
+    "DATE FROM SENDER SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE "
+    "CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL "
+    "X-ORIGINAL-TO";
 
 /**
  * imap_edata_free - free ImapHeader structure
@@ -205,7 +216,7 @@ static int msg_cache_clean_cb(const char *id, struct BodyCache *bcache, void *da
     return 0;
 
   /* bad UID */
-  if ((uv != mdata->uid_validity) || !mutt_hash_int_find(mdata->uid_hash, uid))
+  if ((uv != mdata->uid_validity) || !imap_uid_find(&mdata->uid_index, uid))
     mutt_bcache_del(bcache, id);
 
   return 0;
@@ -469,7 +480,7 @@ static int msg_fetch_header(struct Mailbox *m, struct ImapHeader *ih, char *buf,
 
   if (imap_get_literal_count(buf, &bytes) == 0)
   {
-    imap_read_literal(fp, adata, bytes, NULL);
+    imap_read_literal(fp, adata, bytes, NULL, false);
 
     /* we may have other fields of the FETCH _after_ the literal
      * (eg Domino puts FLAGS here). Nothing wrong with that, either.
@@ -528,60 +539,6 @@ static bool query_abort_header_download(struct ImapAccountData *adata)
   return abort;
 }
 
-/**
- * alloc_msn_index - Create lookup table of MSN to Header
- * @param adata Imap Account data
- * @param msn_count Number of MSNs in use
- *
- * Mapping from Message Sequence Number to Header
- */
-static void alloc_msn_index(struct ImapAccountData *adata, size_t msn_count)
-{
-  struct ImapMboxData *mdata = adata->mailbox->mdata;
-  size_t new_size;
-
-  if (msn_count <= mdata->msn_index_size)
-    return;
-
-  /* This is a conservative check to protect against a malicious imap
-   * server.  Most likely size_t is bigger than an unsigned int, but
-   * if msn_count is this big, we have a serious problem. */
-  if (msn_count >= (UINT_MAX / sizeof(struct Email *)))
-  {
-    mutt_error(_("Out of memory"));
-    mutt_exit(1);
-  }
-
-  /* Add a little padding, like mx_allloc_memory() */
-  new_size = msn_count + 25;
-
-  if (!mdata->msn_index)
-    mdata->msn_index = mutt_mem_calloc(new_size, sizeof(struct Email *));
-  else
-  {
-    mutt_mem_realloc(&mdata->msn_index, sizeof(struct Email *) * new_size);
-    memset(mdata->msn_index + mdata->msn_index_size, 0,
-           sizeof(struct Email *) * (new_size - mdata->msn_index_size));
-  }
-
-  mdata->msn_index_size = new_size;
-}
-
-/**
- * imap_alloc_uid_hash - Create a Hash Table for the UIDs
- * @param adata Imap Account data
- * @param msn_count Number of MSNs in use
- *
- * This function is run after imap_alloc_msn_index, so we skip the
- * malicious msn_count size check.
- */
-static void imap_alloc_uid_hash(struct ImapAccountData *adata, unsigned int msn_count)
-{
-  struct ImapMboxData *mdata = adata->mailbox->mdata;
-  if (!mdata->uid_hash)
-    mdata->uid_hash = mutt_hash_int_new(MAX(6 * msn_count / 5, 30), 0);
-}
-
 /**
  * imap_fetch_msn_seqset - Generate a sequence set
  * @param b         Buffer for the result
@@ -607,7 +564,7 @@ static void imap_fetch_msn_seqset(struct Buffer *b, struct ImapAccountData *adat
 
   for (unsigned int msn = msn_begin; msn <= (msn_end + 1); msn++)
   {
-    if ((msn <= msn_end) && !mdata->msn_index[msn - 1])
+    if ((msn <= msn_end) && !imap_msn_get(&mdata->msn, msn))
     {
       switch (state)
       {
@@ -760,7 +717,7 @@ static int read_headers_normal_eval_cache(struct ImapAccountData *adata,
         continue;
       }
 
-      if (mdata->msn_index[h.edata->msn - 1])
+      if (imap_msn_get(&mdata->msn, h.edata->msn))
       {
         mutt_debug(LL_DEBUG2, "skipping hcache FETCH for duplicate message %d\n",
                    h.edata->msn);
@@ -770,10 +727,6 @@ static int read_headers_normal_eval_cache(struct ImapAccountData *adata,
       m->emails[idx] = imap_hcache_get(mdata, h.edata->uid);
       if (m->emails[idx])
       {
-        mdata->max_msn = MAX(mdata->max_msn, h.edata->msn);
-        mdata->msn_index[h.edata->msn - 1] = m->emails[idx];
-        mutt_hash_int_insert(mdata->uid_hash, h.edata->uid, m->emails[idx]);
-
         m->emails[idx]->index = idx;
         /* messages which have not been expunged are ACTIVE (borrowed from mh
          * folders) */
@@ -799,6 +752,8 @@ static int read_headers_normal_eval_cache(struct ImapAccountData *adata,
         /*  mailbox->emails[msgno]->received is restored from mutt_hcache_restore */
         m->emails[idx]->edata = h.edata;
         m->emails[idx]->free_edata = imap_edata_free;
+        imap_msn_set(&mdata->msn, h.edata->msn, m->emails[idx]);
+        imap_uid_insert(&mdata->uid_index, h.edata->uid, m->emails[idx]);
         STAILQ_INIT(&m->emails[idx]->tags);
 
         /* We take a copy of the tags so we can split the string */
@@ -857,16 +812,10 @@ static int read_headers_qresync_eval_cache(struct ImapAccountData *adata, char *
   while ((rc = mutt_seqset_iterator_next(iter, &uid)) == 0)
   {
     /* The seqset may contain more headers than the fetch request, so
-     * we need to watch and reallocate the context and msn_index */
-    if (msn > mdata->msn_index_size)
-      alloc_msn_index(adata, msn);
-
+     * we need to watch and reallocate the context */
     struct Email *e = imap_hcache_get(mdata, uid);
     if (e)
     {
-      mdata->max_msn = MAX(mdata->max_msn, msn);
-      mdata->msn_index[msn - 1] = e;
-
       if (m->msg_count >= m->email_max)
         mx_alloc_memory(m);
 
@@ -885,7 +834,8 @@ static int read_headers_qresync_eval_cache(struct ImapAccountData *adata, char *
 
       edata->msn = msn;
       edata->uid = uid;
-      mutt_hash_int_insert(mdata->uid_hash, uid, e);
+      imap_msn_set(&mdata->msn, msn, e);
+      imap_uid_insert(&mdata->uid_index, uid, e);
 
       m->size += e->content->length;
       m->emails[m->msg_count++] = e;
@@ -899,6 +849,68 @@ static int read_headers_qresync_eval_cache(struct ImapAccountData *adata, char *
   return rc;
 }
 
+/**
+ * read_headers_snapshot_eval_cache - Rebuild the index from a snapshot
+ * @param adata Imap Account data
+ * @param snap  Snapshot from the header cache
+ *
+ * The emails are created as stubs, with the flags, size and date from the
+ * snapshot.  Their headers are read from the header cache later, see
+ * load_stubs().
+ */
+static void read_headers_snapshot_eval_cache(struct ImapAccountData *adata,
+                                             const struct ImapSnapshot *snap)
+{
+  struct Mailbox *m = adata->mailbox;
+  struct ImapMboxData *mdata = adata->mailbox->mdata;
+
+  mutt_debug(LL_DEBUG2, "Reading snapshot of %u emails from header cache\n", snap->count);
+
+  for (unsigned int i = 0; i < snap->count; i++)
+  {
+    const struct ImapSnapshotEntry *entry = &snap->entries[i];
+
+    if (m->msg_count >= m->email_max)
+      mx_alloc_memory(m);
+
+    struct Email *e = mutt_email_new();
+    struct ImapEmailData *edata = imap_edata_new();
+    e->edata = edata;
+    e->free_edata = imap_edata_free;
+
+    edata->read = (entry->flags & IMAP_SNAP_READ);
+    edata->old = (entry->flags & IMAP_SNAP_OLD);
+    edata->deleted = (entry->flags & IMAP_SNAP_DELETED);
+    edata->flagged = (entry->flags & IMAP_SNAP_FLAGGED);
+    edata->replied = (entry->flags & IMAP_SNAP_REPLIED);
+    edata->msn = i + 1;
+    edata->uid = entry->uid;
+    edata->stub = true;
+
+    e->index = m->msg_count;
+    e->active = true;
+    e->changed = false;
+    e->read = edata->read;
+    e->old = edata->old;
+    e->deleted = edata->deleted;
+    e->flagged = edata->flagged;
+    e->replied = edata->replied;
+    /* sort by date still works, using the INTERNALDATE */
+    e->received = entry->received;
+    e->date_sent = entry->received;
+    e->env = mutt_env_new();
+    e->content = mutt_body_new();
+    e->content->length = entry->size;
+
+    imap_msn_set(&mdata->msn, edata->msn, e);
+    imap_uid_insert(&mdata->uid_index, edata->uid, e);
+    mdata->stubs++;
+
+    m->size += entry->size;
+    m->emails[m->msg_count++] = e;
+  }
+}
+
 /**
  * read_headers_condstore_qresync_updates - Retrieve updates from the server
  * @param adata        Imap Account data
@@ -954,14 +966,14 @@ static int read_headers_condstore_qresync_updates(struct ImapAccountData *adata,
     if (!isdigit((unsigned char) *fetch_buf) || (mutt_str_atoui(fetch_buf, &header_msn) < 0))
       continue;
 
-    if ((header_msn < 1) || (header_msn > msn_end) || !mdata->msn_index[header_msn - 1])
+    if ((header_msn < 1) || (header_msn > msn_end) || !imap_msn_get(&mdata->msn, header_msn))
     {
       mutt_debug(LL_DEBUG1, "skipping CONDSTORE flag update for unknown message number %u\n",
                  header_msn);
       continue;
     }
 
-    imap_hcache_put(mdata, mdata->msn_index[header_msn - 1]);
+    imap_hcache_put(mdata, imap_msn_get(&mdata->msn, header_msn));
   }
 
   /* The IMAP flag setting as part of cmd_parse_fetch() ends up
@@ -993,6 +1005,36 @@ static int read_headers_condstore_qresync_updates(struct ImapAccountData *adata,
 }
 #endif /* USE_HCACHE */
 
+/**
+ * msg_header_request - Get the FETCH item for the headers of the index
+ * @param adata Imap Account data
+ * @retval ptr  FETCH item, e.g. "BODY.PEEK[HEADER.FIELDS (...)]"
+ * @retval NULL The server is too old
+ *
+ * The caller must free the returned string.
+ */
+static char *msg_header_request(struct ImapAccountData *adata)
+{
+  char *hdrreq = NULL;
+
+  if (adata->capabilities & IMAP_CAP_IMAP4REV1)
+  {
+    safe_asprintf(&hdrreq, "BODY.PEEK[HEADER.FIELDS (%s%s%s)]", want_headers,
+                  C_ImapHeaders ? " " : "", NONULL(C_ImapHeaders));
+  }
+  else if (adata->capabilities & IMAP_CAP_IMAP4)
+  {
+    safe_asprintf(&hdrreq, "RFC822.HEADER.LINES (%s%s%s)", want_headers,
+                  C_ImapHeaders ? " " : "", NONULL(C_ImapHeaders));
+  }
+  else
+  { /* Unable to fetch headers for lower versions */
+    mutt_error(_("Unable to fetch headers from this IMAP server version"));
+  }
+
+  return hdrreq;
+}
+
 /**
  * read_headers_fetch_new - Retrieve new messages from the server
  * @param[in]  m                Imap Selected Mailbox
@@ -1015,10 +1057,6 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
   char tempfile[_POSIX_PATH_MAX];
   FILE *fp = NULL;
   struct ImapHeader h;
-  static const char *const want_headers =
-      "DATE FROM SENDER SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE "
-      "CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL "
-      "X-ORIGINAL-TO";
 
   struct ImapAccountData *adata = imap_adata_get(m);
   struct ImapMboxData *mdata = imap_mdata_get(m);
@@ -1027,21 +1065,14 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
   if (!adata || (adata->mailbox != m))
     return -1;
 
-  if (adata->capabilities & IMAP_CAP_IMAP4REV1)
-  {
-    safe_asprintf(&hdrreq, "BODY.PEEK[HEADER.FIELDS (%s%s%s)]", want_headers,
-                  C_ImapHeaders ? " " : "", NONULL(C_ImapHeaders));
-  }
-  else if (adata->capabilities & IMAP_CAP_IMAP4)
-  {
-    safe_asprintf(&hdrreq, "RFC822.HEADER.LINES (%s%s%s)", want_headers,
-                  C_ImapHeaders ? " " : "", NONULL(C_ImapHeaders));
-  }
-  else
-  { /* Unable to fetch headers for lower versions */
-    mutt_error(_("Unable to fetch headers from this IMAP server version"));
+  hdrreq = msg_header_request(adata);
+  if (!hdrreq)
     goto bail;
-  }
+
+  /* In a large mailbox, only create stubs.  The headers will be fetched when
+   * they are needed, see imap_load_headers() */
+  const bool lazy = initial_download && (C_ImapLazyHeaders > 0) && (msn_begin <= msn_end) &&
+                    ((msn_end - msn_begin + 1) > (unsigned int) C_ImapLazyHeaders);
 
   /* instead of downloading all headers and then parsing them, we parse them
    * as they come in. */
@@ -1071,7 +1102,8 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
 
     fetch_msn_end = msn_end;
     char *cmd = NULL;
-    safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE %s)", b->data, hdrreq);
+    safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE%s%s)",
+                  b->data, lazy ? "" : " ", lazy ? "" : hdrreq);
     imap_cmd_start(adata, cmd);
     FREE(&cmd);
     mutt_buffer_free(&b);
@@ -1101,7 +1133,7 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
         if (mfhrc < 0)
           continue;
 
-        if (!ftello(fp))
+        if (!lazy && !ftello(fp))
         {
           mutt_debug(LL_DEBUG2, "ignoring fetch response with no body\n");
           continue;
@@ -1118,7 +1150,7 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
         }
 
         /* May receive FLAGS updates in a separate untagged response (#2935) */
-        if (mdata->msn_index[h.edata->msn - 1])
+        if (imap_msn_get(&mdata->msn, h.edata->msn))
         {
           mutt_debug(LL_DEBUG2, "skipping FETCH response for duplicate message %d\n",
                      h.edata->msn);
@@ -1127,10 +1159,6 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
 
         m->emails[idx] = mutt_email_new();
 
-        mdata->max_msn = MAX(mdata->max_msn, h.edata->msn);
-        mdata->msn_index[h.edata->msn - 1] = m->emails[idx];
-        mutt_hash_int_insert(mdata->uid_hash, h.edata->uid, m->emails[idx]);
-
         m->emails[idx]->index = idx;
         /* messages which have not been expunged are ACTIVE (borrowed from mh
          * folders) */
@@ -1144,6 +1172,8 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
         m->emails[idx]->received = h.received;
         m->emails[idx]->edata = (void *) (h.edata);
         m->emails[idx]->free_edata = imap_edata_free;
+        imap_msn_set(&mdata->msn, h.edata->msn, m->emails[idx]);
+        imap_uid_insert(&mdata->uid_index, h.edata->uid, m->emails[idx]);
         STAILQ_INIT(&m->emails[idx]->tags);
 
         /* We take a copy of the tags so we can split the string */
@@ -1154,16 +1184,29 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
         if (*maxuid < h.edata->uid)
           *maxuid = h.edata->uid;
 
-        rewind(fp);
-        /* NOTE: if Date: header is missing, mutt_rfc822_read_header depends
-         *   on h.received being set */
-        m->emails[idx]->env = mutt_rfc822_read_header(fp, m->emails[idx], false, false);
+        if (lazy)
+        {
+          /* sort by date still works, using the INTERNALDATE */
+          m->emails[idx]->env = mutt_env_new();
+          m->emails[idx]->content = mutt_body_new();
+          m->emails[idx]->date_sent = h.received;
+          h.edata->stub = true;
+          mdata->stubs++;
+        }
+        else
+        {
+          rewind(fp);
+          /* NOTE: if Date: header is missing, mutt_rfc822_read_header depends
+           *   on h.received being set */
+          m->emails[idx]->env = mutt_rfc822_read_header(fp, m->emails[idx], false, false);
+        }
         /* content built as a side-effect of mutt_rfc822_read_header */
         m->emails[idx]->content->length = h.content_length;
         m->size += h.content_length;
 
 #ifdef USE_HCACHE
-        imap_hcache_put(mdata, m->emails[idx]);
+        if (!lazy)
+          imap_hcache_put(mdata, m->emails[idx]);
 #endif /* USE_HCACHE */
 
         m->msg_count++;
@@ -1182,16 +1225,16 @@ static int read_headers_fetch_new(struct Mailbox *m, unsigned int msn_begin,
      *
      * Note: The RFC says we shouldn't get any EXPUNGE responses in the
      * middle of a FETCH.  But just to be cautious, use the current state
-     * of max_msn, not fetch_msn_end to set the next start range.  */
+     * of the highest MSN, not fetch_msn_end to set the next start range.  */
     if (mdata->reopen & IMAP_NEWMAIL_PENDING)
     {
       /* update to the last value we actually pulled down */
-      fetch_msn_end = mdata->max_msn;
-      msn_begin = mdata->max_msn + 1;
+      fetch_msn_end = imap_msn_highest(&mdata->msn);
+      msn_begin = fetch_msn_end + 1;
       msn_end = mdata->new_mail_count;
       while (msn_end > m->email_max)
         mx_alloc_memory(m);
-      alloc_msn_index(adata, msn_end);
+      imap_msn_reserve(&mdata->msn, msn_end);
       mdata->reopen &= ~IMAP_NEWMAIL_PENDING;
       mdata->new_mail_count = 0;
     }
@@ -1206,6 +1249,231 @@ bail:
   return retval;
 }
 
+/**
+ * stub_loaded - Finish a stub email whose real headers have been read
+ * @param m Mailbox
+ * @param e Email
+ *
+ * The stub was coloured with empty headers, and couldn't be in the Mailbox's
+ * hash tables.  It must be scored again too, but only once no command is in
+ * progress: a score pattern may need to fetch the message.
+ */
+static void stub_loaded(struct Mailbox *m, struct Email *e)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+
+  if (m->id_hash && e->env->message_id)
+    mutt_hash_insert(m->id_hash, e->env->message_id, e);
+  if (m->subj_hash && e->env->real_subj)
+    mutt_hash_insert(m->subj_hash, e->env->real_subj, e);
+  mutt_label_hash_add(m, e);
+
+  if (WithCrypto)
+    e->security = crypt_query(e->content);
+
+  mutt_email_touch(e);
+  e->pair = 0;
+
+  imap_edata_get(e)->stub = false;
+  mdata->stubs--;
+}
+
+#ifdef USE_HCACHE
+/**
+ * stub_from_hcache - Complete a stub email from the header cache
+ * @param m      Mailbox
+ * @param e      Stub email
+ * @param cached Email from the header cache, will be freed
+ *
+ * The headers are taken from the cache, but the flags are kept: the stub's
+ * are newer.
+ */
+static void stub_from_hcache(struct Mailbox *m, struct Email *e, struct Email *cached)
+{
+  mutt_env_free(&e->env);
+  mutt_body_free(&e->content);
+  e->env = cached->env;
+  cached->env = NULL;
+  e->content = cached->content;
+  cached->content = NULL;
+
+  e->security = cached->security;
+  e->mime = cached->mime;
+  e->date_sent = cached->date_sent;
+  e->zhours = cached->zhours;
+  e->zminutes = cached->zminutes;
+  e->zoccident = cached->zoccident;
+  e->lines = cached->lines;
+  mutt_email_free(&cached);
+
+  stub_loaded(m, e);
+}
+#endif
+
+/**
+ * compare_uid - Compare two UIDs - Implements ::sort_t
+ */
+static int compare_uid(const void *a, const void *b)
+{
+  unsigned int ua = *(const unsigned int *) a;
+  unsigned int ub = *(const unsigned int *) b;
+
+  return (ua > ub) - (ua < ub);
+}
+
+/**
+ * load_stubs - Fetch the headers of some stub emails
+ * @param m      Mailbox
+ * @param emails Emails, those that aren't stubs are ignored
+ * @param count  Number of emails
+ * @param quiet  If true, don't show the progress
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * The stubs are completed in place, so the index doesn't need rebuilding.
+ */
+static int load_stubs(struct Mailbox *m, struct Email **emails, int count, bool quiet)
+{
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!adata || !mdata || (adata->mailbox != m) || (mdata->stubs == 0))
+    return 0;
+
+  char tempfile[PATH_MAX];
+  char *hdrreq = NULL;
+  FILE *fp = NULL;
+  struct Buffer *cmd = NULL;
+  struct Progress progress;
+  int fetched = 0;
+  int retval = -1;
+
+  unsigned int *uids = mutt_mem_calloc(count, sizeof(unsigned int));
+  struct Email **loaded = mutt_mem_calloc(count, sizeof(struct Email *));
+  int num = 0;
+  int num_loaded = 0;
+  for (int i = 0; i < count; i++)
+  {
+    struct ImapEmailData *edata = imap_edata_get(emails[i]);
+    if (!edata || !edata->stub)
+      continue;
+#ifdef USE_HCACHE
+    /* The headers may be cached, e.g. when the stub came from a snapshot */
+    struct Email *cached = imap_hcache_get(mdata, edata->uid);
+    if (cached)
+    {
+      stub_from_hcache(m, emails[i], cached);
+      loaded[num_loaded++] = emails[i];
+      continue;
+    }
+#endif
+    uids[num++] = edata->uid;
+  }
+
+  if (num == 0)
+  {
+    retval = 0;
+    goto bail;
+  }
+
+  hdrreq = msg_header_request(adata);
+  if (!hdrreq)
+    goto bail;
+  cmd = mutt_buffer_pool_get();
+
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  fp = mutt_file_fopen(tempfile, "w+");
+  if (!fp)
+  {
+    mutt_error(_("Could not create temporary file %s"), tempfile);
+    goto bail;
+  }
+  unlink(tempfile);
+
+  if (!quiet)
+  {
+    mutt_progress_init(&progress, _("Fetching message headers..."),
+                       MUTT_PROGRESS_MSG, C_ReadInc, num);
+  }
+
+  qsort(uids, num, sizeof(unsigned int), compare_uid);
+
+  for (int i = 0; i < num;)
+  {
+    /* UID set of consecutive ranges, short enough for one command */
+    mutt_buffer_strcpy(cmd, "UID FETCH ");
+    for (int ranges = 0; (i < num) && (mutt_buffer_len(cmd) < IMAP_MAX_CMDLEN - 200); ranges++)
+    {
+      int j = i;
+      while ((j + 1 < num) && (uids[j + 1] == uids[j] + 1))
+        j++;
+      if (j == i)
+        mutt_buffer_add_printf(cmd, "%s%u", ranges ? "," : "", uids[i]);
+      else
+        mutt_buffer_add_printf(cmd, "%s%u:%u", ranges ? "," : "", uids[i], uids[j]);
+      i = j + 1;
+    }
+    mutt_buffer_add_printf(cmd, " (UID %s)", hdrreq);
+
+    imap_cmd_start(adata, mutt_b2s(cmd));
+
+    int rc;
+    do
+    {
+      rc = imap_cmd_step(adata);
+      if (rc != IMAP_CMD_CONTINUE)
+        break;
+
+      struct ImapHeader h = { 0 };
+      h.edata = imap_edata_new();
+      rewind(fp);
+
+      if ((msg_fetch_header(m, &h, adata->buf, fp) == 0) && ftello(fp))
+      {
+        struct Email *e = imap_uid_find(&mdata->uid_index, h.edata->uid);
+        if (e && imap_edata_get(e)->stub)
+        {
+          /* make sure we don't get remnants from older larger message headers */
+          fputs("\n\n", fp);
+          rewind(fp);
+
+          /* the stub's length is the whole size of the message */
+          long length = e->content->length + h.content_length;
+          mutt_env_free(&e->env);
+          mutt_body_free(&e->content);
+          e->env = mutt_rfc822_read_header(fp, e, false, false);
+          e->content->length = length;
+          stub_loaded(m, e);
+          if (num_loaded < count)
+            loaded[num_loaded++] = e;
+#ifdef USE_HCACHE
+          imap_hcache_put(mdata, e);
+#endif
+          if (!quiet)
+            mutt_progress_update(&progress, ++fetched, -1);
+        }
+      }
+
+      imap_edata_free((void **) &h.edata);
+    } while (rc == IMAP_CMD_CONTINUE);
+
+    if (rc != IMAP_CMD_OK)
+      goto bail;
+  }
+
+  retval = 0;
+
+bail:
+  for (int i = 0; C_Score && (i < num_loaded); i++)
+    mutt_score_message(m, loaded[i], true);
+
+  mutt_file_fclose(&fp);
+  mutt_buffer_pool_release(&cmd);
+  FREE(&hdrreq);
+  FREE(&uids);
+  FREE(&loaded);
+  return retval;
+}
+
 /**
  * imap_read_headers - Read headers from the server
  * @param m                Imap Selected Mailbox
@@ -1238,6 +1506,7 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
   unsigned long long *pmodseq = NULL;
   unsigned long long hc_modseq = 0;
   char *uid_seqset = NULL;
+  struct ImapSnapshot *snap = NULL;
 #endif /* USE_HCACHE */
 
   struct ImapAccountData *adata = imap_adata_get(m);
@@ -1248,8 +1517,7 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
   /* make sure context has room to hold the mailbox */
   while (msn_end > m->email_max)
     mx_alloc_memory(m);
-  alloc_msn_index(adata, msn_end);
-  imap_alloc_uid_hash(adata, msn_end);
+  imap_msn_reserve(&mdata->msn, msn_end);
 
   oldmsgcount = m->msg_count;
   mdata->reopen &= ~(IMAP_REOPEN_ALLOW | IMAP_NEWMAIL_PENDING);
@@ -1260,8 +1528,8 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
 
   if (mdata->hcache && initial_download)
   {
-    uid_validity = mutt_hcache_fetch_raw(mdata->hcache, "/UIDVALIDITY", 12);
-    puid_next = mutt_hcache_fetch_raw(mdata->hcache, "/UIDNEXT", 8);
+    uid_validity = mutt_hcache_fetch_raw(mdata->hcache, "/UIDVALIDITY", 12, NULL);
+    puid_next = mutt_hcache_fetch_raw(mdata->hcache, "/UIDNEXT", 8, NULL);
     if (puid_next)
     {
       uid_next = *(unsigned int *) puid_next;
@@ -1282,7 +1550,7 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
     if (uid_validity && uid_next && (*(unsigned int *) uid_validity == mdata->uid_validity))
     {
       evalhc = true;
-      pmodseq = mutt_hcache_fetch_raw(mdata->hcache, "/MODSEQ", 7);
+      pmodseq = mutt_hcache_fetch_raw(mdata->hcache, "/MODSEQ", 7, NULL);
       if (pmodseq)
       {
         hc_modseq = *pmodseq;
@@ -1292,8 +1560,12 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
       {
         if (has_qresync)
         {
-          uid_seqset = imap_hcache_get_uid_seqset(mdata);
-          if (uid_seqset)
+          snap = imap_hcache_get_snapshot(mdata);
+          if (snap)
+            hc_modseq = snap->modseq;
+          else
+            uid_seqset = imap_hcache_get_uid_seqset(mdata);
+          if (snap || uid_seqset)
             eval_qresync = true;
         }
 
@@ -1305,7 +1577,11 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
   }
   if (evalhc)
   {
-    if (eval_qresync)
+    if (snap)
+    {
+      read_headers_snapshot_eval_cache(adata, snap);
+    }
+    else if (eval_qresync)
     {
       if (read_headers_qresync_eval_cache(adata, uid_seqset) < 0)
         goto bail;
@@ -1326,10 +1602,17 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
       }
     }
 
+    /* Unless they're wanted lazily, read the snapshot's headers now */
+    if (snap && ((C_ImapLazyHeaders == 0) || (m->msg_count <= C_ImapLazyHeaders)) &&
+        (load_stubs(m, m->emails, m->msg_count, false) < 0))
+    {
+      goto bail;
+    }
+
     /* Look for the first empty MSN and start there */
     while (msn_begin <= msn_end)
     {
-      if (!mdata->msn_index[msn_begin - 1])
+      if (!imap_msn_get(&mdata->msn, msn_begin))
         break;
       msn_begin++;
     }
@@ -1371,9 +1654,15 @@ int imap_read_headers(struct Mailbox *m, unsigned int msn_begin,
       mutt_hcache_delete(mdata->hcache, "/MODSEQ", 7);
 
     if (has_qresync)
+    {
       imap_hcache_store_uid_seqset(mdata);
+      imap_hcache_store_snapshot(mdata);
+    }
     else
+    {
       imap_hcache_clear_uid_seqset(mdata);
+      imap_hcache_clear_snapshot(mdata);
+    }
   }
 #endif /* USE_HCACHE */
 
@@ -1392,49 +1681,357 @@ bail:
 #ifdef USE_HCACHE
   imap_hcache_close(mdata);
   FREE(&uid_seqset);
+  FREE(&snap);
 #endif /* USE_HCACHE */
 
   return retval;
 }
 
 /**
- * imap_append_message - Write an email back to the server
- * @param m   Mailbox
- * @param msg Message to save
+ * imap_load_headers - Fetch the headers of all the stub emails
+ * @param m Mailbox
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * When $imap_lazy_headers is in effect, the emails only carry their UID,
+ * flags, date and size until their headers are needed.  Anything that looks
+ * at the headers of every email, e.g. a pattern or threading, calls this
+ * first.
  */
-int imap_append_message(struct Mailbox *m, struct Message *msg)
+int imap_load_headers(struct Mailbox *m)
 {
-  if (!m || !msg)
-    return -1;
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!mdata || (mdata->stubs == 0))
+    return 0;
 
-  FILE *fp = NULL;
-  char buf[1024 * 2];
-  char internaldate[IMAP_DATELEN];
-  char imap_flags[128];
-  size_t len;
-  struct Progress progress;
-  size_t sent;
-  int c, last;
-  int rc;
+#ifdef USE_HCACHE
+  mdata->hcache = imap_hcache_open(imap_adata_get(m), mdata);
+#endif
+  int rc = load_stubs(m, m->emails, m->msg_count, false);
+#ifdef USE_HCACHE
+  imap_hcache_close(mdata);
+#endif
+  return rc;
+}
 
-  struct ImapAccountData *adata = imap_adata_get(m);
+/**
+ * imap_load_email_headers - Fetch the headers of a stub email
+ * @param m Mailbox
+ * @param e Email
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Like imap_load_headers(), but only for one email, e.g. before matching it
+ * against the patterns of the hooks.
+ */
+int imap_load_email_headers(struct Mailbox *m, struct Email *e)
+{
   struct ImapMboxData *mdata = imap_mdata_get(m);
+  struct ImapEmailData *edata = imap_edata_get(e);
+  if (!mdata || !edata || !edata->stub)
+    return 0;
 
-  fp = fopen(msg->path, "r");
-  if (!fp)
-  {
-    mutt_perror(msg->path);
-    goto fail;
-  }
+#ifdef USE_HCACHE
+  mdata->hcache = imap_hcache_open(imap_adata_get(m), mdata);
+#endif
+  int rc = load_stubs(m, &e, 1, true);
+#ifdef USE_HCACHE
+  imap_hcache_close(mdata);
+#endif
+  return rc;
+}
 
-  /* currently we set the \Seen flag on all messages, but probably we
-   * should scan the message Status header for flag info. Since we're
-   * already rereading the whole file for length it isn't any more
-   * expensive (it'd be nice if we had the file size passed in already
-   * by the code that writes the file, but that's a lot of changes.
-   * Ideally we'd have a Header structure with flag info here... */
+/**
+ * imap_load_matched_headers - Fetch the headers of the stubs a search matched
+ * @param m Mailbox
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Like imap_load_headers(), but only for the emails imap_search() marked.
+ */
+int imap_load_matched_headers(struct Mailbox *m)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!mdata || (mdata->stubs == 0))
+    return 0;
+
+  struct Email **emails = mutt_mem_calloc(MAX(m->msg_count, 1), sizeof(struct Email *));
+  int count = 0;
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    if (m->emails[i]->matched)
+      emails[count++] = m->emails[i];
+  }
+
+#ifdef USE_HCACHE
+  mdata->hcache = imap_hcache_open(imap_adata_get(m), mdata);
+#endif
+  int rc = load_stubs(m, emails, count, false);
+#ifdef USE_HCACHE
+  imap_hcache_close(mdata);
+#endif
+  FREE(&emails);
+  return rc;
+}
+
+/**
+ * imap_load_visible_headers - Fetch the headers of the stubs about to be displayed
+ * @param m       Mailbox
+ * @param top     Virtual number of the first email on the page
+ * @param pagelen Number of emails on the page
+ * @retval num Number of stubs completed
+ * @retval -1  Failure, the connection may have been lost
+ *
+ * Nothing is fetched unless the page has a stub.  Then the headers of the
+ * next page are fetched in the same command, so that scrolling through the
+ * index takes a round-trip per page.
+ *
+ * @note Call this before drawing the page: a failure may close the Mailbox.
+ */
+int imap_load_visible_headers(struct Mailbox *m, int top, int pagelen)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!mdata || (mdata->stubs == 0) || (top < 0) || (top >= m->vcount) || (pagelen <= 0))
+    return 0;
+
+  int count = MIN(pagelen, m->vcount - top);
+  bool stub = false;
+  for (int i = 0; !stub && (i < count); i++)
+  {
+    struct ImapEmailData *edata = imap_edata_get(m->emails[m->v2r[top + i]]);
+    stub = edata && edata->stub;
+  }
+  if (!stub)
+    return 0;
+
+  count = MIN(2 * pagelen, m->vcount - top);
+  struct Email **emails = mutt_mem_calloc(count, sizeof(struct Email *));
+  for (int i = 0; i < count; i++)
+    emails[i] = m->emails[m->v2r[top + i]];
+
+  const unsigned int stubs = mdata->stubs;
+#ifdef USE_HCACHE
+  mdata->hcache = imap_hcache_open(imap_adata_get(m), mdata);
+#endif
+  int rc = load_stubs(m, emails, count, true);
+#ifdef USE_HCACHE
+  imap_hcache_close(mdata);
+#endif
+  FREE(&emails);
+
+  if (rc < 0)
+    return -1;
+  return stubs - mdata->stubs;
+}
+
+/**
+ * append_send_literal - Send an email as the literal of an APPEND
+ * @param conn     Network connection
+ * @param fp       File containing the email
+ * @param progress Progress bar
+ *
+ * Bare LF line endings are turned into CRLF on the way.
+ */
+static void append_send_literal(struct Connection *conn, FILE *fp, struct Progress *progress)
+{
+  char buf[1024 * 2];
+  size_t len = 0;
+  size_t sent = 0;
+  int c, last;
+
+  for (last = EOF; (c = fgetc(fp)) != EOF; last = c)
+  {
+    if ((c == '\n') && (last != '\r'))
+      buf[len++] = '\r';
+
+    buf[len++] = c;
+
+    if (len > sizeof(buf) - 3)
+    {
+      sent += len;
+      flush_buffer(buf, &len, conn);
+      mutt_progress_update(progress, sent, -1);
+    }
+  }
+
+  if (len)
+    flush_buffer(buf, &len, conn);
+}
+
+/**
+ * multiappend_continue - Wait for the server to ask for the next message
+ * @param pdata Imap Account data of the connection carrying the MULTIAPPEND
+ * @retval true  The message may be sent
+ * @retval false The server has ended the MULTIAPPEND
+ *
+ * The messages of a MULTIAPPEND use synchronising literals.  If the server
+ * gives up on the command, it says so instead of asking for the literal, so
+ * nothing is ever sent that it would read as a new command.
+ */
+static bool multiappend_continue(struct ImapAccountData *pdata)
+{
+  int rc;
+  do
+    rc = imap_cmd_step(pdata);
+  while (rc == IMAP_CMD_CONTINUE);
+
+  /* the connection is gone, and the messages already sent with it */
+  if (rc == IMAP_CMD_BAD)
+    pdata->append_errors++;
+
+  return (rc == IMAP_CMD_RESPOND);
+}
+
+/**
+ * append_connection - Pick the connection for a pipelined APPEND
+ * @param adata Imap Account data of the primary connection
+ * @param mdata Imap Mailbox data of the destination
+ * @retval ptr  Connection to use
+ * @retval NULL The message needs a plain APPEND
+ *
+ * With LITERAL+, each message gets its own APPEND on the primary connection,
+ * without waiting for the server.  Otherwise, if the server supports
+ * MULTIAPPEND and an idle secondary connection is available, the messages are
+ * streamed into a single APPEND on it, which costs one round trip per message
+ * instead of two.
+ */
+static struct ImapAccountData *append_connection(struct ImapAccountData *adata,
+                                                 struct ImapMboxData *mdata)
+{
+  struct ImapAccountData *pdata = mdata->append_adata;
+  if (pdata)
+    return ((pdata != adata) || (adata->capabilities & IMAP_CAP_LITERALPLUS)) ? pdata : NULL;
+
+  if (adata->capabilities & IMAP_CAP_LITERALPLUS)
+    pdata = adata;
+  else if (adata->capabilities & IMAP_CAP_MULTIAPPEND)
+  {
+    pdata = imap_pool_get(adata);
+    if ((pdata == adata) || !(pdata->capabilities & IMAP_CAP_MULTIAPPEND) ||
+        imap_cmd_pending(pdata) || (pdata->cmdbuf->dptr != pdata->cmdbuf->data))
+    {
+      return NULL;
+    }
+  }
+  else
+    return NULL;
+
+  mdata->append_adata = pdata;
+  return pdata;
+}
+
+/**
+ * append_pipelined - Send an APPEND without waiting for the server
+ * @param adata    Imap Account data of the primary connection
+ * @param mdata    Imap Mailbox data of the destination
+ * @param fp       File containing the email
+ * @param len      Length of the email, with CRLF line endings
+ * @param flags    IMAP flags of the email, e.g. "\Seen \Flagged"
+ * @param date     INTERNALDATE of the email
+ * @param progress Progress bar
+ * @retval  0 Success
+ * @retval  1 The message needs a plain APPEND
+ * @retval -1 Failure
+ *
+ * With LITERAL+, the literal follows the command without a continuation
+ * request.  Failures are only known in imap_append_finish().
+ *
+ * In a MULTIAPPEND, the server confirms each message before it's sent, see
+ * multiappend_continue().  If it has ended the MULTIAPPEND, the rest of the
+ * messages are sent as plain APPENDs on the primary connection instead.
+ */
+static int append_pipelined(struct ImapAccountData *adata, struct ImapMboxData *mdata,
+                            FILE *fp, size_t len, const char *flags,
+                            const char *date, struct Progress *progress)
+{
+  char buf[1024];
+  struct ImapAccountData *pdata = append_connection(adata, mdata);
+  if (!pdata)
+    return 1;
+
+  if (mdata->multiappend)
+  {
+    snprintf(buf, sizeof(buf), " (%s) \"%s\" {%lu}\r\n", flags, date, (unsigned long) len);
+    if (mutt_socket_send(pdata->conn, buf) < 0)
+      return -1;
+  }
+  else
+  {
+    snprintf(buf, sizeof(buf), "APPEND %s (%s) \"%s\" {%lu%s}", mdata->munge_name,
+             flags, date, (unsigned long) len, (pdata != adata) ? "" : "+");
+    if (imap_cmd_append(pdata, buf) < 0)
+      return -1;
+
+    if (pdata != adata)
+    {
+      mutt_debug(LL_DEBUG2, "Opened MULTIAPPEND to %s\n", mdata->name);
+      mdata->multiappend = true;
+      pdata->appending = true;
+    }
+  }
+
+  if (mdata->multiappend && !multiappend_continue(pdata))
+  {
+    mutt_debug(LL_DEBUG1, "MULTIAPPEND ended early, falling back to APPEND\n");
+    adata->append_errors += pdata->append_errors;
+    pdata->append_errors = 0;
+    pdata->appending = false;
+    mdata->multiappend = false;
+    mdata->append_adata = adata;
+    return 1;
+  }
+
+  append_send_literal(pdata->conn, fp, progress);
+
+  /* a MULTIAPPEND is only terminated by imap_append_finish() */
+  if (!mdata->multiappend && (mutt_socket_send(pdata->conn, "\r\n") < 0))
+    return -1;
+
+  return 0;
+}
+
+/**
+ * imap_append_message - Write an email back to the server
+ * @param m   Mailbox
+ * @param msg Message to save
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Only the first message of a session is confirmed.  The rest are pipelined,
+ * see append_pipelined(), and their failures are reported by
+ * imap_append_finish().
+ */
+int imap_append_message(struct Mailbox *m, struct Message *msg)
+{
+  if (!m || !msg)
+    return -1;
+
+  FILE *fp = NULL;
+  char buf[1024 * 2];
+  char internaldate[IMAP_DATELEN];
+  char imap_flags[128];
+  size_t len;
+  struct Progress progress;
+  int c, last;
+  int rc;
+
+  struct ImapAccountData *adata = imap_adata_get(m);
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  const bool literal_plus = (adata->capabilities & IMAP_CAP_LITERALPLUS);
+
+  fp = fopen(msg->path, "r");
+  if (!fp)
+  {
+    mutt_perror(msg->path);
+    goto fail;
+  }
+
+  /* currently we set the \Seen flag on all messages, but probably we
+   * should scan the message Status header for flag info. Since we're
+   * already rereading the whole file for length it isn't any more
+   * expensive (it'd be nice if we had the file size passed in already
+   * by the code that writes the file, but that's a lot of changes.
+   * Ideally we'd have a Header structure with flag info here... */
   for (last = EOF, len = 0; (c = fgetc(fp)) != EOF; last = c)
   {
     if ((c == '\n') && (last != '\r'))
@@ -1460,44 +2057,46 @@ int imap_append_message(struct Mailbox *m, struct Message *msg)
   if (msg->flags.draft)
     mutt_str_strcat(imap_flags, sizeof(imap_flags), " \\Draft");
 
-  snprintf(buf, sizeof(buf), "APPEND %s (%s) \"%s\" {%lu}", mdata->munge_name,
-           imap_flags + 1, internaldate, (unsigned long) len);
-
-  imap_cmd_start(adata, buf);
-
-  do
-    rc = imap_cmd_step(adata);
-  while (rc == IMAP_CMD_CONTINUE);
-
-  if (rc != IMAP_CMD_RESPOND)
+  if (mdata->appended > 0)
   {
-    mutt_debug(LL_DEBUG1, "#1 command failed: %s\n", adata->buf);
+    rc = append_pipelined(adata, mdata, fp, len, imap_flags + 1, internaldate, &progress);
+    if (rc != 1)
+    {
+      mutt_file_fclose(&fp);
+      if (rc < 0)
+        goto fail;
 
-    char *pc = adata->buf + SEQLEN;
-    SKIPWS(pc);
-    pc = imap_next_word(pc);
-    mutt_error("%s", pc);
-    mutt_file_fclose(&fp);
-    goto fail;
+      mdata->appended++;
+      return 0;
+    }
   }
 
-  for (last = EOF, sent = len = 0; (c = fgetc(fp)) != EOF; last = c)
-  {
-    if ((c == '\n') && (last != '\r'))
-      buf[len++] = '\r';
+  snprintf(buf, sizeof(buf), "APPEND %s (%s) \"%s\" {%lu%s}", mdata->munge_name,
+           imap_flags + 1, internaldate, (unsigned long) len, literal_plus ? "+" : "");
 
-    buf[len++] = c;
+  imap_cmd_start(adata, buf);
 
-    if (len > sizeof(buf) - 3)
+  /* with LITERAL+, the server doesn't ask for the literal */
+  if (!literal_plus)
+  {
+    do
+      rc = imap_cmd_step(adata);
+    while (rc == IMAP_CMD_CONTINUE);
+
+    if (rc != IMAP_CMD_RESPOND)
     {
-      sent += len;
-      flush_buffer(buf, &len, adata->conn);
-      mutt_progress_update(&progress, sent, -1);
+      mutt_debug(LL_DEBUG1, "#1 command failed: %s\n", adata->buf);
+
+      char *pc = adata->buf + SEQLEN;
+      SKIPWS(pc);
+      pc = imap_next_word(pc);
+      mutt_error("%s", pc);
+      mutt_file_fclose(&fp);
+      goto fail;
     }
   }
 
-  if (len)
-    flush_buffer(buf, &len, adata->conn);
+  append_send_literal(adata->conn, fp, &progress);
 
   mutt_socket_send(adata->conn, "\r\n");
   mutt_file_fclose(&fp);
@@ -1516,12 +2115,59 @@ int imap_append_message(struct Mailbox *m, struct Message *msg)
     goto fail;
   }
 
+  mdata->appended++;
   return 0;
 
 fail:
   return -1;
 }
 
+/**
+ * imap_append_finish - Wait for the pipelined APPENDs to complete
+ * @param m Mailbox that was appended to
+ * @retval  0 Success
+ * @retval -1 At least one message wasn't saved
+ *
+ * Closes an open MULTIAPPEND and collects the outcome of any pipelined
+ * APPENDs.  It's safe to call more than once.
+ */
+int imap_append_finish(struct Mailbox *m)
+{
+  struct ImapMboxData *mdata = imap_mdata_get(m);
+  if (!mdata)
+    return 0;
+
+  mdata->appended = 0;
+
+  struct ImapAccountData *adata = mdata->append_adata;
+  if (!adata)
+    return 0;
+
+  int rc = 0;
+
+  if (mdata->multiappend && (mutt_socket_send(adata->conn, "\r\n") < 0))
+    rc = -1;
+
+  if (imap_cmd_pending(adata) && (imap_exec(adata, NULL, IMAP_CMD_NO_FLAGS) == IMAP_EXEC_FATAL))
+    rc = -1;
+
+  if (adata->append_errors != 0)
+  {
+    mutt_debug(LL_DEBUG1, "%u APPEND commands failed\n", adata->append_errors);
+    rc = -1;
+  }
+
+  if (rc < 0)
+    mutt_error(_("Some messages could not be saved to %s"), mdata->name);
+
+  adata->appending = false;
+  adata->append_errors = 0;
+  mdata->multiappend = false;
+  mdata->append_adata = NULL;
+
+  return rc;
+}
+
 /**
  * imap_copy_messages - Server COPY messages to another folder
  * @param m      Mailbox
@@ -1785,6 +2431,7 @@ char *imap_set_flags(struct Mailbox *m, struct Email *e, char *s, bool *server_c
   /* We take a copy of the tags so we can split the string */
   char *tags_copy = mutt_str_strdup(edata->flags_remote);
   driver_tags_replace(&e->tags, tags_copy);
+  mutt_email_touch(e);
   FREE(&tags_copy);
 
   /* YAUH (yet another ugly hack): temporarily set context to
@@ -1818,72 +2465,31 @@ char *imap_set_flags(struct Mailbox *m, struct Email *e, char *s, bool *server_c
 }
 
 /**
- * imap_msg_open - Implements MxOps::msg_open()
+ * msg_fetch_body - Fetch (part of) an email into a file
+ * @param m        Selected Imap Mailbox
+ * @param e        Email
+ * @param fp       File to write to
+ * @param section  What to fetch, e.g. "BODY.PEEK[]"
+ * @param bytes    Number of bytes the server sent
+ * @param progress Progress bar (OPTIONAL)
+ * @retval  0 Success
+ * @retval -1 Failure
  */
-int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
+static int msg_fetch_body(struct Mailbox *m, struct Email *e, FILE *fp,
+                          const char *section, unsigned int *bytes,
+                          struct Progress *progress)
 {
-  if (!m || !msg)
-    return -1;
-
-  struct Envelope *newenv = NULL;
+  struct ImapAccountData *adata = imap_adata_get(m);
   char buf[1024];
   char *pc = NULL;
-  unsigned int bytes;
-  struct Progress progress;
   unsigned int uid;
-  bool retried = false;
-  bool read;
   int rc;
 
   /* Sam's weird courier server returns an OK response even when FETCH
    * fails. Thanks Sam. */
   bool fetched = false;
-  int output_progress;
-
-  struct ImapAccountData *adata = imap_adata_get(m);
 
-  if (!adata || (adata->mailbox != m))
-    return -1;
-
-  struct Email *e = m->emails[msgno];
-
-  msg->fp = msg_cache_get(m, e);
-  if (msg->fp)
-  {
-    if (imap_edata_get(e)->parsed)
-      return 0;
-    else
-      goto parsemsg;
-  }
-
-  /* This function is called in a few places after endwin()
-   * e.g. mutt_pipe_message(). */
-  output_progress = !isendwin();
-  if (output_progress)
-    mutt_message(_("Fetching message..."));
-
-  msg->fp = msg_cache_put(m, e);
-  if (!msg->fp)
-  {
-    char path[PATH_MAX];
-    mutt_mktemp(path, sizeof(path));
-    msg->fp = mutt_file_fopen(path, "w+");
-    if (!msg->fp)
-    {
-      return -1;
-    }
-    unlink(path);
-  }
-
-  /* mark this header as currently inactive so the command handler won't
-   * also try to update it. HACK until all this code can be moved into the
-   * command handler */
-  e->active = false;
-
-  snprintf(buf, sizeof(buf), "UID FETCH %u %s", imap_edata_get(e)->uid,
-           ((adata->capabilities & IMAP_CAP_IMAP4REV1) ?
-                (C_ImapPeek ? "BODY.PEEK[]" : "BODY[]") :
-                "RFC822"));
+  snprintf(buf, sizeof(buf), "UID FETCH %u %s", imap_edata_get(e)->uid, section);
 
   imap_cmd_start(adata, buf);
   do
@@ -1907,7 +2513,7 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
         {
           pc = imap_next_word(pc);
           if (mutt_str_atoui(pc, &uid) < 0)
-            goto bail;
+            return -1;
           if (uid != imap_edata_get(e)->uid)
           {
             mutt_error(_(
@@ -1917,25 +2523,42 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
         else if (mutt_str_startswith(pc, "RFC822", CASE_IGNORE) ||
                  mutt_str_startswith(pc, "BODY[]", CASE_IGNORE))
         {
+          /* a partial fetch may end half-way through a line break */
+          bool partial = mutt_str_startswith(pc, "BODY[]<", CASE_IGNORE);
           pc = imap_next_word(pc);
-          if (imap_get_literal_count(pc, &bytes) < 0)
+          if (partial && ((*pc == '"') || mutt_str_startswith(pc, "NIL", CASE_IGNORE)))
           {
-            imap_error("imap_msg_open()", buf);
-            goto bail;
+            /* At (or past) the end of the message, the server may send a
+             * quoted string, usually "", instead of a literal */
+            char *str = mutt_str_substr_dup(pc, imap_next_word(pc));
+            if (*str == '"')
+            {
+              imap_unquote_string(str);
+              fputs(str, fp);
+              *bytes = mutt_str_strlen(str);
+            }
+            else
+              *bytes = 0;
+            FREE(&str);
+            fetched = true;
+            continue;
           }
-          if (output_progress)
+          if (imap_get_literal_count(pc, bytes) < 0)
           {
-            mutt_progress_init(&progress, _("Fetching message..."),
-                               MUTT_PROGRESS_SIZE, C_NetInc, bytes);
+            imap_error("imap_msg_open()", buf);
+            return -1;
           }
-          if (imap_read_literal(msg->fp, adata, bytes, output_progress ? &progress : NULL) < 0)
+          if (progress)
           {
-            goto bail;
+            mutt_progress_init(progress, _("Fetching message..."),
+                               MUTT_PROGRESS_SIZE, C_NetInc, *bytes);
           }
+          if (imap_read_literal(fp, adata, *bytes, progress, partial) < 0)
+            return -1;
           /* pick up trailing line */
           rc = imap_cmd_step(adata);
           if (rc != IMAP_CMD_CONTINUE)
-            goto bail;
+            return -1;
           pc = adata->buf;
 
           fetched = true;
@@ -1948,23 +2571,166 @@ int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
         {
           pc = imap_set_flags(m, e, pc, NULL);
           if (!pc)
-            goto bail;
+            return -1;
         }
       }
     }
   } while (rc == IMAP_CMD_CONTINUE);
 
-  /* see comment before command start. */
+  if ((rc != IMAP_CMD_OK) || !fetched || !imap_code(adata->buf))
+    return -1;
+
+  return 0;
+}
+
+/**
+ * msg_fetch_chunks - Fetch an email in pieces of $imap_fetch_chunk_size
+ * @param m               Selected Imap Mailbox
+ * @param e               Email
+ * @param fp              File to write to
+ * @param output_progress If true, show a progress bar
+ * @retval  0 Success
+ * @retval -1 Failure, or the user aborted the download
+ *
+ * Each piece is a partial FETCH, so the download can be interrupted between
+ * pieces, and the progress bar covers the whole message.
+ *
+ * The server counts CRLF line endings, which imap_read_literal() turns into
+ * LF.  If a piece ends between the CR and the LF, the CR is dropped from the
+ * file and fetched again with the next piece.
+ *
+ * If the message size is a multiple of the piece size, the last FETCH starts
+ * at the end of the message.  The server answers it with `""` instead of a
+ * literal, which msg_fetch_body() counts as 0 bytes.
+ */
+static int msg_fetch_chunks(struct Mailbox *m, struct Email *e, FILE *fp, bool output_progress)
+{
+  char section[128];
+  struct Progress progress;
+  unsigned long offset = 0;
+  unsigned int bytes;
+
+  if (output_progress)
+  {
+    mutt_progress_init(&progress, _("Fetching message..."), MUTT_PROGRESS_SIZE,
+                       C_NetInc, e->content->offset + e->content->length);
+  }
+
+  SigInt = 0;
+  while (true)
+  {
+    snprintf(section, sizeof(section), "%s<%lu.%lu>",
+             C_ImapPeek ? "BODY.PEEK[]" : "BODY[]", offset, (unsigned long) C_ImapFetchChunkSize);
+
+    bytes = 0;
+    if (msg_fetch_body(m, e, fp, section, &bytes, NULL) < 0)
+      return -1;
+
+    offset += bytes;
+    if (output_progress)
+      mutt_progress_update(&progress, offset, -1);
+
+    /* a short piece means we've reached the end */
+    if (bytes < C_ImapFetchChunkSize)
+      break;
+
+    if ((bytes > 1) && (fseek(fp, -1, SEEK_END) == 0) && (fgetc(fp) == '\r'))
+    {
+      fseek(fp, -1, SEEK_END);
+      offset--;
+    }
+    else
+      fseek(fp, 0, SEEK_END);
+
+    if (SigInt)
+    {
+      SigInt = 0;
+      mutt_error(_("Fetching message aborted"));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * imap_msg_open - Implements MxOps::msg_open()
+ */
+int imap_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
+{
+  if (!m || !msg)
+    return -1;
+
+  struct Envelope *newenv = NULL;
+  char buf[1024];
+  unsigned int bytes;
+  struct Progress progress;
+  bool retried = false;
+  bool read;
+  int rc;
+  int output_progress;
+
+  struct ImapAccountData *adata = imap_adata_get(m);
+
+  if (!adata || (adata->mailbox != m))
+    return -1;
+
+  struct Email *e = m->emails[msgno];
+
+  msg->fp = msg_cache_get(m, e);
+  if (msg->fp)
+  {
+    if (imap_edata_get(e)->parsed)
+      return 0;
+    else
+      goto parsemsg;
+  }
+
+  /* This function is called in a few places after endwin()
+   * e.g. mutt_pipe_message(). */
+  output_progress = !isendwin();
+  if (output_progress)
+    mutt_message(_("Fetching message..."));
+
+  msg->fp = msg_cache_put(m, e);
+  if (!msg->fp)
+  {
+    char path[PATH_MAX];
+    mutt_mktemp(path, sizeof(path));
+    msg->fp = mutt_file_fopen(path, "w+");
+    if (!msg->fp)
+    {
+      return -1;
+    }
+    unlink(path);
+  }
+
+  /* mark this header as currently inactive so the command handler won't
+   * also try to update it. HACK until all this code can be moved into the
+   * command handler */
+  e->active = false;
+
+  if ((C_ImapFetchChunkSize > 0) && (adata->capabilities & IMAP_CAP_IMAP4REV1))
+  {
+    rc = msg_fetch_chunks(m, e, msg->fp, output_progress);
+  }
+  else
+  {
+    rc = msg_fetch_body(m, e, msg->fp,
+                        (adata->capabilities & IMAP_CAP_IMAP4REV1) ?
+                            (C_ImapPeek ? "BODY.PEEK[]" : "BODY[]") :
+                            "RFC822",
+                        &bytes, output_progress ? &progress : NULL);
+  }
+
+  /* see above */
   e->active = true;
 
   fflush(msg->fp);
   if (ferror(msg->fp))
     goto bail;
 
-  if (rc != IMAP_CMD_OK)
-    goto bail;
-
-  if (!fetched || !imap_code(adata->buf))
+  if (rc < 0)
     goto bail;
 
   msg_cache_commit(m, e);
@@ -1981,6 +2747,7 @@ parsemsg:
   read = e->read;
   newenv = mutt_rfc822_read_header(msg->fp, e, false, false);
   mutt_env_merge(e->env, &newenv);
+  mutt_email_touch(e);
 
   /* see above. We want the new status in e->read, so we unset it manually
    * and let mutt_set_flag set it correctly, updating context. */
@@ -2003,6 +2770,13 @@ parsemsg:
   mutt_clear_error();
   rewind(msg->fp);
   imap_edata_get(e)->parsed = true;
+  if (imap_edata_get(e)->stub)
+  {
+    /* the whole header has just been read */
+    stub_loaded(m, e);
+    if (C_Score)
+      mutt_score_message(m, e, true);
+  }
 
   /* retry message parse if cached message is empty */
   if (!retried && ((e->lines == 0) || (e->content->length == 0)))
@@ -40,9 +40,13 @@ struct ImapEmailData
   bool replied : 1;
 
   bool parsed : 1;
+  bool stub : 1; ///< Only the UID, flags, date and size are known, see imap_load_headers()
+  bool modified : 1; ///< A conditional STORE failed, the server's flags have changed
 
   unsigned int uid; /**< 32-bit Message UID */
   unsigned int msn; /**< Message Sequence Number */
+  unsigned int msn_slot; /**< Position in ImapMboxData::msn, see imap_msn_find() */
+  unsigned int sort_rank; /**< Position in the server's SORT order, 0 if unknown */
 
   char *flags_system;
   char *flags_remote;
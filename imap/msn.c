@@ -0,0 +1,440 @@
+/**
+ * @file
+ * IMAP MSN and UID lookup tables
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page imap_msn MSN and UID lookup tables
+ *
+ * Map Message Sequence Numbers and UIDs to Emails.
+ *
+ * An EXPUNGE renumbers every message above it, so a flat array of MSNs costs
+ * O(n) per EXPUNGE and a mass expunge becomes quadratic.  Here, lookups,
+ * EXPUNGEs and VANISHEDs are all O(log n).
+ */
+
+#include "config.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include "mutt/mutt.h"
+#include "email/lib.h"
+#include "msn.h"
+#include "message.h"
+
+/**
+ * lowbit - Lowest set bit of a number
+ * @param i Number
+ * @retval num Lowest bit
+ */
+static inline size_t lowbit(size_t i)
+{
+  return i & (~i + 1);
+}
+
+/**
+ * msn_tree_add - Adjust the count of a slot in the Fenwick tree
+ * @param mi    MSN Index
+ * @param slot  Slot (0-based)
+ * @param delta Change in count
+ */
+static void msn_tree_add(struct MsnIndex *mi, size_t slot, int delta)
+{
+  for (size_t i = slot + 1; i <= mi->size; i += lowbit(i))
+    mi->tree[i] += delta;
+}
+
+/**
+ * msn_tree_sum - Count the live slots before a slot
+ * @param mi   MSN Index
+ * @param slot Slot (0-based)
+ * @retval num Live slots in [0, slot)
+ */
+static size_t msn_tree_sum(const struct MsnIndex *mi, size_t slot)
+{
+  size_t sum = 0;
+  for (size_t i = slot; i > 0; i -= lowbit(i))
+    sum += mi->tree[i];
+  return sum;
+}
+
+/**
+ * msn_tree_slot - Find the slot of a Message Sequence Number
+ * @param mi  MSN Index
+ * @param msn Message Sequence Number, 1 to mi->live
+ * @retval num Slot (0-based)
+ */
+static size_t msn_tree_slot(const struct MsnIndex *mi, size_t msn)
+{
+  size_t pos = 0;
+  size_t step = 1;
+  while ((step << 1) <= mi->size)
+    step <<= 1;
+
+  for (; step > 0; step >>= 1)
+  {
+    if (((pos + step) <= mi->size) && (mi->tree[pos + step] < msn))
+    {
+      pos += step;
+      msn -= mi->tree[pos];
+    }
+  }
+
+  return pos;
+}
+
+/**
+ * msn_compact - Squeeze the dead slots out of the index
+ * @param mi MSN Index
+ *
+ * Afterwards, every slot is live, so the Fenwick tree can be rebuilt directly.
+ */
+static void msn_compact(struct MsnIndex *mi)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < mi->size; i++)
+  {
+    if (mi->dead[i])
+      continue;
+
+    struct Email *e = mi->slots[i];
+    mi->slots[size] = e;
+    if (e && e->edata)
+      ((struct ImapEmailData *) e->edata)->msn_slot = size;
+    size++;
+  }
+
+  mi->size = size;
+  memset(mi->dead, 0, mi->capacity * sizeof(bool));
+  for (size_t i = 1; i <= size; i++)
+    mi->tree[i] = lowbit(i);
+}
+
+/**
+ * msn_append - Add a live slot to the end of the index
+ * @param mi MSN Index
+ * @param e  Email, may be NULL
+ * @retval num Slot (0-based)
+ */
+static size_t msn_append(struct MsnIndex *mi, struct Email *e)
+{
+  if (mi->size >= mi->capacity)
+    imap_msn_reserve(mi, mi->live + 1);
+
+  size_t slot = mi->size++;
+  mi->slots[slot] = e;
+  mi->dead[slot] = false;
+
+  /* The new node covers the slots (slot + 1 - lowbit, slot + 1] */
+  size_t i = slot + 1;
+  mi->tree[i] = 1 + msn_tree_sum(mi, slot) - msn_tree_sum(mi, i - lowbit(i));
+  mi->live++;
+
+  return slot;
+}
+
+/**
+ * imap_msn_free - Free the MSN Index
+ * @param mi MSN Index
+ */
+void imap_msn_free(struct MsnIndex *mi)
+{
+  if (!mi)
+    return;
+
+  FREE(&mi->slots);
+  FREE(&mi->tree);
+  FREE(&mi->dead);
+  memset(mi, 0, sizeof(*mi));
+}
+
+/**
+ * imap_msn_get - Look up an Email by Message Sequence Number
+ * @param mi  MSN Index
+ * @param msn Message Sequence Number
+ * @retval ptr  Email
+ * @retval NULL MSN is out of range, or hasn't been fetched yet
+ */
+struct Email *imap_msn_get(const struct MsnIndex *mi, size_t msn)
+{
+  if (!mi || (msn < 1) || (msn > mi->live))
+    return NULL;
+
+  return mi->slots[msn_tree_slot(mi, msn)];
+}
+
+/**
+ * imap_msn_highest - Get the highest Message Sequence Number in the index
+ * @param mi MSN Index
+ * @retval num The largest MSN fetched so far
+ */
+size_t imap_msn_highest(const struct MsnIndex *mi)
+{
+  return mi ? mi->live : 0;
+}
+
+/**
+ * imap_msn_find - Find the Message Sequence Number of an Email
+ * @param mi MSN Index
+ * @param e  Email
+ * @retval num Message Sequence Number
+ * @retval 0   Email isn't in the index
+ */
+size_t imap_msn_find(const struct MsnIndex *mi, const struct Email *e)
+{
+  if (!mi || !e || !e->edata)
+    return 0;
+
+  size_t slot = ((struct ImapEmailData *) e->edata)->msn_slot;
+  if ((slot >= mi->size) || (mi->slots[slot] != e) || mi->dead[slot])
+    return 0;
+
+  return msn_tree_sum(mi, slot + 1);
+}
+
+/**
+ * imap_msn_remove - Remove a Message Sequence Number (EXPUNGE)
+ * @param mi  MSN Index
+ * @param msn Message Sequence Number
+ *
+ * All the higher MSNs are decremented.
+ */
+void imap_msn_remove(struct MsnIndex *mi, size_t msn)
+{
+  if (!mi || (msn < 1) || (msn > mi->live))
+    return;
+
+  size_t slot = msn_tree_slot(mi, msn);
+  mi->slots[slot] = NULL;
+  mi->dead[slot] = true;
+  msn_tree_add(mi, slot, -1);
+  mi->live--;
+
+  if ((mi->size - mi->live) > MAX(mi->live, 64))
+    msn_compact(mi);
+}
+
+/**
+ * imap_msn_reserve - Make room for a number of MSNs
+ * @param mi  MSN Index
+ * @param num Number of MSNs in use
+ */
+void imap_msn_reserve(struct MsnIndex *mi, size_t num)
+{
+  /* Room for the dead slots, too */
+  num += mi->size - mi->live;
+  if (num <= mi->capacity)
+    return;
+
+  /* This is a conservative check to protect against a malicious imap
+   * server.  Most likely size_t is bigger than an unsigned int, but
+   * if num is this big, we have a serious problem. */
+  if (num >= (UINT_MAX / sizeof(struct Email *)))
+  {
+    mutt_error(_("Out of memory"));
+    mutt_exit(1);
+  }
+
+  /* Add a little padding, like mx_allloc_memory() */
+  size_t capacity = MAX(num + 25, mi->capacity + mi->capacity / 2);
+
+  mutt_mem_realloc(&mi->slots, capacity * sizeof(struct Email *));
+  mutt_mem_realloc(&mi->tree, (capacity + 1) * sizeof(unsigned int));
+  mutt_mem_realloc(&mi->dead, capacity * sizeof(bool));
+  memset(mi->slots + mi->capacity, 0, (capacity - mi->capacity) * sizeof(struct Email *));
+  memset(mi->dead + mi->capacity, 0, (capacity - mi->capacity) * sizeof(bool));
+  if (mi->capacity == 0)
+    mi->tree[0] = 0;
+
+  mi->capacity = capacity;
+}
+
+/**
+ * imap_msn_set - Store an Email at a Message Sequence Number
+ * @param mi  MSN Index
+ * @param msn Message Sequence Number
+ * @param e   Email, may be NULL
+ *
+ * If the MSN is beyond the end of the index, any MSNs in between are left
+ * empty.  The Email's edata must already be set.
+ */
+void imap_msn_set(struct MsnIndex *mi, size_t msn, struct Email *e)
+{
+  if (!mi || (msn < 1))
+    return;
+
+  size_t slot;
+  if (msn <= mi->live)
+  {
+    slot = msn_tree_slot(mi, msn);
+    mi->slots[slot] = e;
+  }
+  else
+  {
+    imap_msn_reserve(mi, msn);
+    while (mi->live < (msn - 1))
+      msn_append(mi, NULL);
+    slot = msn_append(mi, e);
+  }
+
+  if (e && e->edata)
+    ((struct ImapEmailData *) e->edata)->msn_slot = slot;
+}
+
+/**
+ * uid_search - Find the position of a UID in the UID Index
+ * @param ui  UID Index
+ * @param uid UID to find
+ * @retval num Position of the UID, or where it should be inserted
+ */
+static size_t uid_search(const struct UidIndex *ui, unsigned int uid)
+{
+  size_t lo = 0;
+  size_t hi = ui->size;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ui->uids[mid] < uid)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * uid_compact - Squeeze the holes out of the UID Index
+ * @param ui UID Index
+ */
+static void uid_compact(struct UidIndex *ui)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < ui->size; i++)
+  {
+    if (!ui->emails[i])
+      continue;
+    ui->uids[size] = ui->uids[i];
+    ui->emails[size] = ui->emails[i];
+    size++;
+  }
+  ui->size = size;
+  ui->holes = 0;
+}
+
+/**
+ * imap_uid_find - Look up an Email by UID
+ * @param ui  UID Index
+ * @param uid UID to find
+ * @retval ptr  Email
+ * @retval NULL UID isn't in the index
+ */
+struct Email *imap_uid_find(const struct UidIndex *ui, unsigned int uid)
+{
+  if (!ui || (ui->size == 0))
+    return NULL;
+
+  size_t pos = uid_search(ui, uid);
+  if ((pos < ui->size) && (ui->uids[pos] == uid))
+    return ui->emails[pos];
+  return NULL;
+}
+
+/**
+ * imap_uid_free - Free the UID Index
+ * @param ui UID Index
+ */
+void imap_uid_free(struct UidIndex *ui)
+{
+  if (!ui)
+    return;
+
+  FREE(&ui->uids);
+  FREE(&ui->emails);
+  memset(ui, 0, sizeof(*ui));
+}
+
+/**
+ * imap_uid_insert - Add an Email to the UID Index
+ * @param ui  UID Index
+ * @param uid UID of the Email
+ * @param e   Email
+ * @retval  0 Success
+ * @retval -1 The UID is already in the index
+ */
+int imap_uid_insert(struct UidIndex *ui, unsigned int uid, struct Email *e)
+{
+  if (!ui || !e)
+    return -1;
+
+  size_t pos = ui->size;
+  if ((ui->size > 0) && (uid <= ui->uids[ui->size - 1]))
+  {
+    pos = uid_search(ui, uid);
+    if (ui->uids[pos] == uid)
+    {
+      if (ui->emails[pos])
+        return -1;
+      ui->emails[pos] = e;
+      ui->holes--;
+      return 0;
+    }
+  }
+
+  if (ui->size >= ui->capacity)
+  {
+    ui->capacity = MAX(ui->capacity * 2, 32);
+    mutt_mem_realloc(&ui->uids, ui->capacity * sizeof(unsigned int));
+    mutt_mem_realloc(&ui->emails, ui->capacity * sizeof(struct Email *));
+  }
+
+  /* Out of order UIDs are rare, so the memmove() is acceptable */
+  if (pos < ui->size)
+  {
+    memmove(ui->uids + pos + 1, ui->uids + pos, (ui->size - pos) * sizeof(unsigned int));
+    memmove(ui->emails + pos + 1, ui->emails + pos,
+            (ui->size - pos) * sizeof(struct Email *));
+  }
+
+  ui->uids[pos] = uid;
+  ui->emails[pos] = e;
+  ui->size++;
+  return 0;
+}
+
+/**
+ * imap_uid_remove - Remove an Email from the UID Index
+ * @param ui  UID Index
+ * @param uid UID of the Email
+ * @param e   Email to remove, NULL for any
+ */
+void imap_uid_remove(struct UidIndex *ui, unsigned int uid, const struct Email *e)
+{
+  if (!ui || (ui->size == 0))
+    return;
+
+  size_t pos = uid_search(ui, uid);
+  if ((pos >= ui->size) || (ui->uids[pos] != uid) || !ui->emails[pos])
+    return;
+  if (e && (ui->emails[pos] != e))
+    return;
+
+  ui->emails[pos] = NULL;
+  ui->holes++;
+
+  if (ui->holes > MAX(ui->size - ui->holes, 64))
+    uid_compact(ui);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * IMAP MSN and UID lookup tables
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_IMAP_MSN_H
+#define MUTT_IMAP_MSN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct Email;
+
+/**
+ * struct MsnIndex - Look up Emails by Message Sequence Number
+ *
+ * The Emails are kept in slots, in MSN order.  An EXPUNGE doesn't move any
+ * slots, it just kills one.  A Fenwick tree counts the live slots, so the
+ * N'th live slot (the MSN) can be found in O(log n).  Dead slots are squeezed
+ * out once they outnumber the live ones.
+ *
+ * Each Email remembers its slot in ImapEmailData::msn_slot.
+ */
+struct MsnIndex
+{
+  struct Email **slots; ///< Emails, in MSN order (NULL if not fetched yet)
+  unsigned int *tree;   ///< Fenwick tree of live slots (1-based)
+  bool *dead;           ///< Slots that have been expunged
+  size_t size;          ///< Number of slots in use
+  size_t capacity;      ///< Number of slots allocated
+  size_t live;          ///< Number of live slots, i.e. the highest MSN
+};
+
+/**
+ * struct UidIndex - Look up Emails by UID
+ *
+ * A pair of arrays, sorted by UID.  Servers hand out UIDs in ascending order,
+ * so inserting is usually an append.  Removed entries are left as holes and
+ * squeezed out once they outnumber the live ones.
+ */
+struct UidIndex
+{
+  unsigned int *uids;    ///< Sorted UIDs
+  struct Email **emails; ///< Email matching each UID (NULL if removed)
+  size_t size;           ///< Number of entries in use
+  size_t capacity;       ///< Number of entries allocated
+  size_t holes;          ///< Number of removed entries
+};
+
+void          imap_msn_free   (struct MsnIndex *mi);
+struct Email *imap_msn_get    (const struct MsnIndex *mi, size_t msn);
+size_t        imap_msn_highest(const struct MsnIndex *mi);
+size_t        imap_msn_find   (const struct MsnIndex *mi, const struct Email *e);
+void          imap_msn_remove (struct MsnIndex *mi, size_t msn);
+void          imap_msn_reserve(struct MsnIndex *mi, size_t num);
+void          imap_msn_set    (struct MsnIndex *mi, size_t msn, struct Email *e);
+
+struct Email *imap_uid_find  (const struct UidIndex *ui, unsigned int uid);
+void          imap_uid_free  (struct UidIndex *ui);
+int           imap_uid_insert(struct UidIndex *ui, unsigned int uid, struct Email *e);
+void          imap_uid_remove(struct UidIndex *ui, unsigned int uid, const struct Email *e);
+
+#endif /* MUTT_IMAP_MSN_H */
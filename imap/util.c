@@ -75,8 +75,17 @@ void imap_adata_free(void **ptr)
 
   struct ImapAccountData *adata = *ptr;
 
+  for (int i = 0; i < adata->poolsize; i++)
+    imap_adata_free((void **) &adata->pool[i]);
+  FREE(&adata->pool);
+  for (int i = 0; i < adata->numwatchers; i++)
+    imap_adata_free((void **) &adata->watchers[i]);
+  FREE(&adata->watchers);
+  FREE(&adata->watch);
+
   FREE(&adata->capstr);
   mutt_buffer_free(&adata->cmdbuf);
+  mutt_buffer_free(&adata->liststatus);
   FREE(&adata->buf);
   FREE(&adata->cmds);
 
@@ -101,6 +110,7 @@ struct ImapAccountData *imap_adata_new(void)
 
   adata->seqid = new_seqid;
   adata->cmdbuf = mutt_buffer_new();
+  adata->liststatus = mutt_buffer_new();
   adata->cmdslots = C_ImapPipelineDepth + 2;
   adata->cmds = mutt_mem_calloc(adata->cmdslots, sizeof(*adata->cmds));
 
@@ -187,9 +197,9 @@ struct ImapMboxData *imap_mdata_new(struct ImapAccountData *adata, const char *n
   header_cache_t *hc = imap_hcache_open(adata, mdata);
   if (hc)
   {
-    void *uidvalidity = mutt_hcache_fetch_raw(hc, "/UIDVALIDITY", 12);
-    void *uidnext = mutt_hcache_fetch_raw(hc, "/UIDNEXT", 8);
-    unsigned long long *modseq = mutt_hcache_fetch_raw(hc, "/MODSEQ", 7);
+    void *uidvalidity = mutt_hcache_fetch_raw(hc, "/UIDVALIDITY", 12, NULL);
+    void *uidnext = mutt_hcache_fetch_raw(hc, "/UIDNEXT", 8, NULL);
+    unsigned long long *modseq = mutt_hcache_fetch_raw(hc, "/MODSEQ", 7, NULL);
     if (uidvalidity)
     {
       mdata->uid_validity = *(unsigned int *) uidvalidity;
@@ -214,10 +224,10 @@ struct ImapMboxData *imap_mdata_new(struct ImapAccountData *adata, const char *n
  */
 void imap_mdata_cache_reset(struct ImapMboxData *mdata)
 {
-  mutt_hash_free(&mdata->uid_hash);
-  FREE(&mdata->msn_index);
-  mdata->msn_index_size = 0;
-  mdata->max_msn = 0;
+  imap_uid_free(&mdata->uid_index);
+  imap_msn_free(&mdata->msn);
+  mdata->modseq_seen = 0;
+  mdata->stubs = 0;
   mutt_bcache_close(&mdata->bcache);
 }
 
@@ -355,12 +365,13 @@ static void imap_msn_index_to_uid_seqset(struct Buffer *b, struct ImapMboxData *
   unsigned int cur_uid = 0, last_uid = 0;
   unsigned int range_begin = 0, range_end = 0;
 
-  for (unsigned int msn = 1; msn <= mdata->max_msn + 1; msn++)
+  const size_t max_msn = imap_msn_highest(&mdata->msn);
+  for (unsigned int msn = 1; msn <= max_msn + 1; msn++)
   {
     bool match = false;
-    if (msn <= mdata->max_msn)
+    if (msn <= max_msn)
     {
-      struct Email *cur_header = mdata->msn_index[msn - 1];
+      struct Email *cur_header = imap_msn_get(&mdata->msn, msn);
       cur_uid = cur_header ? imap_edata_get(cur_header)->uid : 0;
       if (!state || (cur_uid && ((cur_uid - 1) == last_uid)))
         match = true;
@@ -486,6 +497,9 @@ struct Email *imap_hcache_get(struct ImapMboxData *mdata, unsigned int uid)
  * @param e     Email
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * A stub isn't stored: its empty envelope would be taken for the real
+ * headers, see load_stubs().
  */
 int imap_hcache_put(struct ImapMboxData *mdata, struct Email *e)
 {
@@ -494,7 +508,11 @@ int imap_hcache_put(struct ImapMboxData *mdata, struct Email *e)
   if (!mdata->hcache)
     return -1;
 
-  sprintf(key, "/%u", imap_edata_get(e)->uid);
+  struct ImapEmailData *edata = imap_edata_get(e);
+  if (edata->stub)
+    return 0;
+
+  sprintf(key, "/%u", edata->uid);
   return mutt_hcache_store(mdata->hcache, key, imap_hcache_keylen(key), e, mdata->uid_validity);
 }
 
@@ -567,13 +585,119 @@ char *imap_hcache_get_uid_seqset(struct ImapMboxData *mdata)
   if (!mdata->hcache)
     return NULL;
 
-  char *hc_seqset = mutt_hcache_fetch_raw(mdata->hcache, "/UIDSEQSET", 10);
+  char *hc_seqset = mutt_hcache_fetch_raw(mdata->hcache, "/UIDSEQSET", 10, NULL);
   char *seqset = mutt_str_strdup(hc_seqset);
   mutt_hcache_free(mdata->hcache, (void **) &hc_seqset);
   mutt_debug(LL_DEBUG3, "Retrieved /UIDSEQSET %s\n", NONULL(seqset));
 
   return seqset;
 }
+
+/**
+ * imap_hcache_store_snapshot - Store a snapshot of the mailbox in the header cache
+ * @param mdata Imap Mailbox data
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * The flags are the server's, so they are valid for the HIGHESTMODSEQ we got
+ * when the mailbox was selected.  Any later changes will simply be sent again
+ * by the server.
+ */
+int imap_hcache_store_snapshot(struct ImapMboxData *mdata)
+{
+  if (!mdata->hcache)
+    return -1;
+
+  const size_t max_msn = imap_msn_highest(&mdata->msn);
+  struct ImapSnapshot *snap =
+      mutt_mem_calloc(1, sizeof(struct ImapSnapshot) + max_msn * sizeof(struct ImapSnapshotEntry));
+
+  snap->version = IMAP_SNAPSHOT_VERSION;
+  snap->uid_validity = mdata->uid_validity;
+  snap->uid_next = mdata->uid_next;
+  snap->modseq = mdata->modseq;
+
+  for (size_t msn = 1; msn <= max_msn; msn++)
+  {
+    struct Email *e = imap_msn_get(&mdata->msn, msn);
+    if (!e || !e->edata || !e->content)
+      continue;
+
+    struct ImapEmailData *edata = imap_edata_get(e);
+    struct ImapSnapshotEntry *entry = &snap->entries[snap->count++];
+    entry->uid = edata->uid;
+    entry->flags = (edata->read ? IMAP_SNAP_READ : 0) | (edata->old ? IMAP_SNAP_OLD : 0) |
+                   (edata->deleted ? IMAP_SNAP_DELETED : 0) |
+                   (edata->flagged ? IMAP_SNAP_FLAGGED : 0) |
+                   (edata->replied ? IMAP_SNAP_REPLIED : 0);
+    /* A stub's length is the whole email; otherwise it's just the body */
+    entry->size = e->content->offset + e->content->length;
+    entry->received = e->received;
+  }
+
+  int rc = mutt_hcache_store_raw(mdata->hcache, "/SNAPSHOT", 9, snap,
+                                 sizeof(struct ImapSnapshot) +
+                                     snap->count * sizeof(struct ImapSnapshotEntry));
+  mutt_debug(LL_DEBUG3, "Stored /SNAPSHOT of %u emails, modseq %llu\n", snap->count,
+             mdata->modseq);
+  FREE(&snap);
+  return rc;
+}
+
+/**
+ * imap_hcache_clear_snapshot - Delete the mailbox snapshot from the header cache
+ * @param mdata Imap Mailbox data
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+int imap_hcache_clear_snapshot(struct ImapMboxData *mdata)
+{
+  if (!mdata->hcache)
+    return -1;
+
+  return mutt_hcache_delete(mdata->hcache, "/SNAPSHOT", 9);
+}
+
+/**
+ * imap_hcache_get_snapshot - Get the mailbox snapshot from the header cache
+ * @param mdata Imap Mailbox data
+ * @retval ptr  Snapshot, must be freed with FREE()
+ * @retval NULL No valid snapshot
+ */
+struct ImapSnapshot *imap_hcache_get_snapshot(struct ImapMboxData *mdata)
+{
+  if (!mdata->hcache)
+    return NULL;
+
+  size_t dlen = 0;
+  struct ImapSnapshot *hc_snap = mutt_hcache_fetch_raw(mdata->hcache, "/SNAPSHOT", 9, &dlen);
+  if (!hc_snap)
+    return NULL;
+
+  /* Don't trust the stored count: it must fit in the record we got back */
+  struct ImapSnapshot *snap = NULL;
+  if ((dlen < sizeof(struct ImapSnapshot)) ||
+      (hc_snap->count > (dlen - sizeof(struct ImapSnapshot)) / sizeof(struct ImapSnapshotEntry)))
+  {
+    mutt_debug(LL_DEBUG1, "Ignoring truncated /SNAPSHOT (%zu bytes)\n", dlen);
+  }
+  else if ((hc_snap->version == IMAP_SNAPSHOT_VERSION) &&
+           (hc_snap->uid_validity == mdata->uid_validity) && (hc_snap->modseq != 0))
+  {
+    size_t len = sizeof(struct ImapSnapshot) + hc_snap->count * sizeof(struct ImapSnapshotEntry);
+    snap = mutt_mem_malloc(len);
+    memcpy(snap, hc_snap, len);
+    mutt_debug(LL_DEBUG3, "Retrieved /SNAPSHOT of %u emails, modseq %llu\n",
+               snap->count, (unsigned long long) snap->modseq);
+  }
+  else
+  {
+    mutt_debug(LL_DEBUG3, "Ignoring stale /SNAPSHOT\n");
+  }
+
+  mutt_hcache_free(mdata->hcache, (void **) &hc_snap);
+  return snap;
+}
 #endif
 
 /**
@@ -1067,7 +1191,18 @@ void imap_keepalive(void)
       continue;
 
     struct ImapAccountData *adata = np->adata;
-    if (!adata || !adata->mailbox)
+    if (!adata)
+      continue;
+
+    for (int i = 0; i < adata->poolsize; i++)
+    {
+      struct ImapAccountData *pdata = adata->pool[i];
+      if ((pdata->state >= IMAP_AUTHENTICATED) && !pdata->appending &&
+          (now >= (pdata->lastread + C_ImapKeepalive)))
+        imap_exec(pdata, "NOOP", IMAP_CMD_POLL);
+    }
+
+    if (!adata->mailbox)
       continue;
 
     if ((adata->state >= IMAP_AUTHENTICATED) && (now >= (adata->lastread + C_ImapKeepalive)))
@@ -423,6 +423,36 @@ static void resort_index(struct Menu *menu)
   menu->redraw |= REDRAW_INDEX | REDRAW_STATUS;
 }
 
+#ifdef USE_IMAP
+/**
+ * load_visible_headers - Fetch the missing headers of the page about to be drawn
+ * @param menu Current Menu
+ *
+ * This is done before drawing, since losing the connection closes the
+ * Mailbox.  A stub's sent date is its arrival date, so an index sorted by date
+ * is resorted once the real one is known.
+ */
+static void load_visible_headers(struct Menu *menu)
+{
+  const bool by_date = ((C_Sort & SORT_MASK) == SORT_DATE) ||
+                       ((C_SortAux & SORT_MASK) == SORT_DATE);
+
+  while (Context && Context->mailbox->emails && (Context->mailbox->magic == MUTT_IMAP) &&
+         (menu->current >= 0) && (menu->current < Context->mailbox->vcount))
+  {
+    menu_check_recenter(menu);
+    if (imap_load_visible_headers(Context->mailbox, menu->top, menu->pagelen) <= 0)
+      break;
+
+    menu->redraw |= REDRAW_INDEX | REDRAW_STATUS;
+    if (!by_date)
+      break;
+    /* the resorted page may show other stubs */
+    resort_index(menu);
+  }
+}
+#endif
+
 /**
  * update_index_threaded - Update the index (if threaded)
  * @param ctx      Mailbox
@@ -1070,6 +1100,22 @@ int mutt_index_menu(void)
         (menu->current >= 0))
       resort_index(menu);
 
+    /* messages that have changed may have entered or left the limit */
+    if (Context && (menu->menu == MENU_MAIN) && (Context->limit_dirty_num != 0))
+    {
+      struct Email *e_cur = ((menu->current >= 0) && (menu->current < Context->mailbox->vcount)) ?
+                                CUR_EMAIL :
+                                NULL;
+      if (ctx_limit_refresh(Context))
+      {
+        if (e_cur && (e_cur->virtual >= 0))
+          menu->current = e_cur->virtual;
+        else if (menu->current >= Context->mailbox->vcount)
+          menu->current = MAX(Context->mailbox->vcount - 1, 0);
+        menu->redraw |= REDRAW_INDEX | REDRAW_STATUS;
+      }
+    }
+
     menu->max = Context ? Context->mailbox->vcount : 0;
     oldcount = Context ? Context->mailbox->msg_count : 0;
 
@@ -1186,6 +1232,9 @@ int mutt_index_menu(void)
 
     if (menu->menu == MENU_MAIN)
     {
+#ifdef USE_IMAP
+      load_visible_headers(menu);
+#endif
       index_custom_redraw(menu);
 
       /* give visual indication that the next command is a tag- command */
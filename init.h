@@ -36,10 +36,12 @@
 #include "mutt.h"
 #include "addrbook.h"
 #include "bcache.h"
+#include "bodyindex.h"
 #include "browser.h"
 #include "color.h"
 #include "commands.h"
 #include "compose.h"
+#include "context.h"
 #include "curs_lib.h"
 #include "edit.h"
 #include "globals.h"
@@ -407,6 +409,20 @@ struct ConfigDef MuttVars[] = {
   ** notifying you of new mail.  This is independent of the setting of the
   ** $$beep variable.
   */
+#ifdef USE_HCACHE
+  { "body_index",       DT_BOOL, R_NONE, &C_BodyIndex, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt keeps an index of the text of the emails it has
+  ** searched, in the "$$header_cache" database.  Later body and header searches
+  ** (``~b'', ``~B'', ``~h'' and their ``='' forms) for plain text, with no
+  ** regular expression characters, use it to skip emails that can't match,
+  ** without fetching or decoding them.
+  ** .pp
+  ** An email is indexed the first time it is searched.  Encrypted emails are
+  ** never indexed.
+  */
+#endif
   { "bounce",   DT_QUAD, R_NONE, &C_Bounce, MUTT_ASKYES },
   /*
   ** .pp
@@ -848,6 +864,9 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** This option can be enabled on the command line, "neomutt -d 2"
   ** .pp
+  ** While the debug level is above 0, patterns are matched on a single
+  ** thread, so limiting or searching a large mailbox may be slower.
+  ** .pp
   ** See also: \fC$$debug_file\fP
   */
   { "default_hook",     DT_STRING,  R_NONE, &C_DefaultHook, IP "~f %s !~P | (~P ~C %s)" },
@@ -1564,6 +1583,22 @@ struct ConfigDef MuttVars[] = {
   ** those, and displays worse performance when enabled.  Your
   ** mileage may vary.
   */
+  { "imap_connections", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &C_ImapConnections, 1 },
+  /*
+  ** .pp
+  ** The maximum number of connections NeoMutt will open to each IMAP account.
+  ** Only one connection is used for the currently selected mailbox.  The
+  ** others are opened when needed, and are used for commands that don't
+  ** depend on a selected mailbox, such as the \fCSTATUS\fP commands of
+  ** $$mail_check_stats and listing the folders in the browser.  Spreading
+  ** these commands over several connections lets the server work on them in
+  ** parallel and avoids interrupting the selected mailbox.
+  ** .pp
+  ** A value of 0 or 1 disables the extra connections.  Some servers limit the
+  ** number of simultaneous connections per user.
+  ** .pp
+  ** \fBNote:\fP Changes to this variable have no effect on open connections.
+  */
   { "imap_delim_chars",         DT_STRING, R_NONE, &C_ImapDelimChars, IP "/." },
   /*
   ** .pp
@@ -1571,6 +1606,16 @@ struct ConfigDef MuttVars[] = {
   ** as folder separators for displaying IMAP paths. In particular it
   ** helps in using the "=" shortcut for your \fIfolder\fP variable.
   */
+  { "imap_fetch_chunk_size",    DT_LONG|DT_NOT_NEGATIVE, R_NONE, &C_ImapFetchChunkSize, 0 },
+  /*
+  ** .pp
+  ** When set to a non-zero value, NeoMutt downloads messages from an IMAP
+  ** server in pieces of this many bytes, rather than all at once.  The
+  ** progress bar then covers the whole message and a large download can be
+  ** interrupted with \fC^C\fP between pieces.
+  ** .pp
+  ** A value of 0 disables this feature.
+  */
   { "imap_headers",     DT_STRING, R_INDEX, &C_ImapHeaders, 0 },
   /*
   ** .pp
@@ -1594,6 +1639,19 @@ struct ConfigDef MuttVars[] = {
   ** to NeoMutt's implementation. If your connection seems to freeze
   ** up periodically, try unsetting this.
   */
+  { "imap_idle_watch", DT_REGEX|DT_REGEX_MATCH_CASE|DT_REGEX_ALLOW_NOT|DT_REGEX_NOSUB, R_NONE, &C_ImapIdleWatch, 0 },
+  /*
+  ** .pp
+  ** IMAP mailboxes whose name matches this regular expression are watched
+  ** with IDLE, each on a connection of its own, instead of being polled
+  ** (example: "\fCset imap_idle_watch=^INBOX|^work/\fP").  Changes to them
+  ** are then noticed at the next mailbox check, without asking the server
+  ** for the status of each one.  The selected mailbox is never watched, it
+  ** already uses $$imap_idle.
+  ** .pp
+  ** Every watched mailbox costs a connection to the server.  If the server
+  ** refuses one, the remaining mailboxes are polled as usual.
+  */
   { "imap_keepalive",           DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &C_ImapKeepalive, 300 },
   /*
   ** .pp
@@ -1605,6 +1663,21 @@ struct ConfigDef MuttVars[] = {
   ** violated every now and then. Reduce this number if you find yourself
   ** getting disconnected from your IMAP server due to inactivity.
   */
+  { "imap_lazy_headers",        DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &C_ImapLazyHeaders, 0 },
+  /*
+  ** .pp
+  ** When opening an IMAP mailbox with more than this number of headers
+  ** to download, NeoMutt only fetches the UID, flags, date and size of each
+  ** message.  The headers are then fetched as the index is displayed, a
+  ** couple of pages at a time.
+  ** .pp
+  ** Anything that needs the headers of every message, such as searching,
+  ** limiting, threading or sorting by author or subject, will fetch all the
+  ** missing headers first.  Sorting by date uses the date the server received
+  ** the message until its headers are fetched.
+  ** .pp
+  ** A value of 0 disables this feature.
+  */
   { "imap_list_subscribed",     DT_BOOL, R_NONE, &C_ImapListSubscribed, false },
   /*
   ** .pp
@@ -1619,6 +1692,18 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** This variable defaults to the value of $$imap_user.
   */
+  { "imap_notify",              DT_BOOL, R_NONE, &C_ImapNotify, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt will use the NOTIFY extension (RFC5465), if the
+  ** server supports it, to check the mailboxes that aren't selected.  The
+  ** server is told once about all the mailboxes of an account and then
+  ** pushes any change in their status, so they don't need to be polled with
+  ** a \fCSTATUS\fP command at every check.
+  ** .pp
+  ** Without NOTIFY, NeoMutt still uses a single LIST-STATUS command (RFC5819)
+  ** per account, if the server supports it.
+  */
   { "imap_oauth_refresh_command", DT_STRING, R_NONE, &C_ImapOauthRefreshCmd, 0 },
   /*
   ** .pp
@@ -1685,6 +1770,16 @@ struct ConfigDef MuttVars[] = {
   ** strange behavior, such as duplicate or missing messages please
   ** file a bug report to let us know.
   */
+  { "imap_server_sort",         DT_BOOL, R_NONE, &C_ImapServerSort, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt will ask IMAP servers that support the SORT
+  ** extension (RFC5256) to sort the index, rather than comparing the headers
+  ** itself.  This is only done when both $$sort and $$sort_aux are
+  ** \fIdate\fP or \fIreceived\fP (or \fIorder\fP for $$sort_aux), which
+  ** the server sorts the same way as NeoMutt.  Threads are always sorted
+  ** locally.
+  */
   { "imap_servernoise",         DT_BOOL, R_NONE, &C_ImapServernoise, true },
   /*
   ** .pp
@@ -1870,6 +1965,20 @@ struct ConfigDef MuttVars[] = {
   ** from your spool mailbox to your $$mbox mailbox, or as a result of
   ** a "$mbox-hook" command.
   */
+  { "live_limit",       DT_BOOL, R_NONE, &C_LiveLimit, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, a limited view is kept up to date as messages change.
+  ** A message that stops matching the limit pattern, e.g. one that has been
+  ** read under ``~N'', leaves the view when you return to the index.  A
+  ** message that starts matching it joins the view.  Only the messages that
+  ** have changed are checked again.
+  ** .pp
+  ** When \fIunset\fP, the view only changes when a new limit is applied or
+  ** new mail arrives.
+  ** .pp
+  ** Also see the \fC<limit>\fP function.
+  */
   { "mail_check",       DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &C_MailCheck, 5 },
   /*
   ** .pp
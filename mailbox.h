@@ -36,6 +36,8 @@
 struct Buffer;
 struct Account;
 struct stat;
+struct PatternMemos;
+struct PatternRanges;
 
 /* These Config Variables are only used in mailbox.c */
 extern short C_MailCheck;
@@ -128,6 +130,8 @@ struct Mailbox
   struct Hash *id_hash;     /**< hash table by msg id */
   struct Hash *subj_hash;   /**< hash table by subject */
   struct Hash *label_hash;  /**< hash table for x-labels */
+  struct PatternMemos *pattern_memo; /**< remembered Pattern results */
+  struct PatternRanges *pattern_ranges; /**< sorted indexes for range Patterns */
 
   struct Account *account;
   int opened;              /**< number of times mailbox is opened */
@@ -117,6 +117,230 @@ void mutt_regex_free(struct Regex **r)
   FREE(r);
 }
 
+/**
+ * skip_bracket - Skip over a bracket expression, e.g. "[^]a-z]"
+ * @param p Opening bracket
+ * @retval ptr Character after the closing bracket, or the end of the string
+ */
+static const char *skip_bracket(const char *p)
+{
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']') /* a leading ']' is literal */
+    p++;
+  for (; *p && (*p != ']'); p++)
+  {
+    /* [:class:], [=equiv=] and [.coll.] can contain a ']' */
+    if ((p[0] == '[') && p[1] && strchr(":=.", p[1]))
+    {
+      const char end[3] = { p[1], ']', '\0' };
+      const char *close = strstr(p + 2, end);
+      if (close)
+        p = close + 1;
+    }
+  }
+  return *p ? p + 1 : p;
+}
+
+/**
+ * skip_group - Skip over a parenthesised group, e.g. "(a|b)"
+ * @param p Opening parenthesis
+ * @retval ptr Character after the closing parenthesis, or the end of the string
+ */
+static const char *skip_group(const char *p)
+{
+  int depth = 0;
+  while (*p)
+  {
+    if (*p == '[')
+    {
+      p = skip_bracket(p);
+      continue;
+    }
+    if ((p[0] == '\\') && p[1])
+      p++;
+    else if (*p == '(')
+      depth++;
+    else if ((*p == ')') && (--depth == 0))
+      return p + 1;
+    p++;
+  }
+  return p;
+}
+
+/**
+ * mutt_regex_literal - Find some text that every match of a regex contains
+ * @param[in]  str   Extended regular expression
+ * @param[in]  flags Flags, e.g. REG_ICASE
+ * @param[out] lit   Longest run of plain characters the regex needs
+ * @retval true  Text found
+ * @retval false The regex doesn't need any particular text
+ *
+ * Groups, brackets and anchors split the regex into runs of plain characters.
+ * A character followed by '*', '?' or an interval is optional, so it's
+ * dropped.  Any alternation outside a group means nothing is required.
+ *
+ * For case-insensitive regexes, only ASCII characters are used, so that a
+ * simple case-folding comparison finds the text.
+ */
+bool mutt_regex_literal(const char *str, int flags, struct RegexLiteral *lit)
+{
+  if (!lit)
+    return false;
+
+  memset(lit, 0, sizeof(*lit));
+  if (!str || !*str)
+    return false;
+
+  const bool icase = (flags & REG_ICASE);
+  char *run = mutt_mem_malloc(strlen(str) + 1);
+  size_t run_len = 0;
+  size_t atom = 0; /* start of the last character in the run */
+  char *best = mutt_mem_malloc(strlen(str) + 1);
+  size_t best_len = 0;
+  bool whole = true;
+
+  for (const char *p = str; *p;)
+  {
+    const char *next = p + 1;
+    size_t len = 1;
+    bool plain = false;
+
+    switch (*p)
+    {
+      case '|':
+        /* either side may match, so nothing is required */
+        FREE(&run);
+        FREE(&best);
+        return false;
+      case '*':
+      case '?':
+      case '{':
+        run_len = atom; /* the last character is optional */
+        if (*p == '{')
+        {
+          next = strchr(p, '}');
+          next = next ? next + 1 : p + strlen(p);
+        }
+        break;
+      case '(':
+        next = skip_group(p);
+        break;
+      case '[':
+        next = skip_bracket(p);
+        break;
+      case '+':
+      case '.':
+      case '^':
+      case '$':
+        break;
+      case '\\':
+        if (!p[1])
+          break;
+        next = p + 2;
+        /* \w, \<, \1, etc. aren't plain characters */
+        if (!isalnum((unsigned char) p[1]) && !strchr("<>`'", p[1]))
+        {
+          plain = true;
+          p++;
+        }
+        break;
+      default:
+        plain = true;
+        /* keep multibyte characters whole */
+        while (((unsigned char) p[0] & 0x80) && (((unsigned char) p[len] & 0xc0) == 0x80))
+          len++;
+        next = p + len;
+        break;
+    }
+
+    if (plain && icase && ((unsigned char) *p & 0x80))
+      plain = false;
+
+    if (plain)
+    {
+      atom = run_len;
+      memcpy(run + run_len, p, len);
+      run_len += len;
+    }
+    else
+    {
+      whole = false;
+      if (run_len > best_len)
+      {
+        memcpy(best, run, run_len);
+        best_len = run_len;
+      }
+      run_len = 0;
+      atom = 0;
+    }
+    p = next;
+  }
+
+  if (run_len > best_len)
+  {
+    memcpy(best, run, run_len);
+    best_len = run_len;
+  }
+  FREE(&run);
+
+  if (best_len == 0)
+  {
+    FREE(&best);
+    return false;
+  }
+
+  best[best_len] = '\0';
+  lit->str = best;
+  lit->len = best_len;
+  lit->icase = icase;
+  lit->whole = whole;
+  return true;
+}
+
+/**
+ * mutt_regex_literal_find - Does a string contain a regex's required text?
+ * @param lit Required text, from mutt_regex_literal()
+ * @param str String to search
+ * @retval true The text was found, or there's no required text
+ *
+ * If RegexLiteral::whole is set, this is the result of the regex.
+ */
+bool mutt_regex_literal_find(const struct RegexLiteral *lit, const char *str)
+{
+  if (!lit || !lit->str)
+    return true;
+  if (!str)
+    return false;
+
+  if (!lit->icase)
+    return strstr(str, lit->str);
+
+  /* jump between copies of the first character, in either case */
+  const char first[3] = { tolower((unsigned char) lit->str[0]),
+                          toupper((unsigned char) lit->str[0]), '\0' };
+  for (const char *p = strpbrk(str, first); p; p = strpbrk(p + 1, first))
+  {
+    if (mutt_str_strncasecmp(p, lit->str, lit->len) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * mutt_regex_literal_free - Free the text of a RegexLiteral
+ * @param lit RegexLiteral to empty
+ */
+void mutt_regex_literal_free(struct RegexLiteral *lit)
+{
+  if (!lit)
+    return;
+
+  FREE(&lit->str);
+  memset(lit, 0, sizeof(*lit));
+}
+
 /**
  * mutt_regexlist_add - Compile a regex string and add it to a list
  * @param rl    RegexList to add to
@@ -84,10 +84,28 @@ struct ReplaceListNode
 };
 STAILQ_HEAD(ReplaceList, ReplaceListNode);
 
+/**
+ * struct RegexLiteral - Text that every match of a regex contains
+ *
+ * Looking for the text is much cheaper than running the regex, so strings
+ * without it can be rejected early.
+ */
+struct RegexLiteral
+{
+  char *str;  /**< Required text, NULL if there's none */
+  size_t len; /**< Length of the text */
+  bool icase; /**< Ignore (ASCII) case when looking for the text */
+  bool whole; /**< The regex is nothing but the text */
+};
+
 struct Regex *mutt_regex_compile(const char *str, int flags);
 struct Regex *mutt_regex_new(const char *str, int flags, struct Buffer *err);
 void          mutt_regex_free(struct Regex **r);
 
+bool mutt_regex_literal     (const char *str, int flags, struct RegexLiteral *lit);
+bool mutt_regex_literal_find(const struct RegexLiteral *lit, const char *str);
+void mutt_regex_literal_free(struct RegexLiteral *lit);
+
 int                   mutt_regexlist_add(struct RegexList *rl, const char *str, int flags, struct Buffer *err);
 void                  mutt_regexlist_free(struct RegexList *rl);
 bool                  mutt_regexlist_match(struct RegexList *rl, const char *str);
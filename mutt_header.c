@@ -114,6 +114,7 @@ static bool label_message(struct Mailbox *m, struct Email *e, char *new)
 
   e->changed = true;
   e->env->changed |= MUTT_ENV_CHANGED_XLABEL;
+  mutt_email_touch(e);
   return true;
 }
 
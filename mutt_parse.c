@@ -66,6 +66,7 @@ void mutt_parse_mime_message(struct Mailbox *m, struct Email *e)
         e->security = crypt_query(e->content);
 
       mx_msg_close(m, &msg);
+      mutt_email_touch(e);
     }
   } while (false);
 
@@ -388,6 +388,8 @@ void mx_fastclose_mailbox(struct Mailbox *m)
   mutt_hash_free(&m->subj_hash);
   mutt_hash_free(&m->id_hash);
   mutt_hash_free(&m->label_hash);
+  mutt_pattern_memo_free(&m->pattern_memo);
+  mutt_pattern_ranges_free(&m->pattern_ranges);
 
   if (m->emails)
   {
@@ -33,8 +33,11 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -66,22 +69,138 @@ char *C_Newsrc; ///< Config: (nntp) File containing list of subscribed newsgroup
 
 struct BodyCache;
 
+#define ACTIVE_CACHE_MAGIC "NMACTV1"
+
 /**
- * mdata_find - Find NntpMboxData for given newsgroup or add it
+ * struct ActiveCacheHeader - Header of the cached list of newsgroups
+ *
+ * The header is followed by an array of ActiveCacheRecord, sorted by group
+ * name, then by the strings they refer to.  The file is mapped into memory
+ * and searched in place, so NntpMboxData is only created for the groups
+ * that are actually used.
+ */
+struct ActiveCacheHeader
+{
+  char magic[8];          ///< ACTIVE_CACHE_MAGIC
+  uint32_t record_size;   ///< sizeof(struct ActiveCacheRecord)
+  uint32_t count;         ///< Number of records
+  int64_t newgroups_time; ///< Last time the server was asked for new groups
+};
+
+/**
+ * struct ActiveCacheRecord - One newsgroup in the cached list
+ */
+struct ActiveCacheRecord
+{
+  uint32_t group;   ///< Offset of the group name
+  uint32_t desc;    ///< Offset of the description, 0 if none
+  anum_t first;     ///< First article number
+  anum_t last;      ///< Last article number
+  uint32_t allowed; ///< Posting is allowed
+};
+
+/**
+ * struct ActiveCacheEntry - A newsgroup waiting to be written to the cache
+ */
+struct ActiveCacheEntry
+{
+  const char *group;
+  const char *desc;
+  anum_t first;
+  anum_t last;
+  bool allowed;
+};
+
+/**
+ * active_cache_str - Get a string from the cached list of newsgroups
+ * @param adata NNTP server
+ * @param off   Offset of the string
+ * @retval ptr  String
+ * @retval NULL Offset is out of range
+ */
+static const char *active_cache_str(const struct NntpAccountData *adata, uint32_t off)
+{
+  if ((off == 0) || (off >= adata->active_len))
+    return NULL;
+  return (const char *) adata->active_map + off;
+}
+
+/**
+ * active_cache_find - Find a newsgroup in the cached list
  * @param adata NNTP server
  * @param group Newsgroup
- * @retval ptr  NNTP data
- * @retval NULL Error
+ * @retval ptr  Cache record
+ * @retval NULL Not found
  */
-static struct NntpMboxData *mdata_find(struct NntpAccountData *adata, const char *group)
+static const struct ActiveCacheRecord *active_cache_find(const struct NntpAccountData *adata,
+                                                         const char *group)
 {
-  struct NntpMboxData *mdata = mutt_hash_find(adata->groups_hash, group);
-  if (mdata)
-    return mdata;
+  if (!adata->active_map)
+    return NULL;
+
+  const struct ActiveCacheHeader *hdr = adata->active_map;
+  const struct ActiveCacheRecord *recs = (const struct ActiveCacheRecord *) (hdr + 1);
+  size_t lo = 0;
+  size_t hi = hdr->count;
+
+  while (lo < hi)
+  {
+    const size_t mid = (lo + hi) / 2;
+    const char *name = active_cache_str(adata, recs[mid].group);
+    if (!name)
+      return NULL;
+
+    const int cmp = strcmp(group, name);
+    if (cmp == 0)
+      return &recs[mid];
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return NULL;
+}
+
+/**
+ * active_unread - Estimate the number of unread articles in a newsgroup
+ * @param mdata NNTP Mailbox data
+ */
+static void active_unread(struct NntpMboxData *mdata)
+{
+  if (mdata->newsrc_ent || mdata->last_cached)
+    nntp_group_unread_stat(mdata);
+  else if (mdata->last_message && (mdata->first_message <= mdata->last_message))
+    mdata->unread = mdata->last_message - mdata->first_message + 1;
+  else
+    mdata->unread = 0;
+}
+
+/**
+ * active_cache_apply - Copy a cached newsgroup into its NntpMboxData
+ * @param mdata NNTP Mailbox data
+ * @param rec   Cache record
+ */
+static void active_cache_apply(struct NntpMboxData *mdata, const struct ActiveCacheRecord *rec)
+{
+  mdata->deleted = false;
+  mdata->first_message = rec->first;
+  mdata->last_message = rec->last;
+  mdata->allowed = rec->allowed;
+  mutt_str_replace(&mdata->desc, active_cache_str(mdata->adata, rec->desc));
+  active_unread(mdata);
+}
 
+/**
+ * mdata_new - Create NntpMboxData for a newsgroup
+ * @param adata NNTP server
+ * @param group Newsgroup
+ * @retval ptr NNTP data
+ */
+static struct NntpMboxData *mdata_new(struct NntpAccountData *adata, const char *group)
+{
   size_t len = strlen(group) + 1;
   /* create NntpMboxData structure and add it to hash */
-  mdata = mutt_mem_calloc(1, sizeof(struct NntpMboxData) + len);
+  struct NntpMboxData *mdata = mutt_mem_calloc(1, sizeof(struct NntpMboxData) + len);
   mdata->group = (char *) mdata + sizeof(struct NntpMboxData);
   mutt_str_strfcpy(mdata->group, group, len);
   mdata->adata = adata;
@@ -99,6 +218,47 @@ static struct NntpMboxData *mdata_find(struct NntpAccountData *adata, const char
   return mdata;
 }
 
+/**
+ * nntp_mdata_get - Get NntpMboxData for a known newsgroup
+ * @param adata NNTP server
+ * @param group Newsgroup
+ * @retval ptr  NNTP data
+ * @retval NULL Newsgroup isn't known
+ *
+ * A newsgroup that's only in the cached list of newsgroups gets its
+ * NntpMboxData now.
+ */
+struct NntpMboxData *nntp_mdata_get(struct NntpAccountData *adata, const char *group)
+{
+  struct NntpMboxData *mdata = mutt_hash_find(adata->groups_hash, group);
+  if (mdata)
+    return mdata;
+
+  const struct ActiveCacheRecord *rec = active_cache_find(adata, group);
+  if (!rec)
+    return NULL;
+
+  mdata = mdata_new(adata, group);
+  active_cache_apply(mdata, rec);
+  return mdata;
+}
+
+/**
+ * mdata_find - Find NntpMboxData for given newsgroup or add it
+ * @param adata NNTP server
+ * @param group Newsgroup
+ * @retval ptr  NNTP data
+ * @retval NULL Error
+ */
+static struct NntpMboxData *mdata_find(struct NntpAccountData *adata, const char *group)
+{
+  struct NntpMboxData *mdata = nntp_mdata_get(adata, group);
+  if (mdata)
+    return mdata;
+
+  return mdata_new(adata, group);
+}
+
 /**
  * nntp_acache_free - Remove all temporarily cache files
  * @param mdata NNTP Mailbox data
@@ -383,10 +543,11 @@ void nntp_newsrc_gen_entries(struct Mailbox *m)
  * update_file - Update file with new contents
  * @param filename File to update
  * @param buf      New context
+ * @param buflen   Length of buf
  * @retval  0 Success
  * @retval -1 Failure
  */
-static int update_file(char *filename, char *buf)
+static int update_file(char *filename, const char *buf, size_t buflen)
 {
   FILE *fp = NULL;
   char tmpfile[PATH_MAX];
@@ -402,7 +563,7 @@ static int update_file(char *filename, char *buf)
       *tmpfile = '\0';
       break;
     }
-    if (fputs(buf, fp) == EOF)
+    if (fwrite(buf, 1, buflen, fp) != buflen)
     {
       mutt_perror(tmpfile);
       break;
@@ -491,7 +652,7 @@ int nntp_newsrc_update(struct NntpAccountData *adata)
 
   /* newrc being fully rewritten */
   mutt_debug(LL_DEBUG1, "Updating %s\n", adata->newsrc_file);
-  if (adata->newsrc_file && (update_file(adata->newsrc_file, buf) == 0))
+  if (adata->newsrc_file && (update_file(adata->newsrc_file, buf, strlen(buf)) == 0))
   {
     struct stat sb;
 
@@ -593,70 +754,143 @@ int nntp_add_group(char *line, void *data)
   mdata->last_message = last;
   mdata->allowed = (mod == 'y') || (mod == 'm');
   mutt_str_replace(&mdata->desc, desc);
-  if (mdata->newsrc_ent || mdata->last_cached)
-    nntp_group_unread_stat(mdata);
-  else if (mdata->last_message && (mdata->first_message <= mdata->last_message))
-    mdata->unread = mdata->last_message - mdata->first_message + 1;
-  else
-    mdata->unread = 0;
+  active_unread(mdata);
   return 0;
 }
 
+/**
+ * nntp_active_cache_free - Release the cached list of newsgroups
+ * @param adata NNTP server
+ */
+void nntp_active_cache_free(struct NntpAccountData *adata)
+{
+  if (!adata->active_map)
+    return;
+
+  munmap(adata->active_map, adata->active_len);
+  adata->active_map = NULL;
+  adata->active_len = 0;
+}
+
 /**
  * active_get_cache - Load list of all newsgroups from cache
  * @param adata NNTP server
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The cache is mapped into memory, rather than parsed.  Only the newsgroups
+ * that are already known (from the .newsrc) are looked up now.
  */
 static int active_get_cache(struct NntpAccountData *adata)
 {
-  char buf[8192];
   char file[PATH_MAX];
-  time_t t;
+  struct stat sb;
 
   cache_expand(file, sizeof(file), &adata->conn->account, ".active");
-  mutt_debug(LL_DEBUG1, "Parsing %s\n", file);
+  mutt_debug(LL_DEBUG1, "Mapping %s\n", file);
   FILE *fp = mutt_file_fopen(file, "r");
   if (!fp)
     return -1;
 
-  if (!fgets(buf, sizeof(buf), fp) || (sscanf(buf, "%ld%s", &t, file) != 1) || (t == 0))
+  void *map = MAP_FAILED;
+  if ((fstat(fileno(fp), &sb) == 0) && ((size_t) sb.st_size > sizeof(struct ActiveCacheHeader)))
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  mutt_file_fclose(&fp);
+  if (map == MAP_FAILED)
+    return -1;
+
+  const struct ActiveCacheHeader *hdr = map;
+  const size_t len = sb.st_size;
+  if ((memcmp(hdr->magic, ACTIVE_CACHE_MAGIC, sizeof(hdr->magic)) != 0) ||
+      (hdr->record_size != sizeof(struct ActiveCacheRecord)) ||
+      (hdr->count > (len - sizeof(*hdr)) / sizeof(struct ActiveCacheRecord)) ||
+      (((const char *) map)[len - 1] != '\0') || (hdr->newgroups_time == 0))
   {
-    mutt_file_fclose(&fp);
+    mutt_debug(LL_DEBUG1, "Ignoring invalid %s\n", file);
+    munmap(map, len);
     return -1;
   }
-  adata->newgroups_time = t;
 
-  mutt_message(_("Loading list of groups from cache..."));
-  while (fgets(buf, sizeof(buf), fp))
-    nntp_add_group(buf, adata);
-  nntp_add_group(NULL, NULL);
-  mutt_file_fclose(&fp);
-  mutt_clear_error();
+  nntp_active_cache_free(adata);
+  adata->active_map = map;
+  adata->active_len = len;
+  adata->newgroups_time = hdr->newgroups_time;
+
+  for (unsigned int i = 0; i < adata->groups_num; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+    if (!mdata)
+      continue;
+
+    const struct ActiveCacheRecord *rec = active_cache_find(adata, mdata->group);
+    if (rec)
+      active_cache_apply(mdata, rec);
+  }
   return 0;
 }
 
+/**
+ * nntp_active_expand - Create NntpMboxData for every cached newsgroup
+ * @param adata NNTP server
+ *
+ * This is needed before listing all the newsgroups.  Afterwards, the cache
+ * isn't needed any more.
+ */
+void nntp_active_expand(struct NntpAccountData *adata)
+{
+  if (!adata || !adata->active_map)
+    return;
+
+  const struct ActiveCacheHeader *hdr = adata->active_map;
+  const struct ActiveCacheRecord *recs = (const struct ActiveCacheRecord *) (hdr + 1);
+
+  for (uint32_t i = 0; i < hdr->count; i++)
+  {
+    const char *group = active_cache_str(adata, recs[i].group);
+    if (!group || mutt_hash_find(adata->groups_hash, group))
+      continue;
+
+    active_cache_apply(mdata_new(adata, group), &recs[i]);
+  }
+
+  nntp_active_cache_free(adata);
+}
+
+/**
+ * active_entry_cmp - Compare two newsgroups by name - Implements ::sort_t
+ */
+static int active_entry_cmp(const void *a, const void *b)
+{
+  const struct ActiveCacheEntry *ea = a;
+  const struct ActiveCacheEntry *eb = b;
+
+  return strcmp(ea->group, eb->group);
+}
+
 /**
  * nntp_active_save_cache - Save list of all newsgroups to cache
  * @param adata NNTP server
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The newsgroups that haven't been looked at are copied from the old cache.
  */
 int nntp_active_save_cache(struct NntpAccountData *adata)
 {
   char file[PATH_MAX];
-  char *buf = NULL;
-  size_t buflen, off;
   int rc;
 
   if (!adata->cacheable)
     return 0;
 
-  buflen = 10240;
-  buf = mutt_mem_calloc(1, buflen);
-  snprintf(buf, buflen, "%lu\n", (unsigned long) adata->newgroups_time);
-  off = strlen(buf);
+  const struct ActiveCacheHeader *old = adata->active_map;
+  const struct ActiveCacheRecord *old_recs =
+      old ? (const struct ActiveCacheRecord *) (old + 1) : NULL;
+  size_t num = adata->groups_num + (old ? old->count : 0);
+  struct ActiveCacheEntry *entries = mutt_mem_calloc(MAX(num, 1), sizeof(*entries));
+  size_t strings = 1;
 
+  num = 0;
   for (unsigned int i = 0; i < adata->groups_num; i++)
   {
     struct NntpMboxData *mdata = adata->groups_list[i];
@@ -664,20 +898,69 @@ int nntp_active_save_cache(struct NntpAccountData *adata)
     if (!mdata || mdata->deleted)
       continue;
 
-    if (off + strlen(mdata->group) + (mdata->desc ? strlen(mdata->desc) : 0) + 50 > buflen)
+    struct ActiveCacheEntry *ent = &entries[num++];
+    ent->group = mdata->group;
+    ent->desc = mdata->desc;
+    ent->first = mdata->first_message;
+    ent->last = mdata->last_message;
+    ent->allowed = mdata->allowed;
+  }
+  for (uint32_t i = 0; old && (i < old->count); i++)
+  {
+    const char *group = active_cache_str(adata, old_recs[i].group);
+    if (!group || mutt_hash_find(adata->groups_hash, group))
+      continue;
+
+    struct ActiveCacheEntry *ent = &entries[num++];
+    ent->group = group;
+    ent->desc = active_cache_str(adata, old_recs[i].desc);
+    ent->first = old_recs[i].first;
+    ent->last = old_recs[i].last;
+    ent->allowed = old_recs[i].allowed;
+  }
+  qsort(entries, num, sizeof(*entries), active_entry_cmp);
+
+  for (size_t i = 0; i < num; i++)
+  {
+    strings += strlen(entries[i].group) + 1;
+    if (entries[i].desc && *entries[i].desc)
+      strings += strlen(entries[i].desc) + 1;
+  }
+
+  const size_t head = sizeof(struct ActiveCacheHeader) + num * sizeof(struct ActiveCacheRecord);
+  const size_t buflen = head + strings;
+  char *buf = mutt_mem_calloc(1, buflen);
+  struct ActiveCacheHeader *hdr = (struct ActiveCacheHeader *) buf;
+  struct ActiveCacheRecord *recs = (struct ActiveCacheRecord *) (hdr + 1);
+  size_t off = head + 1; /* the string table starts with an empty string */
+
+  memcpy(hdr->magic, ACTIVE_CACHE_MAGIC, sizeof(hdr->magic));
+  hdr->record_size = sizeof(struct ActiveCacheRecord);
+  hdr->count = num;
+  hdr->newgroups_time = adata->newgroups_time;
+  for (size_t i = 0; i < num; i++)
+  {
+    size_t len = strlen(entries[i].group) + 1;
+    memcpy(buf + off, entries[i].group, len);
+    recs[i].group = off;
+    off += len;
+
+    if (entries[i].desc && *entries[i].desc)
     {
-      buflen *= 2;
-      mutt_mem_realloc(&buf, buflen);
+      len = strlen(entries[i].desc) + 1;
+      memcpy(buf + off, entries[i].desc, len);
+      recs[i].desc = off;
+      off += len;
     }
-    snprintf(buf + off, buflen - off, "%s %u %u %c%s%s\n", mdata->group,
-             mdata->last_message, mdata->first_message, mdata->allowed ? 'y' : 'n',
-             mdata->desc ? " " : "", mdata->desc ? mdata->desc : "");
-    off += strlen(buf + off);
+    recs[i].first = entries[i].first;
+    recs[i].last = entries[i].last;
+    recs[i].allowed = entries[i].allowed;
   }
+  FREE(&entries);
 
   cache_expand(file, sizeof(file), &adata->conn->account, ".active");
   mutt_debug(LL_DEBUG1, "Updating %s\n", file);
-  rc = update_file(file, buf);
+  rc = update_file(file, buf, buflen);
   FREE(&buf);
   return rc;
 }
@@ -741,7 +1024,7 @@ void nntp_hcache_update(struct NntpMboxData *mdata, header_cache_t *hc)
     return;
 
   /* fetch previous values of first and last */
-  hdata = mutt_hcache_fetch_raw(hc, "index", 5);
+  hdata = mutt_hcache_fetch_raw(hc, "index", 5, NULL);
   if (hdata)
   {
     mutt_debug(LL_DEBUG2, "mutt_hcache_fetch index: %s\n", (char *) hdata);
@@ -1121,7 +1404,7 @@ struct NntpAccountData *nntp_select_server(struct Mailbox *m, char *server, bool
         if ((strlen(group) < 8) || (strcmp(p, ".hcache") != 0))
           continue;
         *p = '\0';
-        struct NntpMboxData *mdata = mutt_hash_find(adata->groups_hash, group);
+        struct NntpMboxData *mdata = nntp_mdata_get(adata, group);
         if (!mdata)
           continue;
 
@@ -1130,7 +1413,7 @@ struct NntpAccountData *nntp_select_server(struct Mailbox *m, char *server, bool
           continue;
 
         /* fetch previous values of first and last */
-        hdata = mutt_hcache_fetch_raw(hc, "index", 5);
+        hdata = mutt_hcache_fetch_raw(hc, "index", 5, NULL);
         if (hdata)
         {
           anum_t first, last;
@@ -1162,6 +1445,7 @@ struct NntpAccountData *nntp_select_server(struct Mailbox *m, char *server, bool
 
   if (rc < 0)
   {
+    nntp_active_cache_free(adata);
     mutt_hash_free(&adata->groups_hash);
     FREE(&adata->groups_list);
     FREE(&adata->newsrc_file);
@@ -1256,7 +1540,7 @@ struct NntpMboxData *mutt_newsgroup_unsubscribe(struct NntpAccountData *adata, c
   if (!adata || !adata->groups_hash || !group || !*group)
     return NULL;
 
-  mdata = mutt_hash_find(adata->groups_hash, group);
+  mdata = nntp_mdata_get(adata, group);
   if (!mdata)
     return NULL;
 
@@ -1285,7 +1569,7 @@ struct NntpMboxData *mutt_newsgroup_catchup(struct Mailbox *m,
   if (!adata || !adata->groups_hash || !group || !*group)
     return NULL;
 
-  mdata = mutt_hash_find(adata->groups_hash, group);
+  mdata = nntp_mdata_get(adata, group);
   if (!mdata)
     return NULL;
 
@@ -1321,7 +1605,7 @@ struct NntpMboxData *mutt_newsgroup_uncatchup(struct Mailbox *m,
   if (!adata || !adata->groups_hash || !group || !*group)
     return NULL;
 
-  mdata = mutt_hash_find(adata->groups_hash, group);
+  mdata = nntp_mdata_get(adata, group);
   if (!mdata)
     return NULL;
 
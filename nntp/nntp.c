@@ -128,6 +128,7 @@ static void nntp_adata_free(void **ptr)
     return;
 
   struct NntpAccountData *adata = *ptr;
+  nntp_active_cache_free(adata);
   FREE(&adata->conn);
   FREE(ptr);
 }
@@ -1088,6 +1089,9 @@ static int fetch_numbers(char *line, void *data)
  * @param data FetchCtx
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The tab-separated fields are parsed straight into the Envelope, unless the
+ * article is already in the header cache.
  */
 static int parse_overview_line(char *line, void *data)
 {
@@ -1126,63 +1130,22 @@ static int parse_overview_line(char *line, void *data)
     return 0;
   }
 
-  /* convert overview line to header */
-  FILE *fp = mutt_file_mkstemp();
-  if (!fp)
-    return -1;
-
-  header = mdata->adata->overview_fmt;
-  while (field)
-  {
-    char *b = field;
-
-    if (*header)
-    {
-      if (!strstr(header, ":full") && (fputs(header, fp) == EOF))
-      {
-        mutt_file_fclose(&fp);
-        return -1;
-      }
-      header = strchr(header, '\0') + 1;
-    }
-
-    field = strchr(field, '\t');
-    if (field)
-      *field++ = '\0';
-    if ((fputs(b, fp) == EOF) || (fputc('\n', fp) == EOF))
-    {
-      mutt_file_fclose(&fp);
-      return -1;
-    }
-  }
-  rewind(fp);
-
   /* allocate memory for headers */
   if (m->msg_count >= m->email_max)
     mx_alloc_memory(m);
 
-  /* parse header */
-  m->emails[m->msg_count] = mutt_email_new();
-  e = m->emails[m->msg_count];
-  e->env = mutt_rfc822_read_header(fp, e, false, false);
-  e->env->newsgroups = mutt_str_strdup(mdata->group);
-  e->received = e->date_sent;
-  mutt_file_fclose(&fp);
-
 #ifdef USE_HCACHE
   if (fc->hc)
   {
     char buf[16];
 
-    /* try to replace with header from cache */
+    /* try the header cache before parsing the overview */
     snprintf(buf, sizeof(buf), "%u", anum);
     void *hdata = mutt_hcache_fetch(fc->hc, buf, strlen(buf));
     if (hdata)
     {
       mutt_debug(LL_DEBUG2, "mutt_hcache_fetch %s\n", buf);
-      mutt_email_free(&e);
       e = mutt_hcache_restore(hdata);
-      m->emails[m->msg_count] = e;
       mutt_hcache_free(fc->hc, &hdata);
       e->edata = NULL;
       e->read = false;
@@ -1199,18 +1162,62 @@ static int parse_overview_line(char *line, void *data)
         save = false;
       }
     }
+  }
+#endif
 
-    /* not cached yet, store header */
-    else
+  if (!e)
+  {
+    /* parse the overview fields in place */
+    e = mutt_email_new();
+    e->env = mutt_env_new();
+    header = mdata->adata->overview_fmt;
+    while (field && *header)
+    {
+      char name[128];
+      char *value = field;
+
+      field = strchr(field, '\t');
+      if (field)
+        *field++ = '\0';
+
+      /* a "full" field carries its own header name */
+      const char *colon = strchr(header, ':');
+      if (colon && (strcmp(colon + 1, "full") == 0))
+      {
+        char *sep = strchr(value, ':');
+        if (sep)
+        {
+          *sep = '\0';
+          mutt_rfc822_parse_field(e->env, e, value, sep + 1);
+        }
+      }
+      else if (colon)
+      {
+        mutt_str_strfcpy(name, header, MIN(sizeof(name), colon - header + 1));
+        mutt_rfc822_parse_field(e->env, e, name, value);
+      }
+      header = strchr(header, '\0') + 1;
+    }
+    mutt_rfc822_finish_header(e->env, e);
+    e->env->newsgroups = mutt_str_strdup(mdata->group);
+    e->received = e->date_sent;
+
+#ifdef USE_HCACHE
+    if (fc->hc)
     {
+      char buf[16];
+
+      /* not cached yet, store header */
+      snprintf(buf, sizeof(buf), "%u", anum);
       mutt_debug(LL_DEBUG2, "mutt_hcache_store %s\n", buf);
       mutt_hcache_store(fc->hc, buf, strlen(buf), e, 0);
     }
-  }
 #endif
+  }
 
   if (save)
   {
+    m->emails[m->msg_count] = e;
     e->index = m->msg_count++;
     e->read = false;
     e->old = false;
@@ -1488,21 +1495,17 @@ static int nntp_fetch_headers(struct Mailbox *m, void *hc, anum_t first, anum_t
 }
 
 /**
- * nntp_group_poll - Check newsgroup for new articles
- * @param mdata NNTP Mailbox data
+ * group_poll_result - Update a newsgroup from the response to GROUP
+ * @param mdata       NNTP Mailbox data
+ * @param buf         Response to the GROUP command
  * @param update_stat Update the stats?
- * @retval  1 New articles found
- * @retval  0 No change
- * @retval -1 Lost connection
+ * @retval 1 New articles found
+ * @retval 0 No change
  */
-static int nntp_group_poll(struct NntpMboxData *mdata, bool update_stat)
+static int group_poll_result(struct NntpMboxData *mdata, const char *buf, bool update_stat)
 {
-  char buf[1024] = "";
   anum_t count, first, last;
 
-  /* use GROUP command to poll newsgroup */
-  if (nntp_query(mdata, buf, sizeof(buf)) < 0)
-    return -1;
   if (sscanf(buf, "211 " ANUM " " ANUM " " ANUM, &count, &first, &last) != 3)
     return 0;
   if ((first == mdata->first_message) && (last == mdata->last_message))
@@ -1533,6 +1536,99 @@ static int nntp_group_poll(struct NntpMboxData *mdata, bool update_stat)
   return 1;
 }
 
+/**
+ * nntp_group_poll - Check newsgroup for new articles
+ * @param mdata NNTP Mailbox data
+ * @param update_stat Update the stats?
+ * @retval  1 New articles found
+ * @retval  0 No change
+ * @retval -1 Lost connection
+ */
+static int nntp_group_poll(struct NntpMboxData *mdata, bool update_stat)
+{
+  char buf[1024] = "";
+
+  /* use GROUP command to poll newsgroup */
+  if (nntp_query(mdata, buf, sizeof(buf)) < 0)
+    return -1;
+
+  return group_poll_result(mdata, buf, update_stat);
+}
+
+/**
+ * groups_poll - Check the subscribed newsgroups for new articles
+ * @param adata NNTP Account data
+ * @retval  1 New articles found
+ * @retval  0 No change
+ * @retval -1 Lost connection
+ *
+ * An RFC3977 server accepts pipelined commands (section 3.5), so up to
+ * #NNTP_PIPELINE_DEPTH GROUP commands are sent before their responses are
+ * read.  If the connection fails, the newsgroups that haven't been answered
+ * are polled one at a time, which reconnects.
+ */
+static int groups_poll(struct NntpAccountData *adata)
+{
+  unsigned int sent[NNTP_PIPELINE_DEPTH];
+  unsigned int head = 0;
+  unsigned int count = 0;
+  unsigned int i = 0;
+  char buf[1024];
+  int rc = 0;
+
+  if (adata->hasCAPABILITIES && (adata->status == NNTP_OK))
+  {
+    while (true)
+    {
+      for (; (i < adata->groups_num) && (count < NNTP_PIPELINE_DEPTH); i++)
+      {
+        struct NntpMboxData *mdata = adata->groups_list[i];
+        if (!mdata || !mdata->subscribed)
+          continue;
+
+        snprintf(buf, sizeof(buf), "GROUP %s\r\n", mdata->group);
+        if (mutt_socket_send(adata->conn, buf) < 0)
+          break;
+        sent[(head + count++) % NNTP_PIPELINE_DEPTH] = i;
+      }
+
+      if ((i < adata->groups_num) && (count < NNTP_PIPELINE_DEPTH))
+        break; /* send failed */
+      if (count == 0)
+        return rc;
+
+      if (mutt_socket_readln(buf, sizeof(buf), adata->conn) < 0)
+        break;
+
+      if (group_poll_result(adata->groups_list[sent[head]], buf, true) > 0)
+        rc = 1;
+      head = (head + 1) % NNTP_PIPELINE_DEPTH;
+      count--;
+    }
+
+    /* the connection is out of step, make nntp_query() reconnect */
+    mutt_debug(LL_DEBUG1, "GROUP pipeline failed, polling the rest one at a time\n");
+    adata->status = NNTP_NONE;
+    if (count > 0)
+      i = sent[head];
+  }
+
+  for (; i < adata->groups_num; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+    if (!mdata || !mdata->subscribed)
+      continue;
+
+    const int rc2 = nntp_group_poll(mdata, true);
+    if (rc2 < 0)
+      return -1;
+    if (rc2 > 0)
+      rc = 1;
+  }
+
+  return rc;
+}
+
 /**
  * check_mailbox - Check current newsgroup for new articles
  * @param m Mailbox
@@ -2073,6 +2169,9 @@ int nntp_active_fetch(struct NntpAccountData *adata, bool new)
   if (nntp_date(adata, &adata->newgroups_time) < 0)
     return -1;
 
+  /* the server's list replaces the cached one */
+  nntp_active_cache_free(adata);
+
   tmp_mdata.adata = adata;
   tmp_mdata.group = NULL;
   i = adata->groups_num;
@@ -2142,19 +2241,11 @@ int nntp_check_new_groups(struct Mailbox *m, struct NntpAccountData *adata)
   if (C_ShowNewNews)
   {
     mutt_message(_("Checking for new messages..."));
-    for (i = 0; i < adata->groups_num; i++)
-    {
-      struct NntpMboxData *mdata = adata->groups_list[i];
-
-      if (mdata && mdata->subscribed)
-      {
-        rc = nntp_group_poll(mdata, true);
-        if (rc < 0)
-          return -1;
-        if (rc > 0)
-          update_active = true;
-      }
-    }
+    rc = groups_poll(adata);
+    if (rc < 0)
+      return -1;
+    if (rc > 0)
+      update_active = true;
     /* select current newsgroup */
     if (Context && (Context->mailbox->magic == MUTT_NNTP))
     {
@@ -2486,7 +2577,7 @@ static int nntp_mbox_open(struct Mailbox *m)
     group++;
 
   /* find news group data structure */
-  struct NntpMboxData *mdata = mutt_hash_find(adata->groups_hash, group);
+  struct NntpMboxData *mdata = nntp_mdata_get(adata, group);
   if (!mdata)
   {
     nntp_newsrc_close(adata);
@@ -2824,6 +2915,9 @@ static int nntp_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
   if (WithCrypto)
     e->security = crypt_query(e->content);
 
+  /* the email now has its real headers and length */
+  mutt_email_touch(e);
+
   rewind(msg->fp);
   mutt_clear_error();
   return 0;
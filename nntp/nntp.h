@@ -100,6 +100,8 @@ struct NntpAccountData
   unsigned int groups_max;
   void **groups_list;
   struct Hash *groups_hash;
+  void *active_map;  ///< Cached list of newsgroups, see active_get_cache()
+  size_t active_len; ///< Size of active_map
   struct Connection *conn;
 };
 
@@ -161,6 +163,7 @@ struct NntpMboxData *mutt_newsgroup_subscribe(struct NntpAccountData *adata, cha
 struct NntpMboxData *mutt_newsgroup_unsubscribe(struct NntpAccountData *adata, char *group);
 struct NntpMboxData *mutt_newsgroup_catchup(struct Mailbox *m, struct NntpAccountData *adata, char *group);
 struct NntpMboxData *mutt_newsgroup_uncatchup(struct Mailbox *m, struct NntpAccountData *adata, char *group);
+void nntp_active_expand(struct NntpAccountData *adata);
 int nntp_active_fetch(struct NntpAccountData *adata, bool new);
 int nntp_newsrc_update(struct NntpAccountData *adata);
 int nntp_post(struct Mailbox *m, const char *msg);
@@ -37,6 +37,9 @@ struct Mailbox;
 #define NNTP_PORT 119
 #define NNTP_SSL_PORT 563
 
+/* Maximal number of GROUP commands sent ahead of their responses */
+#define NNTP_PIPELINE_DEPTH 32
+
 /**
  * enum NntpStatus - NNTP server return values
  */
@@ -48,6 +51,7 @@ enum NntpStatus
 };
 
 void nntp_acache_free(struct NntpMboxData *mdata);
+void nntp_active_cache_free(struct NntpAccountData *adata);
 int  nntp_active_save_cache(struct NntpAccountData *adata);
 struct NntpAccountData *nntp_adata_new(struct Connection *conn);
 int  nntp_add_group(char *line, void *data);
@@ -58,6 +62,7 @@ struct NntpEmailData *nntp_edata_get(struct Email *e);
 void nntp_group_unread_stat(struct NntpMboxData *mdata);
 void nntp_hash_destructor_t(int type, void *obj, intptr_t data);
 void nntp_mdata_free(void **ptr);
+struct NntpMboxData *nntp_mdata_get(struct NntpAccountData *adata, const char *group);
 void nntp_newsrc_gen_entries(struct Mailbox *m);
 int  nntp_open_connection(struct NntpAccountData *adata);
 void nntp_article_status(struct Mailbox *m, struct Email *e, char *group, anum_t anum);
@@ -65,6 +65,7 @@
 #include "maildir/lib.h"
 #include "mutt_thread.h"
 #include "mx.h"
+#include "pattern.h"
 #include "progress.h"
 #include "protos.h"
 
@@ -633,6 +634,7 @@ static int update_email_tags(struct Email *e, notmuch_message_t *msg)
 
   /* new version */
   driver_tags_replace(&e->tags, new_tags);
+  mutt_email_touch(e);
   FREE(&new_tags);
 
   new_tags = driver_tags_get_transformed(&e->tags);
@@ -1820,6 +1822,216 @@ bool nm_message_is_still_queried(struct Mailbox *m, struct Email *e)
   return rc;
 }
 
+/**
+ * enum NmPatternQuery - How well a Notmuch query matches a Pattern
+ */
+enum NmPatternQuery
+{
+  NM_PQ_NONE,   ///< No query, every message may match
+  NM_PQ_SUPER,  ///< The query finds every match, and maybe some others
+  NM_PQ_EXACT,  ///< The query finds exactly the matches
+};
+
+/**
+ * query_add_literal - Add a regex term for some required text to a query
+ * @param buf   Buffer for the query
+ * @param field Notmuch field, e.g. "from"
+ * @param str   Text that every match contains
+ * @param icase True if the match ignores case
+ * @retval true The term was added
+ *
+ * Notmuch's regex terms are case-sensitive, so letters are turned into
+ * bracket expressions, e.g. "[aA]", if case is to be ignored.
+ */
+static bool query_add_literal(struct Buffer *buf, const char *field, const char *str, bool icase)
+{
+  if (!str || !*str)
+    return false;
+
+  for (const char *p = str; *p; p++)
+  {
+    if (strchr("\"/\\]^", *p) || ((unsigned char) *p < 32))
+      return false;
+  }
+
+  mutt_buffer_add_printf(buf, "%s:\"/", field);
+  for (const unsigned char *p = (const unsigned char *) str; *p; p++)
+  {
+    if (icase && (*p < 128) && isalpha(*p))
+      mutt_buffer_add_printf(buf, "[%c%c]", tolower(*p), toupper(*p));
+    else if ((*p >= 128) || isalnum(*p) || (*p == ' '))
+      mutt_buffer_addch(buf, *p);
+    else
+      mutt_buffer_add_printf(buf, "[%c]", *p);
+  }
+  mutt_buffer_addstr(buf, "/\"");
+  return true;
+}
+
+/**
+ * pattern_to_query - Translate a Pattern into a Notmuch query
+ * @param pat Pattern
+ * @param buf Buffer for the query
+ * @retval enum #NmPatternQuery
+ *
+ * Terms that Notmuch can't check are left out.  An AND is narrowed by the
+ * terms that can be translated; an OR needs all of them.  Only an exact
+ * query can be negated.
+ */
+static enum NmPatternQuery pattern_to_query(const struct Pattern *pat, struct Buffer *buf)
+{
+  enum NmPatternQuery rc = NM_PQ_NONE;
+
+  switch (pat->op)
+  {
+    case MUTT_PAT_AND:
+    case MUTT_PAT_OR:
+    {
+      const bool is_and = (pat->op == MUTT_PAT_AND);
+      struct Buffer *term = mutt_buffer_pool_get();
+      int terms = 0;
+      rc = NM_PQ_EXACT;
+      for (const struct Pattern *p = pat->child; p; p = p->next)
+      {
+        mutt_buffer_reset(term);
+        enum NmPatternQuery crc = pattern_to_query(p, term);
+        if (crc == NM_PQ_NONE)
+        {
+          rc = is_and ? NM_PQ_SUPER : NM_PQ_NONE;
+          if (!is_and)
+            break;
+          continue;
+        }
+        if (crc == NM_PQ_SUPER)
+          rc = NM_PQ_SUPER;
+        mutt_buffer_add_printf(buf, "%s(%s)", (terms++ == 0) ? "" : (is_and ? " and " : " or "),
+                               mutt_b2s(term));
+      }
+      mutt_buffer_pool_release(&term);
+      if (terms == 0)
+        rc = NM_PQ_NONE;
+      break;
+    }
+    case MUTT_ALL:
+      mutt_buffer_addstr(buf, "*");
+      rc = NM_PQ_EXACT;
+      break;
+    /* MUTT_PAT_DATE isn't translated: Notmuch's idea of the date can differ
+     * from NeoMutt's, e.g. for a missing or broken Date header, so a "date:"
+     * query could drop matches. */
+#if LIBNOTMUCH_CHECK_VERSION(5, 0, 0)
+    case MUTT_PAT_FROM:
+    case MUTT_PAT_SUBJECT:
+    {
+      /* regex searches need Notmuch 0.24 */
+      const char *field = (pat->op == MUTT_PAT_FROM) ? "from" : "subject";
+      bool added;
+      if (pat->stringmatch)
+        added = query_add_literal(buf, field, pat->p.str, pat->ign_case);
+      else
+        added = query_add_literal(buf, field, pat->literal.str, pat->literal.icase);
+      rc = added ? NM_PQ_SUPER : NM_PQ_NONE;
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+
+  if (pat->not && (rc != NM_PQ_NONE))
+  {
+    if (rc != NM_PQ_EXACT)
+      rc = NM_PQ_NONE;
+    else
+    {
+      struct Buffer *term = mutt_buffer_pool_get();
+      mutt_buffer_printf(term, "not (%s)", mutt_b2s(buf));
+      mutt_buffer_strcpy(buf, mutt_b2s(term));
+      mutt_buffer_pool_release(&term);
+    }
+  }
+
+  if (rc == NM_PQ_NONE)
+    mutt_buffer_reset(buf);
+  return rc;
+}
+
+/**
+ * nm_search - Ask Notmuch which messages can match a Pattern
+ * @param[in]  m    Mailbox
+ * @param[in]  pat  Pattern
+ * @param[out] hits For each Email, by Email::msgno, whether it can match
+ * @retval num Number of Emails that can match
+ * @retval -1  Notmuch can't help, every Email must be matched locally
+ *
+ * The Pattern is translated into a Notmuch query, e.g. "~f alice ~d <1m"
+ * becomes `from:"/[aA][lL][iI][cC][eE]/" and date:@...`.  The query is run
+ * against the mailbox's own query, so only the messages that could match are
+ * checked by NeoMutt.
+ */
+int nm_search(struct Mailbox *m, const struct Pattern *pat, bool *hits)
+{
+  struct NmMboxData *mdata = nm_mdata_get(m);
+  if (!mdata || !pat || !hits || (m->msg_count == 0))
+    return -1;
+
+  /* a thread query also holds messages that don't match it */
+  char *orig_str = get_query_string(mdata, true);
+  if (!orig_str || (mdata->query_type != NM_QUERY_TYPE_MESGS))
+    return -1;
+
+  struct Buffer *narrow = mutt_buffer_pool_get();
+  notmuch_database_t *db = NULL;
+  char *qstr = NULL;
+  int rc = -1;
+
+  if ((pattern_to_query(pat, narrow) == NM_PQ_NONE) ||
+      (safe_asprintf(&qstr, "(%s) and (%s)", orig_str, mutt_b2s(narrow)) < 0))
+  {
+    goto done;
+  }
+
+  db = nm_db_get(m, false);
+  if (!db)
+    goto done;
+
+  mutt_debug(LL_DEBUG1, "nm: search '%s'\n", qstr);
+  notmuch_query_t *q = notmuch_query_create(db, qstr);
+  notmuch_messages_t *msgs = get_messages(q);
+  if (msgs)
+  {
+    struct Hash *ids = mutt_hash_new(1024, MUTT_HASH_STRDUP_KEYS);
+    for (; notmuch_messages_valid(msgs); notmuch_messages_move_to_next(msgs))
+    {
+      notmuch_message_t *msg = notmuch_messages_get(msgs);
+      const char *id = notmuch_message_get_message_id(msg);
+      if (id)
+        mutt_hash_insert(ids, id, ids);
+      notmuch_message_destroy(msg);
+    }
+    notmuch_messages_destroy(msgs);
+
+    rc = 0;
+    for (int i = 0; i < m->msg_count; i++)
+    {
+      const char *id = email_get_id(m->emails[i]);
+      hits[i] = !id || mutt_hash_find(ids, id);
+      if (hits[i])
+        rc++;
+    }
+    mutt_hash_free(&ids);
+    mutt_debug(LL_DEBUG1, "nm: search found %d of %d messages\n", rc, m->msg_count);
+  }
+  if (q)
+    notmuch_query_destroy(q);
+  nm_db_release(m);
+
+done:
+  FREE(&qstr);
+  mutt_buffer_pool_release(&narrow);
+  return rc;
+}
+
 /**
  * nm_update_filename - Change the filename
  * @param m   Mailbox
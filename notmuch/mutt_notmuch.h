@@ -41,6 +41,7 @@
 struct Email;
 struct Mailbox;
 struct NmMboxData;
+struct Pattern;
 struct stat;
 
 /* These Config Variables are only used in notmuch/mutt_notmuch.c */
@@ -71,6 +72,7 @@ void  nm_query_window_backward   (void);
 void  nm_query_window_forward    (void);
 int   nm_read_entire_thread      (struct Mailbox *m, struct Email *e);
 int   nm_record_message          (struct Mailbox *m, char *path, struct Email *e);
+int   nm_search                  (struct Mailbox *m, const struct Pattern *pat, bool *hits);
 int   nm_update_filename         (struct Mailbox *m, const char *old, const char *new, struct Email *e);
 char *nm_uri_from_query          (struct Mailbox *m, char *buf, size_t buflen);
 
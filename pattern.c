@@ -37,6 +37,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "mutt/mutt.h"
 #include "config/lib.h"
 #include "email/lib.h"
@@ -44,6 +48,7 @@
 #include "mutt.h"
 #include "pattern.h"
 #include "alias.h"
+#include "bodyindex.h"
 #include "context.h"
 #include "copy.h"
 #include "curs_lib.h"
@@ -66,6 +71,9 @@
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
+#ifdef USE_NOTMUCH
+#include "notmuch/mutt_notmuch.h"
+#endif
 
 /* These Config Variables are only used in pattern.c */
 bool C_ThoroughSearch; ///< Config: Decode headers and messages before searching them
@@ -241,6 +249,7 @@ static bool eat_regex(struct Pattern *pat, struct Buffer *s, struct Buffer *err)
       FREE(&pat->p.regex);
       return false;
     }
+    mutt_regex_literal(buf.data, flags, &pat->literal);
     FREE(&buf.data);
   }
 
@@ -1068,19 +1077,147 @@ static int patmatch(const struct Pattern *pat, const char *buf)
     return pat->ign_case ? !strcasestr(buf, pat->p.str) : !strstr(buf, pat->p.str);
   else if (pat->groupmatch)
     return !mutt_group_match(pat->p.group, buf);
-  else
-    return regexec(pat->p.regex, buf, 0, NULL, 0);
+
+  /* look for the text the regex needs, before running it */
+  if (!mutt_regex_literal_find(&pat->literal, buf))
+    return 1;
+  if (pat->literal.whole)
+    return 0;
+  return regexec(pat->p.regex, buf, 0, NULL, 0);
 }
 
+#ifdef HAVE_FOPENCOOKIE
+#define SEARCH_LINE_MAX 8192 ///< Longest line matched by stream_search(), longer lines are split
+
 /**
- * msg_search - Search an email
+ * struct SearchSink - Match decoded text as it's written
+ */
+struct SearchSink
+{
+  const struct Pattern *pat;      ///< Pattern to match each line against
+  struct State *state;            ///< State whose input is abandoned after a match
+  char line[SEARCH_LINE_MAX + 1]; ///< Partial line
+  size_t len;                     ///< Length of the partial line
+  bool match;                     ///< A line has matched
+};
+
+/**
+ * sink_match_line - Match the buffered line
+ * @param sink SearchSink
+ *
+ * After a match, the input is moved to its end, so the handlers stop
+ * decoding.
+ */
+static void sink_match_line(struct SearchSink *sink)
+{
+  sink->line[sink->len] = '\0';
+  sink->len = 0;
+  if (patmatch(sink->pat, sink->line) == 0)
+  {
+    sink->match = true;
+    fseeko(sink->state->fp_in, 0, SEEK_END);
+  }
+}
+
+/**
+ * sink_write - Match text as it's written - Implements cookie_write_function_t
+ */
+static ssize_t sink_write(void *cookie, const char *buf, size_t size)
+{
+  struct SearchSink *sink = cookie;
+
+  if (sink->match)
+  {
+    /* a handler may have seeked back, e.g. to the next MIME part */
+    fseeko(sink->state->fp_in, 0, SEEK_END);
+    return size;
+  }
+
+  for (size_t i = 0; (i < size) && !sink->match; i++)
+  {
+    sink->line[sink->len++] = buf[i];
+    if ((buf[i] == '\n') || (sink->len == SEARCH_LINE_MAX))
+      sink_match_line(sink);
+  }
+  return size;
+}
+
+/**
+ * stream_search - Search a decoded email, without storing the decoded text
  * @param m   Mailbox
- * @param pat   Pattern to find
- * @param msgno Message to search
+ * @param pat Pattern to find
+ * @param e   Email
+ * @param msg Open Message
+ * @retval true Pattern found
+ * @retval false Error or pattern not found
+ *
+ * The handlers write into a stream that matches each line as it's completed,
+ * so memory use is bounded, and decoding stops at the first match.
+ */
+static bool stream_search(struct Mailbox *m, struct Pattern *pat,
+                          struct Email *e, struct Message *msg)
+{
+  struct State s = { 0 };
+  s.fp_in = msg->fp;
+  s.flags = MUTT_CHARCONV;
+
+  struct SearchSink *sink = mutt_mem_calloc(1, sizeof(struct SearchSink));
+  sink->pat = pat;
+  sink->state = &s;
+
+  cookie_io_functions_t io = { .write = sink_write };
+  s.fp_out = fopencookie(sink, "w", io);
+  if (!s.fp_out)
+  {
+    mutt_perror(_("Error opening 'memory stream'"));
+    FREE(&sink);
+    return false;
+  }
+
+  if (pat->op != MUTT_PAT_BODY)
+    mutt_copy_header(msg->fp, e, s.fp_out, CH_FROM | CH_DECODE, NULL);
+
+  fflush(s.fp_out);
+  if (!sink->match)
+  {
+    mutt_parse_mime_message(m, e);
+
+    if ((WithCrypto != 0) && (e->security & SEC_ENCRYPT) &&
+        !crypt_valid_passphrase(e->security))
+    {
+      mutt_file_fclose(&s.fp_out);
+      FREE(&sink);
+      return false;
+    }
+
+    fseeko(msg->fp, e->offset, SEEK_SET);
+    mutt_body_handler(e->content, &s);
+  }
+
+  mutt_file_fclose(&s.fp_out);
+  if (!sink->match && (sink->len > 0))
+    sink_match_line(sink);
+
+  bool match = sink->match;
+  FREE(&sink);
+  return match;
+}
+#endif
+
+/**
+ * msg_search - Search an email
+ * @param m         Mailbox
+ * @param pat       Pattern to find
+ * @param msgno     Message to search
+ * @param index_key Body index key, if the email should be indexed
  * @retval true Pattern found
  * @retval false Error or pattern not found
+ *
+ * To index an email, the whole message is read, whatever the Pattern, then the
+ * search is limited to the part it wants.
  */
-static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
+static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno,
+                       const char *index_key)
 {
   bool match = false;
   struct Message *msg = mx_msg_open(m, msgno);
@@ -1091,7 +1228,10 @@ static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
 
   FILE *fp = NULL;
   long lng = 0;
+  LOFF_T start = 0;
+  long hdr_len = 0;
   struct Email *e = m->emails[msgno];
+  const int op = index_key ? MUTT_PAT_WHOLE_MSG : pat->op;
 #ifdef USE_FMEMOPEN
   char *temp = NULL;
   size_t tempsize;
@@ -1099,6 +1239,16 @@ static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
   struct stat st;
 #endif
 
+#ifdef HAVE_FOPENCOOKIE
+  /* the index needs all the text, and header searches unfold lines */
+  if (C_ThoroughSearch && !index_key && (pat->op != MUTT_PAT_HEADER))
+  {
+    match = stream_search(m, pat, e, msg);
+    mx_msg_close(m, &msg);
+    return match;
+  }
+#endif
+
   if (C_ThoroughSearch)
   {
     /* decode the header / body */
@@ -1121,10 +1271,13 @@ static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
     }
 #endif
 
-    if (pat->op != MUTT_PAT_BODY)
+    if (op != MUTT_PAT_BODY)
+    {
       mutt_copy_header(msg->fp, e, s.fp_out, CH_FROM | CH_DECODE, NULL);
+      hdr_len = ftello(s.fp_out);
+    }
 
-    if (pat->op != MUTT_PAT_HEADER)
+    if (op != MUTT_PAT_HEADER)
     {
       mutt_parse_mime_message(m, e);
 
@@ -1180,19 +1333,40 @@ static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
   {
     /* raw header / body */
     fp = msg->fp;
-    if (pat->op != MUTT_PAT_BODY)
+    start = e->offset;
+    hdr_len = e->content->offset - e->offset;
+    if (op != MUTT_PAT_BODY)
     {
       fseeko(fp, e->offset, SEEK_SET);
-      lng = e->content->offset - e->offset;
+      lng = hdr_len;
     }
-    if (pat->op != MUTT_PAT_HEADER)
+    if (op != MUTT_PAT_HEADER)
     {
-      if (pat->op == MUTT_PAT_BODY)
+      if (op == MUTT_PAT_BODY)
         fseeko(fp, e->content->offset, SEEK_SET);
       lng += e->content->length;
     }
   }
 
+#ifdef USE_HCACHE
+  if (index_key)
+  {
+    /* index the whole message, then narrow the search to what the Pattern
+     * wants.  Parsing the MIME structure may have found encryption, see
+     * body_search(). */
+    if (!((WithCrypto != 0) && (e->security & SEC_ENCRYPT)))
+      body_index_store(index_key, fp, start, hdr_len, lng);
+    if (pat->op == MUTT_PAT_BODY)
+    {
+      start += hdr_len;
+      lng -= hdr_len;
+    }
+    else if (pat->op == MUTT_PAT_HEADER)
+      lng = hdr_len;
+    fseeko(fp, start, SEEK_SET);
+  }
+#endif
+
   size_t blen = 256;
   char *buf = mutt_mem_malloc(blen);
 
@@ -1231,6 +1405,39 @@ static bool msg_search(struct Mailbox *m, struct Pattern *pat, int msgno)
   return match;
 }
 
+/**
+ * body_search - Search the text of an email, consulting the body index
+ * @param m   Mailbox
+ * @param pat Pattern to find
+ * @param e   Email to search
+ * @retval true Pattern found
+ * @retval false Error or pattern not found
+ *
+ * If the Pattern is plain text, and the body index says the email can't
+ * contain it, the email isn't opened at all.
+ */
+static bool body_search(struct Mailbox *m, struct Pattern *pat, struct Email *e)
+{
+#ifdef USE_HCACHE
+  const char *text = pat->stringmatch ? pat->p.str : pat->literal.str;
+  /* never keep a trace of decrypted text on disk */
+  if (!C_BodyIndex || !text || ((WithCrypto != 0) && (e->security & SEC_ENCRYPT)))
+    return msg_search(m, pat, e->msgno, NULL);
+
+  bool match = false;
+  struct Buffer *key = mutt_buffer_pool_get();
+  body_index_hold();
+  enum BodyIndexResult rc = body_index_check(e, text, key);
+  if (rc != BIDX_NO)
+    match = msg_search(m, pat, e->msgno, (rc == BIDX_MISSING) ? mutt_b2s(key) : NULL);
+  body_index_release();
+  mutt_buffer_pool_release(&key);
+  return match;
+#else
+  return msg_search(m, pat, e->msgno, NULL);
+#endif
+}
+
 // clang-format off
 /**
  * Flags - Lookup table for all patterns
@@ -1327,6 +1534,335 @@ static /* const */ char *find_matching_paren(/* const */ char *s)
   return s;
 }
 
+#define PROG_ACCEPT -1 ///< PatternProgram jump target: the Email matches
+#define PROG_REJECT -2 ///< PatternProgram jump target: the Email doesn't match
+
+/**
+ * struct PatternInsn - One step of a PatternProgram
+ */
+struct PatternInsn
+{
+  struct Pattern *pat; ///< Simple Pattern to match
+  int on_true;         ///< Next step if it matches, or #PROG_ACCEPT, #PROG_REJECT
+  int on_false;        ///< Next step if it doesn't match
+};
+
+/**
+ * struct PatternProgram - A tree of ANDs and ORs flattened into jumps
+ *
+ * Every step matches one simple Pattern and jumps on the result, so matching
+ * an Email is a loop rather than a recursion through perform_and() and
+ * perform_or().  The operands of each AND and OR are ordered by cost, so the
+ * cheap tests can rule out an Email before the expensive ones are tried.
+ */
+struct PatternProgram
+{
+  struct PatternInsn *insns; ///< Steps
+  int num;                   ///< Number of steps
+  int max;                   ///< Number of steps allocated
+  int entry;                 ///< First step
+};
+
+#define PATTERN_MEMO_MAX 128 ///< Patterns remembered per Mailbox, before starting afresh
+
+/**
+ * struct PatternMemoEntry - A remembered result of a Pattern
+ */
+struct PatternMemoEntry
+{
+  unsigned int gen;   ///< Email::gen of the Email, 0 if unused
+  unsigned int state; ///< email_state() of the Email
+  int result;         ///< Result of the Pattern
+};
+
+/**
+ * struct PatternMemo - Remembered results of a Pattern, for one Mailbox
+ */
+struct PatternMemo
+{
+  struct PatternMemoEntry *entries; ///< Results, indexed by Email::index
+  int num;                          ///< Number of entries
+};
+
+/**
+ * struct PatternMemos - Remembered Pattern results of a Mailbox
+ */
+struct PatternMemos
+{
+  struct Hash *hash; ///< PatternMemo by Pattern::memo_id and match flags
+  int count;         ///< Number of PatternMemo in the Hash
+};
+
+#define PATTERN_RANGE_MIN 500 ///< Fewer Emails than this are matched without the range indexes
+
+/**
+ * enum PatternRangeKey - Email fields with a sorted index
+ */
+enum PatternRangeKey
+{
+  RANGE_DATE_SENT, ///< Email::date_sent, for ~d
+  RANGE_RECEIVED,  ///< Email::received, for ~r
+  RANGE_SIZE,      ///< Length of the Email's content, for ~z
+  RANGE_MAX,
+};
+
+/**
+ * struct PatternRanges - Sorted indexes of a Mailbox's Emails
+ *
+ * The indexes are built when a range pattern first needs them.  They're
+ * thrown away when any Email is added, removed or given a new generation.
+ */
+struct PatternRanges
+{
+  unsigned int *gens;                         ///< Email::gen when built, by Email::index
+  int num_gens;                               ///< Number of entries in gens
+  int count;                                  ///< Number of Emails when built
+  struct EmailRangeEntry *index[RANGE_MAX]; ///< Sorted indexes, NULL until needed
+};
+
+/**
+ * pattern_memoizable - Can the results of a Pattern be remembered?
+ * @param pat Pattern
+ * @retval true The result only depends on the Email's headers, tags and flags
+ */
+static bool pattern_memoizable(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    switch (pat->op)
+    {
+      /* depend on other Emails, or the view */
+      case MUTT_PAT_THREAD:
+      case MUTT_PAT_PARENT:
+      case MUTT_PAT_CHILDREN:
+      case MUTT_PAT_COLLAPSED:
+      case MUTT_PAT_DUPLICATED:
+      case MUTT_PAT_UNREFERENCED:
+      case MUTT_PAT_BROKEN:
+      case MUTT_PAT_MESSAGE:
+      case MUTT_PAT_SCORE:
+      /* depend on config, or something outside the Email */
+      case MUTT_PAT_LIST:
+      case MUTT_PAT_SUBSCRIBED_LIST:
+      case MUTT_PAT_PERSONAL_RECIP:
+      case MUTT_PAT_PERSONAL_FROM:
+      case MUTT_PAT_ID_EXTERNAL:
+      case MUTT_PAT_SERVERSEARCH:
+        return false;
+      case MUTT_PAT_BODY:
+      case MUTT_PAT_HEADER:
+      case MUTT_PAT_WHOLE_MSG:
+        /* IMAP answers these with Email::matched */
+        if (pat->stringmatch)
+          return false;
+        break;
+    }
+
+    if (pat->isalias || pat->groupmatch)
+      return false;
+    if (pat->child && !pattern_memoizable(pat->child))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * pattern_cost - Estimate how expensive a Pattern is to match
+ * @param pat Pattern
+ * @retval num Relative cost
+ */
+static int pattern_cost(const struct Pattern *pat)
+{
+  int cost = 0;
+
+  if (pat->server_exact)
+    return 1;
+
+  switch (pat->op)
+  {
+    case MUTT_PAT_AND:
+    case MUTT_PAT_OR:
+      for (const struct Pattern *p = pat->child; p; p = p->next)
+        cost += pattern_cost(p);
+      return MIN(cost, 1000000);
+
+    case MUTT_PAT_BODY:
+    case MUTT_PAT_HEADER:
+    case MUTT_PAT_WHOLE_MSG:
+      return 1000;
+
+    case MUTT_PAT_MIMEATTACH:
+    case MUTT_PAT_MIMETYPE:
+      return 500;
+
+    case MUTT_PAT_THREAD:
+      return MIN(100 * pattern_cost(pat->child), 1000000);
+
+    case MUTT_PAT_PARENT:
+    case MUTT_PAT_CHILDREN:
+      return MIN(10 * pattern_cost(pat->child), 1000000);
+
+    case MUTT_PAT_ADDRESS:
+    case MUTT_PAT_CC:
+    case MUTT_PAT_DRIVER_TAGS:
+    case MUTT_PAT_FROM:
+    case MUTT_PAT_HORMEL:
+    case MUTT_PAT_ID:
+    case MUTT_PAT_ID_EXTERNAL:
+    case MUTT_PAT_NEWSGROUPS:
+    case MUTT_PAT_RECIPIENT:
+    case MUTT_PAT_REFERENCE:
+    case MUTT_PAT_SENDER:
+    case MUTT_PAT_SUBJECT:
+    case MUTT_PAT_TO:
+    case MUTT_PAT_XLABEL:
+      return pat->stringmatch ? 5 : 10;
+
+    case MUTT_PAT_LIST:
+    case MUTT_PAT_PERSONAL_FROM:
+    case MUTT_PAT_PERSONAL_RECIP:
+    case MUTT_PAT_SUBSCRIBED_LIST:
+      return 5;
+
+    default:
+      /* flags, dates, numbers and the shape of the thread */
+      return 1;
+  }
+}
+
+/**
+ * prog_emit - Flatten a Pattern into a PatternProgram
+ * @param prog     Program to add to
+ * @param pat      Pattern to flatten
+ * @param on_true  Where to go if the Pattern matches
+ * @param on_false Where to go if it doesn't
+ * @retval num First step of the Pattern (or a jump target)
+ *
+ * The operands are emitted last first, so each one knows where its
+ * successor starts.
+ */
+static int prog_emit(struct PatternProgram *prog, struct Pattern *pat, int on_true, int on_false)
+{
+  if (((pat->op != MUTT_PAT_AND) && (pat->op != MUTT_PAT_OR)) || pat->server_exact)
+  {
+    if (prog->num >= prog->max)
+    {
+      prog->max = MAX(2 * prog->max, 8);
+      mutt_mem_realloc(&prog->insns, prog->max * sizeof(struct PatternInsn));
+    }
+    struct PatternInsn *insn = &prog->insns[prog->num];
+    insn->pat = pat;
+    insn->on_true = on_true;
+    insn->on_false = on_false;
+    return prog->num++;
+  }
+
+  if (pat->not)
+  {
+    const int tmp = on_true;
+    on_true = on_false;
+    on_false = tmp;
+  }
+
+  int num = 0;
+  for (struct Pattern *p = pat->child; p; p = p->next)
+    num++;
+  if (num == 0)
+    return (pat->op == MUTT_PAT_AND) ? on_true : on_false;
+
+  /* stable insertion sort of the operands by cost */
+  struct Pattern **ops = mutt_mem_calloc(num, sizeof(struct Pattern *));
+  int *costs = mutt_mem_calloc(num, sizeof(int));
+  int i = 0;
+  for (struct Pattern *p = pat->child; p; p = p->next, i++)
+  {
+    const int cost = pattern_cost(p);
+    int j = i;
+    for (; (j > 0) && (costs[j - 1] > cost); j--)
+    {
+      ops[j] = ops[j - 1];
+      costs[j] = costs[j - 1];
+    }
+    ops[j] = p;
+    costs[j] = cost;
+  }
+
+  int next = (pat->op == MUTT_PAT_AND) ? on_true : on_false;
+  for (i = num - 1; i >= 0; i--)
+  {
+    if (pat->op == MUTT_PAT_AND)
+      next = prog_emit(prog, ops[i], next, on_false);
+    else
+      next = prog_emit(prog, ops[i], on_true, next);
+  }
+
+  FREE(&ops);
+  FREE(&costs);
+  return next;
+}
+
+/**
+ * prog_free - Free a PatternProgram
+ * @param ptr PatternProgram to free
+ */
+static void prog_free(struct PatternProgram **ptr)
+{
+  if (!ptr || !*ptr)
+    return;
+
+  FREE(&(*ptr)->insns);
+  FREE(ptr);
+}
+
+/**
+ * prog_exec - Match an Email against a PatternProgram
+ * @param prog  Program to run
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param m     Mailbox
+ * @param e     Email
+ * @param cache Cache for common Patterns
+ * @retval true The Email matches
+ */
+static bool prog_exec(const struct PatternProgram *prog, enum PatternExecFlag flags,
+                      struct Mailbox *m, struct Email *e, struct PatternCache *cache)
+{
+  int pc = prog->entry;
+
+  while (pc >= 0)
+  {
+    const struct PatternInsn *insn = &prog->insns[pc];
+    if (mutt_pattern_exec(insn->pat, flags, m, e, cache) > 0)
+      pc = insn->on_true;
+    else
+      pc = insn->on_false;
+  }
+
+  return pc == PROG_ACCEPT;
+}
+
+/**
+ * pattern_compile - Flatten the logical ops of a Pattern into PatternPrograms
+ * @param pat  Pattern list
+ * @param root True if the Patterns aren't operands of an AND or OR
+ *
+ * Only the outermost AND or OR gets a program; the ones nested inside it are
+ * part of it.  The operands of the thread ops are compiled separately.
+ */
+static void pattern_compile(struct Pattern *pat, bool root)
+{
+  for (; pat; pat = pat->next)
+  {
+    const bool logic = (pat->op == MUTT_PAT_AND) || (pat->op == MUTT_PAT_OR);
+    if (logic && root)
+    {
+      pat->prog = mutt_mem_calloc(1, sizeof(struct PatternProgram));
+      pat->prog->entry = prog_emit(pat->prog, pat, PROG_ACCEPT, PROG_REJECT);
+    }
+    if (pat->child)
+      pattern_compile(pat->child, !logic);
+  }
+}
+
 /**
  * mutt_pattern_free - Free a Pattern
  * @param[out] pat Pattern to free
@@ -1355,6 +1891,9 @@ void mutt_pattern_free(struct Pattern **pat)
       FREE(&tmp->p.regex);
     }
 
+    prog_free(&tmp->prog);
+    mutt_regex_literal_free(&tmp->literal);
+    mutt_hash_free(&tmp->server_hits);
     mutt_pattern_free(&tmp->child);
     FREE(&tmp);
   }
@@ -1370,13 +1909,13 @@ struct Pattern *mutt_pattern_new(void)
 }
 
 /**
- * mutt_pattern_comp - Create a Pattern
+ * pattern_comp - Parse a Pattern string into a tree
  * @param s     Pattern string
  * @param flags Flags, e.g. #MUTT_FULL_MSG
  * @param err   Buffer for error messages
  * @retval ptr Newly allocated Pattern
  */
-struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer *err)
+static struct Pattern *pattern_comp(/* const */ char *s, int flags, struct Buffer *err)
 {
   struct Pattern *curlist = NULL;
   struct Pattern *tmp = NULL, *tmp2 = NULL;
@@ -1483,7 +2022,7 @@ struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer
           isalias = false;
           /* compile the sub-expression */
           buf = mutt_str_substr_dup(ps.dptr + 1, p);
-          tmp2 = mutt_pattern_comp(buf, flags, err);
+          tmp2 = pattern_comp(buf, flags, err);
           if (!tmp2)
           {
             FREE(&buf);
@@ -1567,7 +2106,7 @@ struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer
         }
         /* compile the sub-expression */
         buf = mutt_str_substr_dup(ps.dptr + 1, p);
-        tmp = mutt_pattern_comp(buf, flags, err);
+        tmp = pattern_comp(buf, flags, err);
         if (!tmp)
         {
           FREE(&buf);
@@ -1610,11 +2149,36 @@ struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer
 }
 
 /**
- * perform_and - Perform a logical AND on a set of Patterns
- * @param pat   Patterns to test
- * @param flags Optional flags, e.g. #MUTT_MATCH_FULL_ADDRESS
- * @param m   Mailbox
- * @param e   Email
+ * mutt_pattern_comp - Create a Pattern
+ * @param s     Pattern string
+ * @param flags Flags, e.g. #MUTT_FULL_MSG
+ * @param err   Buffer for error messages
+ * @retval ptr Newly allocated Pattern
+ */
+struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer *err)
+{
+  static unsigned int memo_id = 0;
+
+  struct Pattern *pat = pattern_comp(s, flags, err);
+  if (pat)
+  {
+    pattern_compile(pat, true);
+    if (pattern_memoizable(pat))
+    {
+      if (++memo_id == 0)
+        memo_id++;
+      pat->memo_id = memo_id;
+    }
+  }
+  return pat;
+}
+
+/**
+ * perform_and - Perform a logical AND on a set of Patterns
+ * @param pat   Patterns to test
+ * @param flags Optional flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param m   Mailbox
+ * @param e   Email
  * @param cache Cached Patterns
  * @retval true If ALL of the Patterns evaluates to true
  */
@@ -1910,31 +2474,43 @@ static int is_pattern_cache_set(int cache_entry)
 }
 
 /**
- * mutt_pattern_exec - Match a pattern against an email header
+ * pattern_exec - Match a pattern against an email header
  * @param pat   Pattern to match
  * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
- * @param m   Mailbox
+ * @param m     Mailbox
  * @param e     Email
  * @param cache Cache for common Patterns
  * @retval  1 Success, pattern matched
  * @retval  0 Pattern did not match
  * @retval -1 Error
- *
- * flags: MUTT_MATCH_FULL_ADDRESS - match both personal and machine address
- * cache: For repeated matches against the same Header, passing in non-NULL will
- *        store some of the cacheable pattern matches in this structure.
  */
-int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
-                      struct Mailbox *m, struct Email *e, struct PatternCache *cache)
+static int pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
+                        struct Mailbox *m, struct Email *e, struct PatternCache *cache)
 {
   int result;
   int *cache_entry = NULL;
 
+#ifdef USE_IMAP
+  /* emails that changed since the server's search are matched locally */
+  if (pat->server_hits && (e->gen != 0) && (e->gen <= pat->server_gen))
+  {
+    if (!mutt_hash_int_find(pat->server_hits, e->gen))
+      return 0;
+    flags |= MUTT_MATCH_SERVER_HIT;
+  }
+  if (pat->server_exact && (flags & MUTT_MATCH_SERVER_HIT))
+    return 1;
+#endif
+
   switch (pat->op)
   {
     case MUTT_PAT_AND:
+      if (pat->prog)
+        return prog_exec(pat->prog, flags, m, e, cache);
       return pat->not^(perform_and(pat->child, flags, m, e, cache) > 0);
     case MUTT_PAT_OR:
+      if (pat->prog)
+        return prog_exec(pat->prog, flags, m, e, cache);
       return pat->not^(perform_or(pat->child, flags, m, e, cache) > 0);
     case MUTT_PAT_THREAD:
       return pat->not^match_threadcomplete(pat->child, flags, m, e->thread, 1, 1, 1, 1);
@@ -1984,7 +2560,7 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
       if ((m->magic == MUTT_IMAP) && pat->stringmatch)
         return e->matched;
 #endif
-      return pat->not^msg_search(m, pat, e->msgno);
+      return pat->not^body_search(m, pat, e);
     case MUTT_PAT_SERVERSEARCH:
 #ifdef USE_IMAP
       if (!m)
@@ -2177,6 +2753,155 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
   return -1;
 }
 
+/**
+ * email_state - Summarise the flags of an Email
+ * @param e Email
+ * @retval num Flags that a Pattern can test
+ *
+ * Flags are changed in too many places to bump Email::gen, so they're
+ * compared directly.
+ */
+static unsigned int email_state(const struct Email *e)
+{
+  return (e->read << 0) | (e->old << 1) | (e->flagged << 2) | (e->tagged << 3) |
+         (e->deleted << 4) | (e->replied << 5) | (e->expired << 6) |
+         (e->superseded << 7) | (e->purge << 8) | (e->trash << 9) |
+         (e->changed << 10) | (C_ThoroughSearch << 11) |
+         ((unsigned int) e->security << 16);
+}
+
+/**
+ * memo_free - Free a PatternMemo - Implements ::hashelem_free_t
+ */
+static void memo_free(int type, void *obj, intptr_t data)
+{
+  struct PatternMemo *memo = obj;
+  FREE(&memo->entries);
+  FREE(&memo);
+}
+
+/**
+ * mutt_pattern_memo_free - Forget the remembered Pattern results of a Mailbox
+ * @param ptr Remembered results to free
+ */
+void mutt_pattern_memo_free(struct PatternMemos **ptr)
+{
+  if (!ptr || !*ptr)
+    return;
+
+  mutt_hash_free(&(*ptr)->hash);
+  FREE(ptr);
+}
+
+/**
+ * pattern_memo_get - Get the remembered results of a Pattern
+ * @param m     Mailbox
+ * @param pat   Pattern
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @retval ptr  Remembered results, with room for every Email in the Mailbox
+ * @retval NULL The results of the Pattern can't be remembered
+ *
+ * This must be called from the main thread.
+ */
+static struct PatternMemo *pattern_memo_get(struct Mailbox *m,
+                                            const struct Pattern *pat,
+                                            enum PatternExecFlag flags)
+{
+  if (!m || !pat || (pat->memo_id == 0))
+    return NULL;
+
+  struct PatternMemos *pm = m->pattern_memo;
+  if (pm && (pm->count >= PATTERN_MEMO_MAX))
+    mutt_pattern_memo_free(&m->pattern_memo); /* start afresh */
+
+  if (!m->pattern_memo)
+  {
+    pm = mutt_mem_calloc(1, sizeof(struct PatternMemos));
+    pm->hash = mutt_hash_int_new(PATTERN_MEMO_MAX, MUTT_HASH_NO_FLAGS);
+    mutt_hash_set_destructor(pm->hash, memo_free, 0);
+    m->pattern_memo = pm;
+  }
+
+  unsigned int key = (pat->memo_id << 1) | ((flags & MUTT_MATCH_FULL_ADDRESS) ? 1 : 0);
+  struct PatternMemo *memo = mutt_hash_int_find(pm->hash, key);
+  if (!memo)
+  {
+    memo = mutt_mem_calloc(1, sizeof(struct PatternMemo));
+    mutt_hash_int_insert(pm->hash, key, memo);
+    pm->count++;
+  }
+
+  if (memo->num < m->email_max)
+  {
+    mutt_mem_realloc(&memo->entries, m->email_max * sizeof(struct PatternMemoEntry));
+    memset(memo->entries + memo->num, 0,
+           (m->email_max - memo->num) * sizeof(struct PatternMemoEntry));
+    memo->num = m->email_max;
+  }
+
+  return memo;
+}
+
+/**
+ * memo_exec - Match a pattern against an email, remembering the result
+ * @param memo  Remembered results, from pattern_memo_get(), may be NULL
+ * @param pat   Pattern to match
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param m     Mailbox
+ * @param e     Email
+ * @param cache Cache for common Patterns
+ * @retval  1 Success, pattern matched
+ * @retval  0 Pattern did not match
+ * @retval -1 Error
+ *
+ * A result is reused while the Email keeps its generation and flags.  Each
+ * Email has its own slot, so several threads may share the memo.
+ */
+static int memo_exec(struct PatternMemo *memo, struct Pattern *pat,
+                     enum PatternExecFlag flags, struct Mailbox *m,
+                     struct Email *e, struct PatternCache *cache)
+{
+  if (!memo || !e || (e->index < 0) || (e->index >= memo->num) || (e->gen == 0))
+    return pattern_exec(pat, flags, m, e, cache);
+
+  struct PatternMemoEntry *entry = &memo->entries[e->index];
+  unsigned int state = email_state(e);
+  if ((entry->gen == e->gen) && (entry->state == state))
+    return entry->result;
+
+  int result = pattern_exec(pat, flags, m, e, cache);
+
+  /* matching may have parsed the Email, giving it a new generation */
+  entry->gen = e->gen;
+  entry->state = email_state(e);
+  entry->result = result;
+  return result;
+}
+
+/**
+ * mutt_pattern_exec - Match a pattern against an email header
+ * @param pat   Pattern to match
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param m     Mailbox
+ * @param e     Email
+ * @param cache Cache for common Patterns
+ * @retval  1 Success, pattern matched
+ * @retval  0 Pattern did not match
+ * @retval -1 Error
+ *
+ * flags: MUTT_MATCH_FULL_ADDRESS - match both personal and machine address
+ * cache: For repeated matches against the same Header, passing in non-NULL will
+ *        store some of the cacheable pattern matches in this structure.
+ *
+ * The results of a compiled Pattern are remembered per Mailbox, so repeated
+ * matching, e.g. for colours, only evaluates the Emails that have changed.
+ */
+int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
+                      struct Mailbox *m, struct Email *e, struct PatternCache *cache)
+{
+  return memo_exec(pattern_memo_get(m, pat, flags), pat, flags, m, e, cache);
+}
+
 /**
  * quote_simple - Apply simple quoting to a string
  * @param str    String to quote
@@ -2318,6 +3043,628 @@ bool mutt_limit_current_thread(struct Email *e)
   return true;
 }
 
+#ifdef USE_IMAP
+/**
+ * pattern_needs_headers - Does a pattern look at the headers of the emails?
+ * @param pat Pattern to check
+ * @retval true The headers are needed
+ *
+ * IMAP emails may only be stubs, see imap_load_headers().
+ */
+static bool pattern_needs_headers(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (pat->server_exact)
+      continue;
+    switch (pat->op)
+    {
+      case MUTT_PAT_AND:
+      case MUTT_PAT_OR:
+        if (pattern_needs_headers(pat->child))
+          return true;
+        break;
+      case MUTT_EXPIRED:
+      case MUTT_SUPERSEDED:
+        return true;
+      case MUTT_PAT_DATE_RECEIVED:
+      case MUTT_PAT_DRIVER_TAGS:
+      case MUTT_PAT_MESSAGE:
+      case MUTT_PAT_SERVERSEARCH:
+        break;
+      default:
+        /* the other simple flags are known */
+        if (pat->op >= MUTT_MT_MAX)
+          return true;
+        break;
+    }
+  }
+  return false;
+}
+
+/**
+ * pattern_server_search - Let the IMAP server match what it can of a Pattern
+ * @param m   Mailbox
+ * @param pat Pattern to match
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * If imap_search() answers for the whole mailbox, the emails it rules out are
+ * never looked at locally, so only the headers of the others are fetched.
+ */
+static int pattern_server_search(struct Mailbox *m, struct Pattern *pat)
+{
+  mutt_hash_free(&pat->server_hits);
+
+  int rc = imap_search(m, pat);
+  if (rc < 0)
+    return -1;
+
+  if (rc == 0)
+  {
+    if (pattern_needs_headers(pat) && (imap_load_headers(m) < 0))
+      return -1;
+    return 0;
+  }
+
+  /* loading a stub's headers gives it a new generation, so the hits are only
+   * recorded afterwards */
+  if (pattern_needs_headers(pat) && (imap_load_matched_headers(m) < 0))
+    return -1;
+
+  pat->server_hits = mutt_hash_int_new(MAX(m->msg_count, 1), MUTT_HASH_NO_FLAGS);
+  pat->server_gen = 0;
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    struct Email *e = m->emails[i];
+    pat->server_gen = MAX(pat->server_gen, e->gen);
+    if (e->matched && (e->gen != 0))
+      mutt_hash_int_insert(pat->server_hits, e->gen, e);
+  }
+
+  /* the server's answer isn't part of the remembered results */
+  pat->memo_id = 0;
+  if (pat->prog)
+  {
+    prog_free(&pat->prog);
+    pat->prog = mutt_mem_calloc(1, sizeof(struct PatternProgram));
+    pat->prog->entry = prog_emit(pat->prog, pat, PROG_ACCEPT, PROG_REJECT);
+  }
+  return 0;
+}
+#endif
+
+#define PATTERN_THREADS_MAX 8     ///< Most threads used to match a Pattern
+#define PATTERN_THREADS_MIN 2000  ///< Fewer Emails than this are matched serially
+#define PATTERN_THREADS_CHUNK 256 ///< Number of Emails a thread claims at a time
+
+#ifdef HAVE_PTHREAD
+/**
+ * pattern_thread_safe - Can a Pattern be matched by several threads at once?
+ * @param pat Pattern to check
+ * @retval true The Pattern only reads the Emails' headers and flags
+ *
+ * Patterns that open messages, parse MIME structure or might report an error
+ * have to be matched on the main thread.
+ *
+ * glibc's regexec() locks the regex while it runs, so threads sharing a regex
+ * would take turns.  Only regexes that are plain text, which patmatch()
+ * answers without regexec(), are allowed.
+ */
+static bool pattern_thread_safe(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (!pat->ismulti && !pat->stringmatch && !pat->groupmatch && pat->p.regex &&
+        !pat->literal.whole)
+    {
+      return false;
+    }
+
+    switch (pat->op)
+    {
+      case MUTT_PAT_BODY:
+      case MUTT_PAT_HEADER:
+      case MUTT_PAT_WHOLE_MSG:
+      case MUTT_PAT_SERVERSEARCH:
+      case MUTT_PAT_MIMEATTACH:
+      case MUTT_PAT_MIMETYPE:
+        return false;
+      case MUTT_PAT_CRYPT_SIGN:
+      case MUTT_PAT_CRYPT_VERIFIED:
+      case MUTT_PAT_CRYPT_ENCRYPT:
+        if (!WithCrypto)
+          return false;
+        break;
+      case MUTT_PAT_PGP_KEY:
+        if (!(WithCrypto & APPLICATION_PGP))
+          return false;
+        break;
+    }
+
+    if (pat->child && !pattern_thread_safe(pat->child))
+      return false;
+  }
+  return true;
+}
+#endif
+
+/**
+ * match_threads - How many threads should match a Pattern
+ * @param pat Pattern to match
+ * @param num Number of Emails
+ * @retval num Number of threads, 1 to match serially
+ */
+static int match_threads(const struct Pattern *pat, int num)
+{
+#ifdef HAVE_PTHREAD
+  /* the debug log isn't thread-safe */
+  if ((num < PATTERN_THREADS_MIN) || (C_DebugLevel > 0) || !pattern_thread_safe(pat))
+    return 1;
+
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 2)
+    return 1;
+  return MIN(cpus, PATTERN_THREADS_MAX);
+#else
+  return 1;
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/**
+ * struct MatchJob - Emails being matched by a pool of threads
+ */
+struct MatchJob
+{
+  struct Pattern *pat;      ///< Pattern to match
+  struct Mailbox *mailbox;  ///< Mailbox the Emails belong to
+  struct PatternMemo *memo; ///< Remembered results of the Pattern
+  struct Email **emails;    ///< Emails to match
+  int num;                  ///< Number of Emails
+  bool *matches;            ///< Result for each Email
+  int next;                 ///< First Email nobody has claimed
+  int done;                 ///< Number of Emails matched
+  int running;              ///< Number of threads still running
+  bool cancel;              ///< Stop matching
+  pthread_mutex_t lock;     ///< Protects next, done, running and cancel
+  pthread_cond_t cond;      ///< Signalled when a thread finishes a chunk
+};
+
+/**
+ * match_thread - Match chunks of Emails until there are none left
+ * @param arg MatchJob
+ * @retval NULL Always
+ *
+ * The Emails are only read.  The results go into MatchJob::matches, so no
+ * Email bit-fields are written outside the main thread.
+ */
+static void *match_thread(void *arg)
+{
+  struct MatchJob *job = arg;
+
+  pthread_mutex_lock(&job->lock);
+  while (!job->cancel && (job->next < job->num))
+  {
+    const int first = job->next;
+    const int last = MIN(first + PATTERN_THREADS_CHUNK, job->num);
+    job->next = last;
+    pthread_mutex_unlock(&job->lock);
+
+    for (int i = first; i < last; i++)
+    {
+      job->matches[i] = (memo_exec(job->memo, job->pat, MUTT_MATCH_FULL_ADDRESS,
+                                   job->mailbox, job->emails[i], NULL) != 0);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->done += last - first;
+    pthread_cond_signal(&job->cond);
+  }
+  job->running--;
+  pthread_cond_signal(&job->cond);
+  pthread_mutex_unlock(&job->lock);
+  return NULL;
+}
+
+/**
+ * match_emails_threaded - Match a Pattern against Emails using several threads
+ * @param job      Emails to match
+ * @param threads  Number of threads to use
+ * @param progress Progress bar, may be NULL
+ * @param base     Progress already made
+ * @retval  0 Success
+ * @retval -1 Interrupted
+ * @retval -2 No threads could be started
+ *
+ * The main thread keeps the progress bar moving and watches for Ctrl-C.
+ */
+static int match_emails_threaded(struct MatchJob *job, int threads,
+                                 struct Progress *progress, int base)
+{
+  pthread_t tids[PATTERN_THREADS_MAX];
+  int started = 0;
+
+  pthread_mutex_init(&job->lock, NULL);
+  pthread_cond_init(&job->cond, NULL);
+
+  pthread_mutex_lock(&job->lock);
+  for (; started < threads; started++)
+  {
+    if (pthread_create(&tids[started], NULL, match_thread, job) != 0)
+      break;
+    job->running++;
+  }
+
+  while (job->running > 0)
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100 * 1000 * 1000;
+    if (ts.tv_nsec >= 1000 * 1000 * 1000)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000 * 1000 * 1000;
+    }
+    pthread_cond_timedwait(&job->cond, &job->lock, &ts);
+
+    if (SigInt)
+      job->cancel = true;
+    const int done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    if (progress)
+      mutt_progress_update(progress, base + done, -1);
+    pthread_mutex_lock(&job->lock);
+  }
+  pthread_mutex_unlock(&job->lock);
+
+  for (int i = 0; i < started; i++)
+    pthread_join(tids[i], NULL);
+  pthread_cond_destroy(&job->cond);
+  pthread_mutex_destroy(&job->lock);
+
+  if (started == 0)
+    return -2;
+  return job->cancel ? -1 : 0;
+}
+#endif
+
+/**
+ * mutt_pattern_ranges_free - Free the sorted indexes of a Mailbox
+ * @param ptr Indexes to free
+ */
+void mutt_pattern_ranges_free(struct PatternRanges **ptr)
+{
+  if (!ptr || !*ptr)
+    return;
+
+  struct PatternRanges *pr = *ptr;
+  for (int i = 0; i < RANGE_MAX; i++)
+    FREE(&pr->index[i]);
+  FREE(&pr->gens);
+  FREE(ptr);
+}
+
+/**
+ * range_key - Which sorted index can answer a Pattern?
+ * @param pat Pattern
+ * @retval num #PatternRangeKey
+ * @retval -1  The Pattern isn't a plain range
+ */
+static int range_key(const struct Pattern *pat)
+{
+  if (pat->not)
+    return -1;
+
+  switch (pat->op)
+  {
+    case MUTT_PAT_DATE:
+      return RANGE_DATE_SENT;
+    case MUTT_PAT_DATE_RECEIVED:
+      return RANGE_RECEIVED;
+    case MUTT_PAT_SIZE:
+      return RANGE_SIZE;
+    default:
+      return -1;
+  }
+}
+
+/**
+ * range_value - Get the field of an Email that a sorted index uses
+ * @param e   Email
+ * @param key #PatternRangeKey
+ * @retval num Value of the field
+ */
+static long range_value(const struct Email *e, int key)
+{
+  switch (key)
+  {
+    case RANGE_DATE_SENT:
+      return e->date_sent;
+    case RANGE_RECEIVED:
+      return e->received;
+    default:
+      return e->content ? e->content->length : 0;
+  }
+}
+
+/**
+ * range_index_get - Get a sorted index of a Mailbox's Emails
+ * @param m   Mailbox
+ * @param key #PatternRangeKey
+ * @retval ptr Entries, one per Email, sorted by value
+ *
+ * This must be called from the main thread.
+ */
+static struct EmailRangeEntry *range_index_get(struct Mailbox *m, int key)
+{
+  struct PatternRanges *pr = m->pattern_ranges;
+
+  /* every Email must be unchanged since the indexes were built */
+  bool valid = pr && (pr->count == m->msg_count);
+  for (int i = 0; valid && (i < m->msg_count); i++)
+  {
+    const struct Email *e = m->emails[i];
+    valid = (e->index >= 0) && (e->index < pr->num_gens) && (e->gen != 0) &&
+            (pr->gens[e->index] == e->gen);
+  }
+
+  if (!valid)
+  {
+    mutt_pattern_ranges_free(&m->pattern_ranges);
+    pr = mutt_mem_calloc(1, sizeof(struct PatternRanges));
+    pr->num_gens = m->email_max;
+    pr->gens = mutt_mem_calloc(MAX(pr->num_gens, 1), sizeof(unsigned int));
+    for (int i = 0; i < m->msg_count; i++)
+    {
+      const struct Email *e = m->emails[i];
+      if ((e->index >= 0) && (e->index < pr->num_gens))
+        pr->gens[e->index] = e->gen;
+    }
+    pr->count = m->msg_count;
+    m->pattern_ranges = pr;
+  }
+
+  if (!pr->index[key])
+  {
+    struct EmailRangeEntry *entries =
+        mutt_mem_calloc(MAX(m->msg_count, 1), sizeof(struct EmailRangeEntry));
+    for (int i = 0; i < m->msg_count; i++)
+    {
+      entries[i].value = range_value(m->emails[i], key);
+      entries[i].email = m->emails[i];
+    }
+    email_range_sort(entries, m->msg_count);
+    pr->index[key] = entries;
+    mutt_debug(LL_DEBUG2, "built range index %d of %d emails\n", key, m->msg_count);
+  }
+
+  return pr->index[key];
+}
+
+/**
+ * range_best - Find the most selective range of a Pattern
+ * @param[in]  pat     Pattern to match
+ * @param[in]  m       Mailbox
+ * @param[out] entries First entry of the sorted index inside the range
+ * @retval num Number of entries inside the range
+ * @retval -1  The Pattern has no range that rules anything out
+ *
+ * If the Pattern is a range (~d, ~r, ~z), or an AND of terms including one,
+ * the Emails outside the range can't match.
+ */
+static int range_best(struct Pattern *pat, struct Mailbox *m,
+                      const struct EmailRangeEntry **entries)
+{
+  struct Pattern *terms = pat;
+  if ((pat->op == MUTT_PAT_AND) && !pat->not)
+    terms = pat->child;
+  else if (pat->next)
+    return -1;
+
+  int best_num = -1;
+  for (struct Pattern *p = terms; p; p = p->next)
+  {
+    const int key = range_key(p);
+    if (key < 0)
+      continue;
+
+    const struct EmailRangeEntry *index = range_index_get(m, key);
+    const int first = email_range_bound(index, m->msg_count, p->min, true);
+    int last = m->msg_count;
+    if ((key != RANGE_SIZE) || (p->max != MUTT_MAXRANGE))
+      last = email_range_bound(index, m->msg_count, p->max, false);
+
+    const int num = MAX(last - first, 0);
+    if ((num < m->msg_count) && ((best_num < 0) || (num < best_num)))
+    {
+      *entries = index + first;
+      best_num = num;
+    }
+  }
+
+  return best_num;
+}
+
+/**
+ * match_candidates - Narrow down the Emails that can match a Pattern
+ * @param[in]  pat    Pattern to match
+ * @param[in]  m      Mailbox the Emails belong to
+ * @param[in]  emails Emails to match
+ * @param[in]  num    Number of Emails
+ * @param[in]  hits   Emails the server says can match, by Email::msgno, may be NULL
+ * @param[out] cands  Emails that can match
+ * @param[out] pos    Position of each candidate in emails
+ * @retval num Number of candidates
+ * @retval -1  Every Email must be matched
+ *
+ * Emails outside the Pattern's most selective range (see range_best()) and
+ * Emails the server has ruled out can't match.
+ */
+static int match_candidates(struct Pattern *pat, struct Mailbox *m, struct Email **emails,
+                            int num, const bool *hits, struct Email ***cands, int **pos)
+{
+  if (!m || !pat || (m->msg_count == 0))
+    return -1;
+
+  const struct EmailRangeEntry *best = NULL;
+  int best_num = -1;
+  if (num >= PATTERN_RANGE_MIN)
+    best_num = range_best(pat, m, &best);
+
+  if ((best_num < 0) && !hits)
+    return -1;
+
+  *cands = mutt_mem_calloc(MAX(num, 1), sizeof(struct Email *));
+  *pos = mutt_mem_calloc(MAX(num, 1), sizeof(int));
+  const int count = email_range_candidates(best, best_num, m->email_max, hits,
+                                           m->msg_count, emails, num, *cands, *pos);
+
+  mutt_debug(LL_DEBUG2, "narrowed %d emails to %d\n", num, count);
+  return count;
+}
+
+/**
+ * match_emails_scan - Match a Pattern against every one of many Emails
+ * @param[in]  pat      Pattern to match
+ * @param[in]  m        Mailbox the Emails belong to
+ * @param[in]  emails   Emails to match
+ * @param[in]  num      Number of Emails
+ * @param[in]  progress Progress bar, may be NULL
+ * @param[in]  base     Progress already made
+ * @param[out] matches  Result for each Email
+ * @retval  0 Success
+ * @retval -1 Interrupted
+ *
+ * Large batches of Emails are split between threads, if the Pattern only
+ * looks at the headers.
+ */
+static int match_emails_scan(struct Pattern *pat, struct Mailbox *m, struct Email **emails,
+                             int num, struct Progress *progress, int base, bool *matches)
+{
+  /* get the memo here, the threads mustn't create it */
+  struct PatternMemo *memo = pattern_memo_get(m, pat, MUTT_MATCH_FULL_ADDRESS);
+
+#ifdef HAVE_PTHREAD
+  const int threads = match_threads(pat, num);
+  if (threads > 1)
+  {
+    struct MatchJob job = { 0 };
+    job.pat = pat;
+    job.mailbox = m;
+    job.memo = memo;
+    job.emails = emails;
+    job.num = num;
+    job.matches = matches;
+
+    const int rc = match_emails_threaded(&job, threads, progress, base);
+    if (rc != -2)
+      return rc;
+  }
+#endif
+
+  for (int i = 0; i < num; i++)
+  {
+    if (progress)
+      mutt_progress_update(progress, base + i, -1);
+    matches[i] = (memo_exec(memo, pat, MUTT_MATCH_FULL_ADDRESS, m, emails[i], NULL) != 0);
+    if (SigInt)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * match_emails - Match a Pattern against many Emails
+ * @param[in]  pat      Pattern to match
+ * @param[in]  m        Mailbox the Emails belong to
+ * @param[in]  emails   Emails to match
+ * @param[in]  num      Number of Emails
+ * @param[in]  hits     Emails the server says can match, by Email::msgno, may be NULL
+ * @param[in]  progress Progress bar, may be NULL
+ * @param[in]  base     Progress already made
+ * @param[out] matches  Result for each Email
+ * @retval  0 Success
+ * @retval -1 Interrupted
+ *
+ * If the Pattern is limited to a range of dates or sizes, or the server has
+ * ruled out some Emails, only the other Emails are matched.
+ */
+static int match_emails(struct Pattern *pat, struct Mailbox *m, struct Email **emails,
+                        int num, const bool *hits, struct Progress *progress,
+                        int base, bool *matches)
+{
+  struct Email **cands = NULL;
+  int *pos = NULL;
+  const int num_cands = match_candidates(pat, m, emails, num, hits, &cands, &pos);
+  if (num_cands < 0)
+    return match_emails_scan(pat, m, emails, num, progress, base, matches);
+
+  bool *cand_matches = mutt_mem_calloc(MAX(num_cands, 1), sizeof(bool));
+  const int rc = match_emails_scan(pat, m, cands, num_cands, progress, base, cand_matches);
+
+  for (int i = 0; i < num; i++)
+    matches[i] = false;
+  for (int i = 0; i < num_cands; i++)
+    matches[pos[i]] = cand_matches[i];
+  if ((rc == 0) && progress)
+    mutt_progress_update(progress, base + num, -1);
+
+  FREE(&cand_matches);
+  FREE(&cands);
+  FREE(&pos);
+  return rc;
+}
+
+/**
+ * search_ahead - Match a Pattern against the next few unsearched Emails
+ * @param pat      Pattern to match
+ * @param m        Mailbox
+ * @param vnum     Virtual index of the first Email
+ * @param incr     Direction of the search, 1 or -1
+ * @param progress Progress bar
+ * @param base     Progress already made
+ * @retval true  A batch of Emails was matched
+ * @retval false The Emails should be matched one at a time
+ *
+ * If the Pattern can be matched by several threads, a batch of Emails is
+ * matched at once and the results are recorded in Email::searched and
+ * Email::matched, for mutt_search_command() to pick up.
+ */
+static bool search_ahead(struct Pattern *pat, struct Mailbox *m, int vnum,
+                         int incr, struct Progress *progress, int base)
+{
+  const int max = PATTERN_THREADS_MIN * PATTERN_THREADS_MAX;
+  if (match_threads(pat, max) < 2)
+    return false;
+
+  struct Email **emails = mutt_mem_calloc(max, sizeof(struct Email *));
+  int num = 0;
+  for (int i = vnum; (i >= 0) && (i < m->vcount) && (num < max); i += incr)
+  {
+    struct Email *e = m->emails[m->v2r[i]];
+    if (!e->searched)
+      emails[num++] = e;
+  }
+
+  const bool batch = (match_threads(pat, num) > 1);
+  if (batch)
+  {
+    bool *matches = mutt_mem_calloc(num, sizeof(bool));
+    if (match_emails(pat, m, emails, num, NULL, progress, base, matches) == 0)
+    {
+      for (int i = 0; i < num; i++)
+      {
+        emails[i]->searched = true;
+        emails[i]->matched = matches[i];
+      }
+    }
+    FREE(&matches);
+  }
+  FREE(&emails);
+  return batch;
+}
+
 /**
  * mutt_pattern_func - Perform some Pattern matching
  * @param op     Operation to perform, e.g. #MUTT_LIMIT
@@ -2332,6 +3679,9 @@ int mutt_pattern_func(int op, char *prompt)
   struct Buffer err;
   int rc = -1, padding;
   struct Progress progress;
+  struct Email **emails = NULL;
+  bool *matches = NULL;
+  bool *hits = NULL;
 
   mutt_str_strfcpy(buf, Context->pattern, sizeof(buf));
   if (prompt || (op != MUTT_LIMIT))
@@ -2339,6 +3689,9 @@ int mutt_pattern_func(int op, char *prompt)
         !buf[0])
       return -1;
 
+#ifdef USE_HCACHE
+  body_index_hold();
+#endif
   mutt_message(_("Compiling search pattern..."));
 
   simple = mutt_str_strdup(buf);
@@ -2355,8 +3708,20 @@ int mutt_pattern_func(int op, char *prompt)
   }
 
 #ifdef USE_IMAP
-  if ((Context->mailbox->magic == MUTT_IMAP) && (imap_search(Context->mailbox, pat) < 0))
+  if ((Context->mailbox->magic == MUTT_IMAP) &&
+      (pattern_server_search(Context->mailbox, pat) < 0))
+  {
     goto bail;
+  }
+#endif
+#ifdef USE_NOTMUCH
+  /* let notmuch rule out the messages it can */
+  if (Context->mailbox->magic == MUTT_NOTMUCH)
+  {
+    hits = mutt_mem_calloc(MAX(Context->mailbox->msg_count, 1), sizeof(bool));
+    if (nm_search(Context->mailbox, pat, hits) < 0)
+      FREE(&hits);
+  }
 #endif
 
   mutt_progress_init(&progress, _("Executing command on matching messages..."),
@@ -2364,60 +3729,70 @@ int mutt_pattern_func(int op, char *prompt)
                      (op == MUTT_LIMIT) ? Context->mailbox->msg_count :
                                           Context->mailbox->vcount);
 
+  /* match everything first, then apply the results in one pass */
+  struct Mailbox *m = Context->mailbox;
+  const int num = (op == MUTT_LIMIT) ? m->msg_count : m->vcount;
+  emails = m->emails;
+  if (op != MUTT_LIMIT)
+  {
+    emails = mutt_mem_calloc(MAX(num, 1), sizeof(struct Email *));
+    for (int i = 0; i < num; i++)
+      emails[i] = m->emails[m->v2r[i]];
+  }
+  matches = mutt_mem_calloc(MAX(num, 1), sizeof(bool));
+  if (match_emails(pat, m, emails, num, hits, &progress, 0, matches) < 0)
+  {
+    mutt_error(_("Search interrupted"));
+    SigInt = 0;
+    goto bail;
+  }
+
   if (op == MUTT_LIMIT)
   {
-    Context->mailbox->vcount = 0;
+    m->vcount = 0;
     Context->vsize = 0;
     Context->collapsed = false;
-    padding = mx_msg_padding_size(Context->mailbox);
+    Context->limit_dirty_num = 0;
+    padding = mx_msg_padding_size(m);
 
-    for (int i = 0; i < Context->mailbox->msg_count; i++)
+    for (int i = 0; i < num; i++)
     {
-      mutt_progress_update(&progress, i, -1);
+      struct Email *e = m->emails[i];
       /* new limit pattern implicitly uncollapses all threads */
-      Context->mailbox->emails[i]->virtual = -1;
-      Context->mailbox->emails[i]->limited = false;
-      Context->mailbox->emails[i]->collapsed = false;
-      Context->mailbox->emails[i]->num_hidden = 0;
-      if (mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context->mailbox,
-                            Context->mailbox->emails[i], NULL))
+      e->virtual = -1;
+      e->limited = false;
+      e->collapsed = false;
+      e->num_hidden = 0;
+      if (matches[i])
       {
-        Context->mailbox->emails[i]->virtual = Context->mailbox->vcount;
-        Context->mailbox->emails[i]->limited = true;
-        Context->mailbox->v2r[Context->mailbox->vcount] = i;
-        Context->mailbox->vcount++;
-        struct Body *b = Context->mailbox->emails[i]->content;
+        e->virtual = m->vcount;
+        e->limited = true;
+        m->v2r[m->vcount] = i;
+        m->vcount++;
+        struct Body *b = e->content;
         Context->vsize += b->length + b->offset - b->hdr_offset + padding;
       }
     }
   }
   else
   {
-    for (int i = 0; i < Context->mailbox->vcount; i++)
+    for (int i = 0; i < num; i++)
     {
-      mutt_progress_update(&progress, i, -1);
-      if (mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context->mailbox,
-                            Context->mailbox->emails[Context->mailbox->v2r[i]], NULL))
+      if (!matches[i])
+        continue;
+
+      switch (op)
       {
-        switch (op)
-        {
-          case MUTT_UNDELETE:
-            mutt_set_flag(Context->mailbox,
-                          Context->mailbox->emails[Context->mailbox->v2r[i]],
-                          MUTT_PURGE, false);
-          /* fallthrough */
-          case MUTT_DELETE:
-            mutt_set_flag(Context->mailbox,
-                          Context->mailbox->emails[Context->mailbox->v2r[i]],
-                          MUTT_DELETE, (op == MUTT_DELETE));
-            break;
-          case MUTT_TAG:
-          case MUTT_UNTAG:
-            mutt_set_flag(Context->mailbox,
-                          Context->mailbox->emails[Context->mailbox->v2r[i]],
-                          MUTT_TAG, (op == MUTT_TAG));
-            break;
-        }
+        case MUTT_UNDELETE:
+          mutt_set_flag(m, emails[i], MUTT_PURGE, false);
+        /* fallthrough */
+        case MUTT_DELETE:
+          mutt_set_flag(m, emails[i], MUTT_DELETE, (op == MUTT_DELETE));
+          break;
+        case MUTT_TAG:
+        case MUTT_UNTAG:
+          mutt_set_flag(m, emails[i], MUTT_TAG, (op == MUTT_TAG));
+          break;
       }
     }
   }
@@ -2451,18 +3826,25 @@ bail:
   FREE(&simple);
   mutt_pattern_free(&pat);
   FREE(&err.data);
+  if (emails != Context->mailbox->emails)
+    FREE(&emails);
+  FREE(&matches);
+  FREE(&hits);
+#ifdef USE_HCACHE
+  body_index_release();
+#endif
 
   return rc;
 }
 
 /**
- * mutt_search_command - Perform a search
+ * search_command - Perform a search
  * @param cur Index number of current email
  * @param op  Operation to perform, e.g. OP_SEARCH_NEXT
  * @retval >= 0 Index of matching email
  * @retval -1 No match, or error
  */
-int mutt_search_command(int cur, int op)
+static int search_command(int cur, int op)
 {
   struct Progress progress;
 
@@ -2519,8 +3901,10 @@ int mutt_search_command(int cur, int op)
       Context->mailbox->emails[i]->searched = false;
 #ifdef USE_IMAP
     if ((Context->mailbox->magic == MUTT_IMAP) &&
-        (imap_search(Context->mailbox, SearchPattern) < 0))
+        (pattern_server_search(Context->mailbox, SearchPattern) < 0))
+    {
       return -1;
+    }
 #endif
     OptSearchInvalid = false;
   }
@@ -2532,6 +3916,7 @@ int mutt_search_command(int cur, int op)
   mutt_progress_init(&progress, _("Searching..."), MUTT_PROGRESS_MSG, C_ReadInc,
                      Context->mailbox->vcount);
 
+  bool ahead = true;
   for (int i = cur + incr, j = 0; j != Context->mailbox->vcount; j++)
   {
     const char *msg = NULL;
@@ -2539,6 +3924,7 @@ int mutt_search_command(int cur, int op)
     if (i > Context->mailbox->vcount - 1)
     {
       i = 0;
+      ahead = true;
       if (C_WrapSearch)
         msg = _("Search wrapped to top");
       else
@@ -2550,6 +3936,7 @@ int mutt_search_command(int cur, int op)
     else if (i < 0)
     {
       i = Context->mailbox->vcount - 1;
+      ahead = true;
       if (C_WrapSearch)
         msg = _("Search wrapped to bottom");
       else
@@ -2573,10 +3960,17 @@ int mutt_search_command(int cur, int op)
     }
     else
     {
+      /* match a batch of messages in parallel, if possible */
+      if (ahead)
+        ahead = search_ahead(SearchPattern, Context->mailbox, i, incr, &progress, j);
+
       /* remember that we've already searched this message */
-      e->searched = true;
-      e->matched = mutt_pattern_exec(SearchPattern, MUTT_MATCH_FULL_ADDRESS,
-                                     Context->mailbox, e, NULL);
+      if (!e->searched)
+      {
+        e->searched = true;
+        e->matched = mutt_pattern_exec(SearchPattern, MUTT_MATCH_FULL_ADDRESS,
+                                       Context->mailbox, e, NULL);
+      }
       if (e->matched > 0)
       {
         mutt_clear_error();
@@ -2599,3 +3993,22 @@ int mutt_search_command(int cur, int op)
   mutt_error(_("Not found"));
   return -1;
 }
+
+/**
+ * mutt_search_command - Perform a search
+ * @param cur Index number of current email
+ * @param op  Operation to perform, e.g. OP_SEARCH_NEXT
+ * @retval >= 0 Index of matching email
+ * @retval -1 No match, or error
+ */
+int mutt_search_command(int cur, int op)
+{
+#ifdef USE_HCACHE
+  body_index_hold();
+#endif
+  int rc = search_command(cur, op);
+#ifdef USE_HCACHE
+  body_index_release();
+#endif
+  return rc;
+}
@@ -31,7 +31,11 @@
 struct Address;
 struct Buffer;
 struct Email;
+struct Hash;
 struct Mailbox;
+struct PatternMemos;
+struct PatternProgram;
+struct PatternRanges;
 
 /* These Config Variables are only used in pattern.c */
 extern bool C_ThoroughSearch;
@@ -52,6 +56,7 @@ struct Pattern
   bool ign_case : 1; /**< ignore case for local stringmatch searches */
   bool isalias : 1;
   bool ismulti : 1; /**< multiple case (only for I pattern now) */
+  bool server_exact : 1; /**< the IMAP server's search answers this exactly */
   int min;
   int max;
   struct Pattern *next;
@@ -62,6 +67,11 @@ struct Pattern
     char *str;
     struct ListHead multi_cases;
   } p;
+  struct PatternProgram *prog; /**< flattened form of a logical op */
+  struct RegexLiteral literal; /**< text every regex match contains */
+  unsigned int memo_id;        /**< key for remembered results, 0 if they can't be */
+  struct Hash *server_hits;    /**< Email::gen of the emails the IMAP server matched */
+  unsigned int server_gen;     /**< emails up to this Email::gen were searched by the server */
 };
 
 /**
@@ -70,6 +80,7 @@ struct Pattern
 enum PatternExecFlag
 {
   MUTT_MATCH_FULL_ADDRESS = 1, ///< Match the full address
+  MUTT_MATCH_SERVER_HIT = 2,   ///< The IMAP server's search matched the email
 };
 
 /**
@@ -155,6 +166,8 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
 struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer *err);
 void mutt_check_simple(char *s, size_t len, const char *simple);
 void mutt_pattern_free(struct Pattern **pat);
+void mutt_pattern_memo_free(struct PatternMemos **ptr);
+void mutt_pattern_ranges_free(struct PatternRanges **ptr);
 
 int mutt_which_case(const char *s);
 int mutt_is_list_recipient(bool alladdr, struct Address *a1, struct Address *a2);
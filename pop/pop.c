@@ -251,6 +251,25 @@ static int pop_read_header(struct PopAccountData *adata, struct Email *e)
   return rc;
 }
 
+/**
+ * pop_read_header_ahead - Send the commands of pop_read_header() in advance
+ * @param adata POP Account data
+ * @param e     Email
+ * @retval  0 Success
+ * @retval -1 Connection lost
+ */
+static int pop_read_header_ahead(struct PopAccountData *adata, struct Email *e)
+{
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "LIST %d\r\n", e->refno);
+  if (pop_query_ahead(adata, buf, false) < 0)
+    return -1;
+
+  snprintf(buf, sizeof(buf), "TOP %d 0\r\n", e->refno);
+  return pop_query_ahead(adata, buf, true);
+}
+
 /**
  * fetch_uidl - parse UIDL - Implements ::pop_fetch_t
  * @param line String to parse
@@ -454,10 +473,27 @@ static int pop_fetch_headers(struct Mailbox *m)
     }
 
     bool hcached = false;
+    int ahead = old_count;
     for (i = old_count; i < new_count; i++)
     {
       if (!m->quiet)
         mutt_progress_update(&progress, i + 1 - old_count, -1);
+
+      /* keep the server busy with the headers of the next messages */
+      for (; (ahead < new_count) && (adata->cmd_top == 1) && pop_pipeline_room(adata, 2); ahead++)
+      {
+#ifdef USE_HCACHE
+        struct PopEmailData *edata_ahead = m->emails[ahead]->edata;
+        void *data = mutt_hcache_fetch(hc, edata_ahead->uid, strlen(edata_ahead->uid));
+        const bool cached = data;
+        mutt_hcache_free(hc, &data);
+        if (cached)
+          continue;
+#endif
+        if (pop_read_header_ahead(adata, m->emails[ahead]) < 0)
+          break;
+      }
+
       struct PopEmailData *edata = m->emails[i]->edata;
 #ifdef USE_HCACHE
       void *data = mutt_hcache_fetch(hc, edata->uid, strlen(edata->uid));
@@ -536,6 +572,7 @@ static int pop_fetch_headers(struct Mailbox *m)
 
   if (rc < 0)
   {
+    pop_pipeline_drain(adata);
     for (int i = m->msg_count; i < new_count; i++)
       mutt_email_free(&m->emails[i]);
     return rc;
@@ -668,8 +705,18 @@ void pop_fetch_mail(void)
            bytes);
   mutt_message("%s", msgbuf);
 
+  int ahead = last + 1;
+  int saved = last;
   for (int i = last + 1; i <= msgs; i++)
   {
+    /* keep the server busy with the next messages */
+    for (; (ahead <= msgs) && pop_pipeline_room(adata, 1); ahead++)
+    {
+      snprintf(buf, sizeof(buf), "RETR %d\r\n", ahead);
+      if (pop_query_ahead(adata, buf, true) < 0)
+        break;
+    }
+
     struct Message *msg = mx_msg_open_new(ctx->mailbox, NULL, MUTT_ADD_FROM);
     if (!msg)
       ret = -3;
@@ -689,13 +736,6 @@ void pop_fetch_mail(void)
       mx_msg_close(ctx->mailbox, &msg);
     }
 
-    if ((ret == 0) && (delanswer == MUTT_YES))
-    {
-      /* delete the message on the server */
-      snprintf(buf, sizeof(buf), "DELE %d\r\n", i);
-      ret = pop_query(adata, buf, sizeof(buf));
-    }
-
     if (ret == -1)
     {
       mx_mbox_close(&ctx);
@@ -712,6 +752,8 @@ void pop_fetch_mail(void)
       break;
     }
 
+    saved = i;
+
     /* L10N: The plural is picked by the second numerical argument, i.e.
        the %d right before 'messages', i.e. the total number of messages. */
     mutt_message(ngettext("%s [%d of %d message read]",
@@ -721,6 +763,37 @@ void pop_fetch_mail(void)
 
   mx_mbox_close(&ctx);
 
+  if (pop_pipeline_drain(adata) < 0)
+    goto fail;
+
+  /* The server only deletes messages at QUIT, so there's no hurry.
+   * Delete the saved messages once they're all safely in the spool. */
+  if (!rset && (delanswer == MUTT_YES))
+  {
+    ahead = last + 1;
+    for (int i = last + 1; i <= saved; i++)
+    {
+      for (; (ahead <= saved) && pop_pipeline_room(adata, 1); ahead++)
+      {
+        snprintf(buf, sizeof(buf), "DELE %d\r\n", ahead);
+        if (pop_query_ahead(adata, buf, false) < 0)
+          break;
+      }
+
+      snprintf(buf, sizeof(buf), "DELE %d\r\n", i);
+      ret = pop_query(adata, buf, sizeof(buf));
+      if (ret == -1)
+        goto fail;
+      if (ret == -2)
+      {
+        mutt_error("%s", adata->err_msg);
+        if (pop_pipeline_drain(adata) < 0)
+          goto fail;
+        break;
+      }
+    }
+  }
+
   if (rset)
   {
     /* make sure no messages get deleted */
@@ -964,8 +1037,19 @@ static int pop_mbox_sync(struct Mailbox *m, int *index_hint)
     hc = pop_hcache_open(adata, m->path);
 #endif
 
+    int ahead = 0;
     for (i = 0, j = 0, rc = 0; (rc == 0) && (i < m->msg_count); i++)
     {
+      /* keep the server busy with the next deletions */
+      for (; (ahead < m->msg_count) && pop_pipeline_room(adata, 1); ahead++)
+      {
+        if (!m->emails[ahead]->deleted || (m->emails[ahead]->refno == -1))
+          continue;
+        snprintf(buf, sizeof(buf), "DELE %d\r\n", m->emails[ahead]->refno);
+        if (pop_query_ahead(adata, buf, false) < 0)
+          break;
+      }
+
       struct PopEmailData *edata = m->emails[i]->edata;
       if (m->emails[i]->deleted && (m->emails[i]->refno != -1))
       {
@@ -995,6 +1079,9 @@ static int pop_mbox_sync(struct Mailbox *m, int *index_hint)
     mutt_hcache_close(hc);
 #endif
 
+    if ((pop_pipeline_drain(adata) < 0) && (rc == 0))
+      rc = -1;
+
     if (rc == 0)
     {
       mutt_str_strfcpy(buf, "QUIT\r\n", sizeof(buf));
@@ -1192,6 +1279,9 @@ static int pop_msg_open(struct Mailbox *m, struct Message *msg, int msgno)
   if (!WithCrypto)
     e->security = crypt_query(e->content);
 
+  /* the email now has its real headers and length */
+  mutt_email_touch(e);
+
   mutt_clear_error();
   rewind(msg->fp);
 
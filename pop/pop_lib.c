@@ -148,6 +148,9 @@ static int fetch_capa(char *line, void *data)
   else if (mutt_str_startswith(line, "TOP", CASE_IGNORE))
     adata->cmd_top = 1;
 
+  else if (mutt_str_startswith(line, "PIPELINING", CASE_IGNORE))
+    adata->cmd_pipelining = true;
+
   return 0;
 }
 
@@ -200,6 +203,7 @@ static int pop_capabilities(struct PopAccountData *adata, int mode)
     adata->cmd_user = 0;
     adata->cmd_uidl = 0;
     adata->cmd_top = 0;
+    adata->cmd_pipelining = false;
     adata->resp_codes = false;
     adata->expire = true;
     adata->login_delay = 0;
@@ -302,6 +306,8 @@ int pop_open_connection(struct PopAccountData *adata)
 {
   char buf[1024];
 
+  adata->ahead_count = 0;
+
   int rc = pop_connect(adata);
   if (rc < 0)
     return rc;
@@ -443,19 +449,31 @@ void pop_logout(struct Mailbox *m)
  * @retval  0 Successful
  * @retval -1 Connection lost
  * @retval -2 Invalid command or execution error
+ *
+ * If commands have been sent with pop_query_ahead(), buf must hold the oldest
+ * of them.  It isn't sent again, only its response is read.
  */
 int pop_query_d(struct PopAccountData *adata, char *buf, size_t buflen, char *msg)
 {
   if (adata->status != POP_CONNECTED)
     return -1;
 
-  /* print msg instead of real command */
-  if (msg)
+  if (adata->ahead_count > 0)
   {
-    mutt_debug(MUTT_SOCK_LOG_CMD, "> %s", msg);
+    /* pop_query_ahead() has already sent it */
+    adata->ahead_head = (adata->ahead_head + 1) % POP_PIPELINE_DEPTH;
+    adata->ahead_count--;
   }
+  else
+  {
+    /* print msg instead of real command */
+    if (msg)
+    {
+      mutt_debug(MUTT_SOCK_LOG_CMD, "> %s", msg);
+    }
 
-  mutt_socket_send_d(adata->conn, buf, MUTT_SOCK_LOG_FULL);
+    mutt_socket_send_d(adata->conn, buf, MUTT_SOCK_LOG_FULL);
+  }
 
   char *c = strpbrk(buf, " \r\n");
   if (c)
@@ -475,31 +493,22 @@ int pop_query_d(struct PopAccountData *adata, char *buf, size_t buflen, char *ms
 }
 
 /**
- * pop_fetch_data - Read Headers with callback function
+ * fetch_lines - Read the lines of a multi-line response
  * @param adata    POP Account data
- * @param query    POP query to send to server
  * @param progress Progress bar
- * @param callback Function called for each header read
+ * @param callback Function called for each line read (OPTIONAL)
  * @param data     Data to pass to the callback
  * @retval  0 Successful
  * @retval -1 Connection lost
- * @retval -2 Invalid command or execution error
  * @retval -3 Error in callback(*line, *data)
- *
- * This function calls  callback(*line, *data)  for each received line,
- * callback(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
  */
-int pop_fetch_data(struct PopAccountData *adata, const char *query,
-                   struct Progress *progress, pop_fetch_t callback, void *data)
+static int fetch_lines(struct PopAccountData *adata, struct Progress *progress,
+                       pop_fetch_t callback, void *data)
 {
   char buf[1024];
   long pos = 0;
   size_t lenbuf = 0;
-
-  mutt_str_strfcpy(buf, query, sizeof(buf));
-  int rc = pop_query(adata, buf, sizeof(buf));
-  if (rc < 0)
-    return rc;
+  int rc = 0;
 
   char *inbuf = mutt_mem_malloc(sizeof(buf));
 
@@ -534,7 +543,7 @@ int pop_fetch_data(struct PopAccountData *adata, const char *query,
     {
       if (progress)
         mutt_progress_update(progress, pos, -1);
-      if ((rc == 0) && (callback(inbuf, data) < 0))
+      if ((rc == 0) && callback && (callback(inbuf, data) < 0))
         rc = -3;
       lenbuf = 0;
     }
@@ -546,6 +555,99 @@ int pop_fetch_data(struct PopAccountData *adata, const char *query,
   return rc;
 }
 
+/**
+ * pop_fetch_data - Read Headers with callback function
+ * @param adata    POP Account data
+ * @param query    POP query to send to server
+ * @param progress Progress bar
+ * @param callback Function called for each header read
+ * @param data     Data to pass to the callback
+ * @retval  0 Successful
+ * @retval -1 Connection lost
+ * @retval -2 Invalid command or execution error
+ * @retval -3 Error in callback(*line, *data)
+ *
+ * This function calls  callback(*line, *data)  for each received line,
+ * callback(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
+ */
+int pop_fetch_data(struct PopAccountData *adata, const char *query,
+                   struct Progress *progress, pop_fetch_t callback, void *data)
+{
+  char buf[1024];
+
+  mutt_str_strfcpy(buf, query, sizeof(buf));
+  int rc = pop_query(adata, buf, sizeof(buf));
+  if (rc < 0)
+    return rc;
+
+  return fetch_lines(adata, progress, callback, data);
+}
+
+/**
+ * pop_pipeline_room - Can more commands be sent ahead?
+ * @param adata POP Account data
+ * @param num   Number of commands
+ * @retval true The server supports PIPELINING and num more commands fit
+ */
+bool pop_pipeline_room(struct PopAccountData *adata, unsigned int num)
+{
+  return adata->cmd_pipelining && (adata->status == POP_CONNECTED) &&
+         ((adata->ahead_count + num) <= POP_PIPELINE_DEPTH);
+}
+
+/**
+ * pop_query_ahead - Send a command without waiting for its response
+ * @param adata POP Account data
+ * @param cmd   Command, including the trailing CRLF
+ * @param multi true, if a +OK response is followed by several lines
+ * @retval  0 Successful
+ * @retval -1 Connection lost
+ *
+ * The response is read by the pop_query() or pop_fetch_data() for the same
+ * command, which must be issued in the same order.  Check pop_pipeline_room()
+ * first.
+ */
+int pop_query_ahead(struct PopAccountData *adata, const char *cmd, bool multi)
+{
+  if (mutt_socket_send_d(adata->conn, cmd, MUTT_SOCK_LOG_FULL) < 0)
+  {
+    adata->status = POP_DISCONNECTED;
+    return -1;
+  }
+
+  adata->ahead_multi[(adata->ahead_head + adata->ahead_count) % POP_PIPELINE_DEPTH] = multi;
+  adata->ahead_count++;
+  return 0;
+}
+
+/**
+ * pop_pipeline_drain - Discard the responses to the commands sent ahead
+ * @param adata POP Account data
+ * @retval  0 Successful
+ * @retval -1 Connection lost
+ *
+ * Used when an error stops the work before all the responses have been read.
+ */
+int pop_pipeline_drain(struct PopAccountData *adata)
+{
+  char buf[1024];
+
+  while ((adata->ahead_count > 0) && (adata->status == POP_CONNECTED))
+  {
+    const bool multi = adata->ahead_multi[adata->ahead_head];
+    adata->ahead_head = (adata->ahead_head + 1) % POP_PIPELINE_DEPTH;
+    adata->ahead_count--;
+
+    if (mutt_socket_readln_d(buf, sizeof(buf), adata->conn, MUTT_SOCK_LOG_FULL) < 0)
+      adata->status = POP_DISCONNECTED;
+    else if (multi && mutt_str_startswith(buf, "+OK", CASE_MATCH))
+      fetch_lines(adata, NULL, NULL, NULL);
+  }
+
+  adata->ahead_count = 0;
+  return (adata->status == POP_CONNECTED) ? 0 : -1;
+}
+
 /**
  * check_uidl - find message with this UIDL and set refno - Implements ::pop_fetch_t
  * @param line String containing UIDL
@@ -40,6 +40,9 @@ struct Progress;
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
+/* maximal number of commands sent ahead of their responses (RFC2449 PIPELINING) */
+#define POP_PIPELINE_DEPTH 16
+
 /**
  * enum PopStatus - POP server responses
  */
@@ -85,6 +88,7 @@ struct PopAccountData
   unsigned int cmd_user : 2; /**< optional command USER */
   unsigned int cmd_uidl : 2; /**< optional command UIDL */
   unsigned int cmd_top : 2;  /**< optional command TOP */
+  bool cmd_pipelining : 1;   /**< server supports PIPELINING */
   bool resp_codes : 1;       /**< server supports extended response codes */
   bool expire : 1;           /**< expire is greater than 0 */
   bool clear_cache : 1;
@@ -96,6 +100,11 @@ struct PopAccountData
   struct BodyCache *bcache; /**< body cache */
   char err_msg[POP_CMD_RESPONSE];
   struct PopCache cache[POP_CACHE_LEN];
+
+  /* commands sent by pop_query_ahead(), oldest first */
+  bool ahead_multi[POP_PIPELINE_DEPTH]; /**< true, if the +OK response has several lines */
+  unsigned int ahead_head;  /**< index of the oldest command */
+  unsigned int ahead_count; /**< number of commands awaiting a response */
 };
 
 /**
@@ -139,6 +148,9 @@ int pop_open_connection(struct PopAccountData *adata);
 int pop_query_d(struct PopAccountData *adata, char *buf, size_t buflen, char *msg);
 int pop_fetch_data(struct PopAccountData *adata, const char *query,
                    struct Progress *progress, pop_fetch_t callback, void *data);
+int pop_pipeline_drain(struct PopAccountData *adata);
+bool pop_pipeline_room(struct PopAccountData *adata, unsigned int num);
+int pop_query_ahead(struct PopAccountData *adata, const char *cmd, bool multi);
 int pop_reconnect(struct Mailbox *m);
 void pop_logout(struct Mailbox *m);
 struct PopAccountData *pop_adata_get(struct Mailbox *m);
@@ -71,6 +71,8 @@ char *C_SmtpAuthenticators; ///< Config: (smtp) List of allowed authentication m
 #define SMTP_AUTH_UNAVAIL 1
 #define SMTP_AUTH_FAIL -1
 
+#define SMTP_CHUNK_SIZE (256 * 1024) ///< Size of a message chunk sent by BDAT
+
 // clang-format off
 /**
  * typedef SmtpCapFlags - SMTP server capabilities
@@ -82,8 +84,10 @@ typedef uint8_t SmtpCapFlags;           ///< Flags, e.g. #SMTP_CAP_STARTTLS
 #define SMTP_CAP_DSN          (1 << 2) ///< Server supports Delivery Status Notification
 #define SMTP_CAP_EIGHTBITMIME (1 << 3) ///< Server supports 8-bit MIME content
 #define SMTP_CAP_SMTPUTF8     (1 << 4) ///< Server accepts UTF-8 strings
+#define SMTP_CAP_PIPELINING   (1 << 5) ///< Server supports command pipelining
+#define SMTP_CAP_CHUNKING     (1 << 6) ///< Server supports BDAT command
 
-#define SMTP_CAP_ALL         ((1 << 5) - 1)
+#define SMTP_CAP_ALL         ((1 << 7) - 1)
 // clang-format on
 
 static char *AuthMechs = NULL;
@@ -147,6 +151,10 @@ static int smtp_get_resp(struct Connection *conn)
       Capabilities |= SMTP_CAP_STARTTLS;
     else if (mutt_str_startswith(s, "SMTPUTF8", CASE_IGNORE))
       Capabilities |= SMTP_CAP_SMTPUTF8;
+    else if (mutt_str_startswith(s, "PIPELINING", CASE_IGNORE))
+      Capabilities |= SMTP_CAP_PIPELINING;
+    else if (mutt_str_startswith(s, "CHUNKING", CASE_IGNORE))
+      Capabilities |= SMTP_CAP_CHUNKING;
 
     if (!valid_smtp_code(buf, n, &n))
       return SMTP_ERR_CODE;
@@ -162,12 +170,16 @@ static int smtp_get_resp(struct Connection *conn)
 
 /**
  * smtp_rcpt_to - Set the recipient to an Address
- * @param conn Server Connection
- * @param a    Address to use
+ * @param conn    Server Connection
+ * @param a       Address to use
+ * @param pending If not NULL, count the replies instead of reading them
  * @retval  0 Success
  * @retval <0 Error, e.g. #SMTP_ERR_WRITE
+ *
+ * When the server supports PIPELINING, the caller reads the replies once all
+ * the recipients have been sent.
  */
-static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
+static int smtp_rcpt_to(struct Connection *conn, const struct Address *a, int *pending)
 {
   char buf[1024];
   int rc;
@@ -186,9 +198,14 @@ static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
       snprintf(buf, sizeof(buf), "RCPT TO:<%s>\r\n", a->mailbox);
     if (mutt_socket_send(conn, buf) == -1)
       return SMTP_ERR_WRITE;
-    rc = smtp_get_resp(conn);
-    if (rc != 0)
-      return rc;
+    if (pending)
+      (*pending)++;
+    else
+    {
+      rc = smtp_get_resp(conn);
+      if (rc != 0)
+        return rc;
+    }
     a = a->next;
   }
 
@@ -273,6 +290,88 @@ static int smtp_data(struct Connection *conn, const char *msgfile)
   return 0;
 }
 
+/**
+ * smtp_bdat - Send data to an SMTP server in chunks
+ * @param conn    SMTP Connection
+ * @param msgfile Filename containing data
+ * @retval  0 Success
+ * @retval <0 Error, e.g. #SMTP_ERR_WRITE
+ *
+ * RFC3030 CHUNKING gives the size of each chunk up front, so the message
+ * isn't dot-stuffed or scanned for its end.  Bare LFs still become CRLF.  If
+ * the server supports PIPELINING, the next chunk is sent before the reply to
+ * the previous one is read.
+ */
+static int smtp_bdat(struct Connection *conn, const char *msgfile)
+{
+  char cmd[64];
+  struct Progress progress;
+  struct stat st;
+  const int window = (Capabilities & SMTP_CAP_PIPELINING) ? 2 : 1;
+  int pending = 0;
+  int rc = 0;
+  char last = '\n';
+
+  FILE *fp = fopen(msgfile, "r");
+  if (!fp)
+  {
+    mutt_error(_("SMTP session failed: unable to open %s"), msgfile);
+    return -1;
+  }
+  stat(msgfile, &st);
+  unlink(msgfile);
+  mutt_progress_init(&progress, _("Sending message..."), MUTT_PROGRESS_SIZE,
+                     C_NetInc, st.st_size);
+
+  char *in = mutt_mem_malloc(SMTP_CHUNK_SIZE);
+  char *out = mutt_mem_malloc(2 * SMTP_CHUNK_SIZE + 3);
+
+  while (true)
+  {
+    const size_t n = fread(in, 1, SMTP_CHUNK_SIZE, fp);
+    const bool eof = (n < SMTP_CHUNK_SIZE);
+    size_t len = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      if ((in[i] == '\n') && (last != '\r'))
+        out[len++] = '\r';
+      out[len++] = in[i];
+      last = in[i];
+    }
+    if (eof && (last != '\n'))
+    {
+      if (last != '\r')
+        out[len++] = '\r';
+      out[len++] = '\n';
+    }
+    out[len] = '\0';
+
+    snprintf(cmd, sizeof(cmd), "BDAT %zu%s\r\n", len, eof ? " LAST" : "");
+    if ((mutt_socket_send(conn, cmd) == -1) ||
+        ((len != 0) && (mutt_socket_write_d(conn, out, len, MUTT_SOCK_LOG_FULL) == -1)))
+    {
+      rc = SMTP_ERR_WRITE;
+      break;
+    }
+    pending++;
+    mutt_progress_update(&progress, ftell(fp), -1);
+
+    while ((rc == 0) && ((pending >= window) || (eof && (pending > 0))))
+    {
+      rc = smtp_get_resp(conn);
+      pending--;
+    }
+    if ((rc != 0) || eof)
+      break;
+  }
+
+  FREE(&in);
+  FREE(&out);
+  mutt_file_fclose(&fp);
+  return rc;
+}
+
 /**
  * address_uses_unicode - Do any addresses use Unicode
  * @param a Address list to check
@@ -796,19 +895,35 @@ int mutt_smtp_send(const struct Address *from, const struct Address *to,
       rc = SMTP_ERR_WRITE;
       break;
     }
-    rc = smtp_get_resp(conn);
-    if (rc != 0)
-      break;
+
+    /* with PIPELINING, the replies to MAIL and RCPT are read together */
+    int pending = 0;
+    int *ahead = (Capabilities & SMTP_CAP_PIPELINING) ? &pending : NULL;
+    if (ahead)
+      pending++;
+    else
+    {
+      rc = smtp_get_resp(conn);
+      if (rc != 0)
+        break;
+    }
 
     /* send the recipient list */
-    if ((rc = smtp_rcpt_to(conn, to)) || (rc = smtp_rcpt_to(conn, cc)) ||
-        (rc = smtp_rcpt_to(conn, bcc)))
+    if ((rc = smtp_rcpt_to(conn, to, ahead)) || (rc = smtp_rcpt_to(conn, cc, ahead)) ||
+        (rc = smtp_rcpt_to(conn, bcc, ahead)))
     {
       break;
     }
+    for (; (rc == 0) && (pending > 0); pending--)
+      rc = smtp_get_resp(conn);
+    if (rc != 0)
+      break;
 
     /* send the message data */
-    rc = smtp_data(conn, msgfile);
+    if (Capabilities & SMTP_CAP_CHUNKING)
+      rc = smtp_bdat(conn, msgfile);
+    else
+      rc = smtp_data(conn, msgfile);
     if (rc != 0)
       break;
 
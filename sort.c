@@ -41,6 +41,9 @@
 #include "mutt_thread.h"
 #include "options.h"
 #include "score.h"
+#ifdef USE_IMAP
+#include "imap/imap.h"
+#endif
 #ifdef USE_NNTP
 #include "mx.h"
 #include "nntp/nntp.h"
@@ -352,6 +355,29 @@ sort_t *mutt_get_sort_func(enum SortType method)
   /* not reached */
 }
 
+#ifdef USE_IMAP
+/**
+ * sort_needs_headers - Does a sort method look at the headers of the emails?
+ * @param sort Sort method, e.g. #SORT_DATE
+ * @retval true The headers are needed
+ *
+ * IMAP emails may only be stubs, see imap_load_headers().
+ */
+static bool sort_needs_headers(short sort)
+{
+  switch (sort & SORT_MASK)
+  {
+    case SORT_DATE:
+    case SORT_ORDER:
+    case SORT_RECEIVED:
+    case SORT_SIZE:
+      return false;
+    default:
+      return true;
+  }
+}
+#endif
+
 /**
  * mutt_sort_headers - Sort emails by their headers
  * @param ctx  Mailbox
@@ -400,6 +426,10 @@ void mutt_sort_headers(struct Context *ctx, bool init)
 
   if ((C_Sort & SORT_MASK) == SORT_THREADS)
   {
+#ifdef USE_IMAP
+    if (ctx->mailbox->magic == MUTT_IMAP)
+      imap_load_headers(ctx->mailbox);
+#endif
     AuxSort = NULL;
     /* if $sort_aux changed after the mailbox is sorted, then all the
      * subthreads need to be resorted */
@@ -420,9 +450,22 @@ void mutt_sort_headers(struct Context *ctx, bool init)
     mutt_error(_("Could not find sorting function [report this bug]"));
     return;
   }
+#ifdef USE_IMAP
+  else if ((ctx->mailbox->magic == MUTT_IMAP) && (imap_sort_mailbox(ctx->mailbox) == 0))
+    mutt_debug(LL_DEBUG2, "Sorted by the server\n");
+#endif
   else
+  {
+#ifdef USE_IMAP
+    if ((ctx->mailbox->magic == MUTT_IMAP) &&
+        (sort_needs_headers(C_Sort) || sort_needs_headers(C_SortAux)))
+    {
+      imap_load_headers(ctx->mailbox);
+    }
+#endif
     qsort((void *) ctx->mailbox->emails, ctx->mailbox->msg_count,
           sizeof(struct Email *), sortfunc);
+  }
 
   /* adjust the virtual message numbers */
   ctx->mailbox->vcount = 0;
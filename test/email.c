@@ -0,0 +1,45 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include "email/email.h"
+#include "mutt/memory.h"
+
+void test_email_touch(void)
+{
+  { /* a new email has a generation */
+    struct Email *e = mutt_email_new();
+    TEST_CHECK(e->gen != 0);
+    mutt_email_free(&e);
+  }
+
+  { /* emails never share a generation */
+    struct Email *e1 = mutt_email_new();
+    struct Email *e2 = mutt_email_new();
+    TEST_CHECK(e1->gen != e2->gen);
+    mutt_email_free(&e1);
+    mutt_email_free(&e2);
+  }
+
+  { /* touching an email, e.g. when a stub's headers load, changes its generation */
+    struct Email *e = mutt_email_new();
+    const unsigned int gen = e->gen;
+    mutt_email_touch(e);
+    TEST_CHECK(e->gen != 0);
+    if (!TEST_CHECK(e->gen != gen))
+      TEST_MSG("Generation %u wasn't changed", gen);
+    mutt_email_free(&e);
+  }
+
+  { /* every touch gives a new generation, e.g. a POP or NNTP email whose
+     * headers are read again each time it's opened */
+    struct Email *e = mutt_email_new();
+    mutt_email_touch(e);
+    const unsigned int gen = e->gen;
+    mutt_email_touch(e);
+    TEST_CHECK(e->gen != gen);
+    mutt_email_free(&e);
+  }
+
+  { /* edge cases */
+    mutt_email_touch(NULL);
+  }
+}
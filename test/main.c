@@ -17,9 +17,14 @@
   NEOMUTT_TEST_ITEM(test_string_strnfcpy)                                      \
   NEOMUTT_TEST_ITEM(test_string_strcasestr)                                    \
   NEOMUTT_TEST_ITEM(test_addr_mbox_to_udomain)                                 \
+  NEOMUTT_TEST_ITEM(test_email_touch)                                          \
+  NEOMUTT_TEST_ITEM(test_email_range_bound)                                    \
+  NEOMUTT_TEST_ITEM(test_email_range_candidates)                               \
   NEOMUTT_TEST_ITEM(test_mutt_path_tidy_slash)                                 \
   NEOMUTT_TEST_ITEM(test_mutt_path_tidy_dotdot)                                \
   NEOMUTT_TEST_ITEM(test_mutt_path_tidy)                                       \
+  NEOMUTT_TEST_ITEM(test_regex_literal)                                        \
+  NEOMUTT_TEST_ITEM(test_regex_literal_find)                                   \
   NEOMUTT_TEST_ITEM(test_url)
 
 /******************************************************************************
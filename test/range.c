@@ -0,0 +1,173 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include "email/email.h"
+#include "email/range.h"
+#include "mutt/memory.h"
+
+#define NUM_EMAILS 6
+
+static void emails_new(struct Email **emails)
+{
+  for (int i = 0; i < NUM_EMAILS; i++)
+  {
+    emails[i] = mutt_email_new();
+    emails[i]->index = i;
+    emails[i]->msgno = i;
+  }
+}
+
+static void emails_free(struct Email **emails)
+{
+  for (int i = 0; i < NUM_EMAILS; i++)
+    mutt_email_free(&emails[i]);
+}
+
+void test_email_range_bound(void)
+{
+  struct Email *emails[NUM_EMAILS];
+  emails_new(emails);
+
+  { /* sorting keeps equal values in the order of the emails */
+    struct EmailRangeEntry entries[5] = {
+      { 7, emails[4] }, { 3, emails[3] }, { 1, emails[2] },
+      { 3, emails[1] }, { 3, emails[0] },
+    };
+    const int order[] = { 2, 0, 1, 3, 4 };
+    email_range_sort(entries, 5);
+    for (int i = 0; i < 5; i++)
+    {
+      if (!TEST_CHECK(entries[i].email == emails[order[i]]))
+        TEST_MSG("Entry %d is out of order", i);
+    }
+  }
+
+  { /* lower and upper bounds */
+    const long values[] = { 1, 3, 3, 3, 7 };
+    struct EmailRangeEntry entries[5];
+    for (int i = 0; i < 5; i++)
+    {
+      entries[i].value = values[i];
+      entries[i].email = emails[i];
+    }
+
+    static const struct
+    {
+      long value;
+      bool equal;
+      int expected;
+    } tests[] = {
+      { 0, true, 0 },  { 1, true, 0 }, { 1, false, 1 }, { 2, true, 1 },
+      { 3, true, 1 },  { 3, false, 4 }, { 7, true, 4 }, { 7, false, 5 },
+      { 8, true, 5 },  { -5, false, 0 },
+    };
+
+    for (size_t i = 0; i < mutt_array_size(tests); i++)
+    {
+      const int bound = email_range_bound(entries, 5, tests[i].value, tests[i].equal);
+      if (!TEST_CHECK(bound == tests[i].expected))
+      {
+        TEST_MSG("Value %ld, equal %d", tests[i].value, tests[i].equal);
+        TEST_MSG("Expected: %d", tests[i].expected);
+        TEST_MSG("Actual  : %d", bound);
+      }
+    }
+  }
+
+  { /* edge cases */
+    TEST_CHECK(email_range_bound(NULL, 0, 5, true) == 0);
+    email_range_sort(NULL, 3);
+  }
+
+  emails_free(emails);
+}
+
+void test_email_range_candidates(void)
+{
+  struct Email *emails[NUM_EMAILS];
+  struct Email *cands[NUM_EMAILS];
+  int pos[NUM_EMAILS];
+  emails_new(emails);
+
+  /* a range holding emails 1, 3 and 4 */
+  struct EmailRangeEntry range[3] = {
+    { 10, emails[3] }, { 20, emails[1] }, { 30, emails[4] },
+  };
+  /* the server hit emails 0, 2 and 4 */
+  const bool hits[NUM_EMAILS] = { true, false, true, false, true, false };
+
+  { /* nothing to narrow by */
+    const int num = email_range_candidates(NULL, -1, NUM_EMAILS, NULL, 0,
+                                           emails, NUM_EMAILS, cands, pos);
+    TEST_CHECK(num == NUM_EMAILS);
+    for (int i = 0; i < num; i++)
+      TEST_CHECK((cands[i] == emails[i]) && (pos[i] == i));
+  }
+
+  { /* a range */
+    const int num = email_range_candidates(range, 3, NUM_EMAILS, NULL, 0,
+                                           emails, NUM_EMAILS, cands, pos);
+    if (TEST_CHECK(num == 3))
+    {
+      TEST_CHECK((cands[0] == emails[1]) && (pos[0] == 1));
+      TEST_CHECK((cands[1] == emails[3]) && (pos[1] == 3));
+      TEST_CHECK((cands[2] == emails[4]) && (pos[2] == 4));
+    }
+  }
+
+  { /* an empty range rules out everything */
+    const int num = email_range_candidates(range, 0, NUM_EMAILS, NULL, 0,
+                                           emails, NUM_EMAILS, cands, pos);
+    TEST_CHECK(num == 0);
+  }
+
+  { /* the server's hits */
+    const int num = email_range_candidates(NULL, -1, NUM_EMAILS, hits, NUM_EMAILS,
+                                           emails, NUM_EMAILS, cands, pos);
+    if (TEST_CHECK(num == 3))
+    {
+      TEST_CHECK((cands[0] == emails[0]) && (pos[0] == 0));
+      TEST_CHECK((cands[1] == emails[2]) && (pos[1] == 2));
+      TEST_CHECK((cands[2] == emails[4]) && (pos[2] == 4));
+    }
+  }
+
+  { /* both */
+    const int num = email_range_candidates(range, 3, NUM_EMAILS, hits, NUM_EMAILS,
+                                           emails, NUM_EMAILS, cands, pos);
+    if (TEST_CHECK(num == 1))
+      TEST_CHECK((cands[0] == emails[4]) && (pos[0] == 4));
+  }
+
+  { /* positions are within the emails that were passed */
+    struct Email *some[2] = { emails[4], emails[0] };
+    const int num = email_range_candidates(range, 3, NUM_EMAILS, NULL, 0, some,
+                                           2, cands, pos);
+    if (TEST_CHECK(num == 1))
+      TEST_CHECK((cands[0] == emails[4]) && (pos[0] == 0));
+  }
+
+  { /* an email newer than the hits isn't ruled out by them */
+    emails[5]->msgno = NUM_EMAILS;
+    const int num = email_range_candidates(NULL, -1, NUM_EMAILS, hits, NUM_EMAILS - 1,
+                                           emails + 5, 1, cands, pos);
+    TEST_CHECK(num == 1);
+    emails[5]->msgno = 5;
+  }
+
+  { /* an email outside the index is ruled out by a range */
+    emails[4]->index = NUM_EMAILS;
+    const int num = email_range_candidates(range, 3, NUM_EMAILS, NULL, 0,
+                                           emails + 4, 1, cands, pos);
+    TEST_CHECK(num == 0);
+    emails[4]->index = 4;
+  }
+
+  { /* edge cases */
+    TEST_CHECK(email_range_candidates(range, 3, NUM_EMAILS, hits, NUM_EMAILS,
+                                      NULL, 0, cands, pos) == 0);
+    TEST_CHECK(email_range_candidates(range, 3, NUM_EMAILS, hits, NUM_EMAILS,
+                                      emails, NUM_EMAILS, NULL, NULL) == 0);
+  }
+
+  emails_free(emails);
+}
@@ -0,0 +1,82 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+
+#include "config.h"
+#include <regex.h>
+#include <stdbool.h>
+#include <string.h>
+#include "mutt/regex3.h"
+
+void test_regex_literal(void)
+{
+  static const struct
+  {
+    const char *regex;
+    int flags;
+    const char *literal; /* NULL if none */
+    bool whole;
+  } tests[] = {
+    // clang-format off
+    { "hello",            0,         "hello",  true  },
+    { "foo\\.bar",        0,         "foo.bar", true },
+    { "^foo",             0,         "foo",    false },
+    { "colou?r",          0,         "colo",   false },
+    { "ab*cdef",          0,         "cdef",   false },
+    { "ab+c",             0,         "ab",     false },
+    { "x{2,3}yz",         0,         "yz",     false },
+    { "[abc]+hello[xyz]", 0,         "hello",  false },
+    { "[]x]y",            0,         "y",      false },
+    { "(foo|bar)bazz",    0,         "bazz",   false },
+    { "foo|bar",          0,         NULL,     false },
+    { "\\<word\\>",       0,         "word",   false },
+    { ".*",               0,         NULL,     false },
+    { "caf\xc3\xa9s",     0,         "caf\xc3\xa9s", true },
+    { "caf\xc3\xa9s",     REG_ICASE, "caf",    false },
+    { "",                 0,         NULL,     false },
+    // clang-format on
+  };
+
+  for (size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++)
+  {
+    struct RegexLiteral lit;
+    bool found = mutt_regex_literal(tests[i].regex, tests[i].flags, &lit);
+    TEST_CASE(tests[i].regex);
+    if (!TEST_CHECK(found == (tests[i].literal != NULL)))
+      continue;
+    if (!found)
+      continue;
+    if (!TEST_CHECK(strcmp(lit.str, tests[i].literal) == 0))
+    {
+      TEST_MSG("Expected: %s", tests[i].literal);
+      TEST_MSG("Actual  : %s", lit.str);
+    }
+    TEST_CHECK(lit.len == strlen(tests[i].literal));
+    TEST_CHECK(lit.whole == tests[i].whole);
+    mutt_regex_literal_free(&lit);
+    TEST_CHECK(lit.str == NULL);
+  }
+}
+
+void test_regex_literal_find(void)
+{
+  struct RegexLiteral lit;
+
+  TEST_CHECK(mutt_regex_literal_find(NULL, "anything"));
+
+  mutt_regex_literal("needle", 0, &lit);
+  TEST_CHECK(mutt_regex_literal_find(&lit, "haystack with a needle in it"));
+  TEST_CHECK(!mutt_regex_literal_find(&lit, "haystack with a Needle in it"));
+  TEST_CHECK(!mutt_regex_literal_find(&lit, "needl"));
+  TEST_CHECK(!mutt_regex_literal_find(&lit, NULL));
+  mutt_regex_literal_free(&lit);
+
+  mutt_regex_literal("needle", REG_ICASE, &lit);
+  TEST_CHECK(mutt_regex_literal_find(&lit, "NNNEEDLE"));
+  TEST_CHECK(mutt_regex_literal_find(&lit, "a nEeDlE"));
+  TEST_CHECK(!mutt_regex_literal_find(&lit, "neeDL"));
+  mutt_regex_literal_free(&lit);
+
+  mutt_regex_literal("1.5", REG_ICASE, &lit);
+  TEST_CHECK(mutt_regex_literal_find(&lit, "version 1.5"));
+  mutt_regex_literal_free(&lit);
+}